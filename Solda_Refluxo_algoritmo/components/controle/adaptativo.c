@@ -0,0 +1,208 @@
+#include <string.h>
+#include <math.h>
+#include "adaptativo.h"
+
+static const char *nomes_estado[] = { "aprendendo", "valido", "invalido" };
+
+/*Modelo inicial: temperatura constante (a = 1, b = 0), invalido ate o RLS aprender b*/
+static void reinicia_estimador(adaptativo_t *ad){
+    memset(ad->theta, 0, sizeof(ad->theta));
+    memset(ad->P, 0, sizeof(ad->P));
+    ad->theta[0] = 1;
+    for(int i = 0; i < 3; i++){
+        ad->P[i][i] = ADAPTATIVO_P0;
+    }
+    ad->var_erro = 0;
+    ad->validas = 0;
+}
+
+/**
+ * @brief Inicia o estimador sem modelo; ate ele ficar valido a saida e a do PID fixo
+ *
+ * @param ad
+ * @param kp ganhos do PID fixo, usados antes do modelo e quando ele sai dos limites
+ * @param ki
+ * @param kd
+ * @param T periodo nominal em s
+ * @param saida_max duty maximo
+ * @param ligado false para so estimar, sem mudar o PID
+ */
+void adaptativo_inicia(adaptativo_t *ad, float kp, float ki, float kd, float T, float saida_max, bool ligado){
+    memset(ad, 0, sizeof(*ad));
+    ad->kp_fixo = kp;
+    ad->ki_fixo = ki;
+    ad->kd_fixo = kd;
+    ad->T = T;
+    ad->saida_max = saida_max;
+    ad->ligado = ligado;
+    ad->estado = ADAPTATIVO_APRENDENDO;
+    reinicia_estimador(ad);
+}
+
+/*Uma atualizacao do RLS com phi = [y[k-1], u[k-1-d], 1]. Com a covariancia acima de ADAPTATIVO_TRACO_MAX o
+ esquecimento para, senao ela cresce sem limite nos trechos sem excitacao (patamares)*/
+static void estima(adaptativo_t *ad, float y, float u_atrasado){
+    float phi[3] = { ad->y_ant, u_atrasado, 1 };
+    float Pphi[3];
+    float den = ADAPTATIVO_ESQUECIMENTO;
+    float previsao = 0;
+    for(int i = 0; i < 3; i++){
+        Pphi[i] = ad->P[i][0] * phi[0] + ad->P[i][1] * phi[1] + ad->P[i][2] * phi[2];
+        den += phi[i] * Pphi[i];
+        previsao += ad->theta[i] * phi[i];
+    }
+    float erro = y - previsao;
+    float traco = ad->P[0][0] + ad->P[1][1] + ad->P[2][2];
+    float esquecimento = traco > ADAPTATIVO_TRACO_MAX ? 1 : ADAPTATIVO_ESQUECIMENTO;
+    for(int i = 0; i < 3; i++){
+        float k = Pphi[i] / den;
+        ad->theta[i] += k * erro;
+        //P simetrica: calcula o triangulo de cima e espelha
+        for(int j = i; j < 3; j++){
+            ad->P[i][j] = (ad->P[i][j] - k * Pphi[j]) / esquecimento;
+            ad->P[j][i] = ad->P[i][j];
+        }
+    }
+    ad->var_erro += ADAPTATIVO_MEDIA_ERRO * (erro * erro - ad->var_erro);
+}
+
+/*Limites do modelo estimado. Valores nao finitos reiniciam o estimador*/
+static bool modelo_valido(adaptativo_t *ad){
+    bool finito = isfinite(ad->var_erro);
+    for(int i = 0; i < 3; i++){
+        finito = finito && isfinite(ad->theta[i]) && isfinite(ad->P[i][i]);
+    }
+    if(!finito){
+        reinicia_estimador(ad);
+        ad->reinicios++;
+        return false;
+    }
+    float a = ad->theta[0], b = ad->theta[1];
+    return a > ADAPTATIVO_A_MIN && a < ADAPTATIVO_A_MAX && b > 0 &&
+           sqrtf(ad->P[1][1] * ad->var_erro) < ADAPTATIVO_INCERTEZA * b &&
+           ad->var_erro * (ADAPTATIVO_Y_ESCALA * ADAPTATIVO_Y_ESCALA) < ADAPTATIVO_ERRO_MAX * ADAPTATIVO_ERRO_MAX;
+}
+
+/**
+ * @brief Uma amostra do controle: atualiza o modelo com a temperatura atual e calcula a saida pelo PID, com os
+ * ganhos do modelo e o feedforward, ou com os ganhos fixos. Substitui pid_atualiza no laco
+ *
+ * @param ad
+ * @param pid PID do laco; os ganhos sao trocados sem zerar o estado (pid_ganhos)
+ * @param modo estagio do perfil, para o escalonamento dos ganhos fixos
+ * @param setpoint
+ * @param derivada taxa do setpoint em graus/s (perfil_t.derivada)
+ * @param temp temperatura filtrada
+ * @param dt intervalo medido desde a amostra anterior em s
+ * @return float duty (antes da saturacao)
+ */
+float adaptativo_atualiza(adaptativo_t *ad, pid_ctrl_t *pid, int modo, float setpoint, float derivada, float temp,
+                          float dt){
+    float y = temp / ADAPTATIVO_Y_ESCALA;
+    if(fabsf(dt - ad->T) > ad->T / 2){
+        ad->amostras = 0;
+    }
+    int estado = ad->estado;
+    float ff_ant = ad->feedforward;
+    if(ad->amostras > ADAPTATIVO_ATRASO){
+        //o mais antigo do anel e o u[k-1-d]
+        estima(ad, y, ad->u[ad->pos]);
+        if(modelo_valido(ad)){
+            ad->validas++;
+            if(ad->validas >= ADAPTATIVO_AQUECIMENTO){
+                ad->estado = ADAPTATIVO_VALIDO;
+            }
+        }
+        else{
+            ad->validas = 0;
+            if(ad->estado == ADAPTATIVO_VALIDO){
+                ad->estado = ADAPTATIVO_INVALIDO;
+            }
+        }
+    }
+    if(ad->estado == ADAPTATIVO_VALIDO){
+        ad->a = ad->theta[0];
+        ad->b = ad->theta[1] * ADAPTATIVO_Y_ESCALA / ad->saida_max;
+        ad->c = ad->theta[2] * ADAPTATIVO_Y_ESCALA;
+        float theta_s = (ADAPTATIVO_ATRASO + 1) * ad->T;
+        ad->kp = ad->T / (ad->b * (ADAPTATIVO_LAMBDA_S + theta_s));
+        ad->ki = ad->kp / (4 * (ADAPTATIVO_LAMBDA_S + theta_s));
+        //pelo modelo, u[k] leva y[k+d] = r - derivada T a y[k+d+1] = r, com r o setpoint daqui a d+1 amostras
+        float r = setpoint + derivada * theta_s;
+        float ff = ((1 - ad->a) * r + ad->a * derivada * ad->T - ad->c) / ad->b;
+        ad->feedforward = fminf(fmaxf(ff, 0), ad->saida_max);
+    }
+    else{
+        ad->feedforward = 0;
+    }
+
+    bool usando = ad->ligado && ad->estado == ADAPTATIVO_VALIDO;
+    if(estado == ADAPTATIVO_VALIDO && ad->estado != ADAPTATIVO_VALIDO){
+        ad->quedas++;
+    }
+    //troca sem salto, como no escalonamento: a diferenca entre a saida de antes e a de depois da troca vai para o
+    //ajuste, que decai com constante de tempo ADAPTATIVO_TRANSICAO_S
+    ad->ajuste *= expf(-dt / ADAPTATIVO_TRANSICAO_S);
+    float erro = setpoint - temp;
+    float saida;
+    if(usando){
+        if(!ad->usando){
+            //entrada no modelo: o ajuste do escalonamento passa para ca e o feedforward entra aos poucos
+            if(ad->escalonamento){
+                ad->ajuste += ad->escalonamento->ajuste;
+                ad->escalonamento->ajuste = 0;
+            }
+            ad->ajuste -= ad->feedforward;
+        }
+        //os ganhos do modelo mudam a cada amostra; cada mudanca tambem passa pelo ajuste
+        if(ad->kp != pid->kp || ad->ki != pid->ki || pid->kd != 0){
+            ad->ajuste += pid_saida_com(pid, pid->kp, pid->ki, pid->kd, erro) -
+                          pid_saida_com(pid, ad->kp, ad->ki, 0, erro);
+            pid_ganhos(pid, ad->kp, ad->ki, 0);
+        }
+        saida = pid_atualiza(pid, setpoint, temp, dt) + ad->feedforward;
+    }
+    else{
+        if(ad->usando){
+            //volta aos ganhos fixos: o feedforward da ultima amostra sai aos poucos; a troca dos ganhos e compensada
+            //aqui ou, com a tabela, pelo proprio escalonamento
+            ad->ajuste += ff_ant;
+            if(!ad->escalonamento){
+                ad->ajuste += pid_saida_com(pid, pid->kp, pid->ki, pid->kd, erro) -
+                              pid_saida_com(pid, ad->kp_fixo, ad->ki_fixo, ad->kd_fixo, erro);
+                pid_ganhos(pid, ad->kp_fixo, ad->ki_fixo, ad->kd_fixo);
+            }
+        }
+        if(ad->escalonamento){
+            saida = escalonamento_atualiza(ad->escalonamento, pid, modo, setpoint, temp, dt);
+        }
+        else{
+            saida = pid_atualiza(pid, setpoint, temp, dt);
+        }
+    }
+    saida += ad->ajuste;
+    ad->usando = usando;
+    ad->saida = saida;
+
+    //historico para a proxima amostra: o duty que o rele vai de fato aplicar
+    ad->u[ad->pos] = fminf(fmaxf(saida, 0), ad->saida_max) / ad->saida_max;
+    ad->pos = (ad->pos + 1) % (ADAPTATIVO_ATRASO + 1);
+    ad->y_ant = y;
+    if(ad->amostras <= ADAPTATIVO_ATRASO){
+        ad->amostras++;
+    }
+    return saida;
+}
+
+/**
+ * @brief Nome do estado, usado nos logs
+ *
+ * @param estado
+ * @return const char*
+ */
+const char *adaptativo_nome_estado(int estado){
+    if(estado < 0 || estado > ADAPTATIVO_INVALIDO){
+        return "?";
+    }
+    return nomes_estado[estado];
+}
@@ -0,0 +1,167 @@
+#include <string.h>
+#include <math.h>
+#include "autotune.h"
+
+static const char *nomes_estado[] = { "rodando", "pronto", "sem oscilacao", "sobretemperatura" };
+
+/**
+ * @brief Inicia o experimento. O rele comeca ligado se a temperatura estiver abaixo do setpoint
+ *
+ * @param at
+ * @param setpoint temperatura da oscilacao
+ * @param histerese graus acima e abaixo do setpoint em que o rele troca de estado
+ * @param saida_max duty com o rele ligado
+ */
+void autotune_inicia(autotune_t *at, float setpoint, float histerese, float saida_max){
+    memset(at, 0, sizeof(*at));
+    at->setpoint = setpoint;
+    at->histerese = histerese;
+    at->saida_max = saida_max;
+    at->estado = AUTOTUNE_RODANDO;
+}
+
+/*Fim de um ciclo (o rele voltou a ligar): acumula o periodo e a amplitude, exceto no primeiro ciclo*/
+static void fecha_ciclo(autotune_t *at, int64_t t_us){
+    if(at->t_ligou_us){
+        at->ciclos++;
+        if(at->ciclos > 1){
+            at->soma_periodo_s += (t_us - at->t_ligou_us) / 1e6f;
+            at->soma_amplitude += (at->max - at->min) / 2;
+        }
+    }
+    at->t_ligou_us = t_us;
+    at->max = at->min = at->setpoint;
+
+    if(at->ciclos == AUTOTUNE_CICLOS + 1){
+        at->pu_s = at->soma_periodo_s / AUTOTUNE_CICLOS;
+        at->amplitude = at->soma_amplitude / AUTOTUNE_CICLOS;
+        if(at->amplitude <= at->histerese){
+            at->estado = AUTOTUNE_SEM_OSCILACAO;
+            return;
+        }
+        float d = at->saida_max / 2;
+        at->ku = 4 * d / ((float)M_PI * sqrtf(at->amplitude * at->amplitude - at->histerese * at->histerese));
+        at->estado = AUTOTUNE_PRONTO;
+    }
+}
+
+/**
+ * @brief Uma amostra do experimento. Deve ser chamada uma vez por amostra, no lugar do PID
+ *
+ * @param at
+ * @param temp temperatura (filtrada, como a do PID)
+ * @param t_us instante da amostra
+ * @return float duty do rele: saida_max ou 0. Fora de AUTOTUNE_RODANDO e sempre 0
+ */
+float autotune_passo(autotune_t *at, float temp, int64_t t_us){
+    if(at->estado != AUTOTUNE_RODANDO){
+        return 0;
+    }
+    if(!at->t_inicio_us){
+        at->t_inicio_us = t_us;
+        at->ligado = temp < at->setpoint;
+    }
+    if(temp > at->setpoint + AUTOTUNE_MARGEM){
+        at->estado = AUTOTUNE_SOBRETEMPERATURA;
+        return 0;
+    }
+    if(t_us - at->t_inicio_us > (int64_t)AUTOTUNE_MAX_S * 1000000){
+        at->estado = AUTOTUNE_SEM_OSCILACAO;
+        return 0;
+    }
+
+    if(temp > at->max){
+        at->max = temp;
+    }
+    if(temp < at->min){
+        at->min = temp;
+    }
+    if(at->ligado && temp > at->setpoint + at->histerese){
+        at->ligado = false;
+    }
+    else if(!at->ligado && temp < at->setpoint - at->histerese){
+        at->ligado = true;
+        fecha_ciclo(at, t_us);
+        if(at->estado != AUTOTUNE_RODANDO){
+            return 0;
+        }
+    }
+    return at->ligado ? at->saida_max : 0;
+}
+
+/**
+ * @brief Ganhos do PID (forma paralela de pid.h: ki = kp/Ti, kd = kp*Td) a partir de Ku e Pu. A derivada do nucleo
+ * tem filtro com constante PID_FILTRO_D_S, entao o ganho dela em alta frequencia e kd / PID_FILTRO_D_S; Td e
+ * limitado para ele nao passar de AUTOTUNE_N_DERIVADA kp
+ *
+ * @param at experimento em AUTOTUNE_PRONTO
+ * @param regra AUTOTUNE_ZN_CLASSICO ou AUTOTUNE_ZN_SEM_SOBRESSINAL
+ * @param kp
+ * @param ki
+ * @param kd
+ * @return true se o experimento terminou e a regra existe
+ */
+bool autotune_ganhos(const autotune_t *at, int regra, float *kp, float *ki, float *kd){
+    if(at->estado != AUTOTUNE_PRONTO){
+        return false;
+    }
+    float ti, td;
+    switch(regra){
+    case AUTOTUNE_ZN_CLASSICO:
+        *kp = 0.6f * at->ku;
+        ti = at->pu_s / 2;
+        td = at->pu_s / 8;
+        break;
+    case AUTOTUNE_ZN_SEM_SOBRESSINAL:
+        *kp = 0.2f * at->ku;
+        ti = at->pu_s / 2;
+        td = at->pu_s / 3;
+        break;
+    default:
+        return false;
+    }
+    td = fminf(td, AUTOTUNE_N_DERIVADA * PID_FILTRO_D_S);
+    *ki = *kp / ti;
+    *kd = *kp * td;
+    return true;
+}
+
+/**
+ * @brief Executa o experimento completo sobre a HAL, uma amostra por leitura do sensor, e desliga o rele no fim.
+ * Com o termopar aberto o rele e desligado e a amostra e descartada, como em reflow_passo
+ *
+ * @param at ja iniciado
+ * @param hal
+ * @param filtro filtro da temperatura (pode ser NULL)
+ * @return int estado final
+ */
+int autotune_executa(autotune_t *at, const reflow_hal_t *hal, filtro_t *filtro){
+    while(at->estado == AUTOTUNE_RODANDO){
+        max6675_amostra_t amostra;
+        hal->le_sensor(hal->ctx, &amostra);
+        if(amostra.aberto){
+            hal->altera_duty(hal->ctx, 0);
+            continue;
+        }
+        float temp = max6675_graus(&amostra);
+        if(filtro){
+            temp = filtro_aplica(filtro, temp);
+        }
+        hal->altera_duty(hal->ctx, autotune_passo(at, temp, amostra.t_us));
+    }
+    hal->altera_duty(hal->ctx, 0);
+    return at->estado;
+}
+
+/**
+ * @brief Nome do estado, usado nos logs
+ *
+ * @param estado
+ * @return const char*
+ */
+const char *autotune_nome_estado(int estado){
+    if(estado < 0 || estado > AUTOTUNE_SOBRETEMPERATURA){
+        return "?";
+    }
+    return nomes_estado[estado];
+}
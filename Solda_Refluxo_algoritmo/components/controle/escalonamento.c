@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "escalonamento.h"
+
+/**
+ * @brief Inicia com os ganhos padrao; a faixa da tabela e escolhida na primeira amostra
+ *
+ * @param esc
+ * @param tabela faixas (pode ser NULL: so os ganhos padrao)
+ * @param kp ganhos padrao, fora de todas as faixas
+ * @param ki
+ * @param kd
+ */
+void escalonamento_inicia(escalonamento_t *esc, const escalonamento_tabela_t *tabela, float kp, float ki, float kd){
+    memset(esc, 0, sizeof(*esc));
+    esc->tabela = tabela;
+    esc->kp = kp;
+    esc->ki = ki;
+    esc->kd = kd;
+    esc->atual = -1;
+}
+
+static bool contem(const escalonamento_faixa_t *f, int modo, float temp, float margem){
+    return (f->modo == ESCALONAMENTO_QUALQUER || f->modo == modo) &&
+           temp >= f->temp_min - margem && temp < f->temp_max + margem;
+}
+
+/*A faixa atual vale com a histerese; senao, a primeira que contem o estagio e a temperatura*/
+static int escolhe(const escalonamento_t *esc, int modo, float temp){
+    const escalonamento_tabela_t *tabela = esc->tabela;
+    if(!tabela){
+        return -1;
+    }
+    if(esc->atual >= 0 && contem(&tabela->faixas[esc->atual], modo, temp, ESCALONAMENTO_HISTERESE)){
+        return esc->atual;
+    }
+    for(int i = 0; i < tabela->n; i++){
+        if(contem(&tabela->faixas[i], modo, temp, 0)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Uma amostra do controle: escolhe os ganhos pelo estagio e pela temperatura, troca sem salto se
+ * mudaram e calcula a saida. Substitui pid_atualiza no laco
+ *
+ * @param esc
+ * @param pid PID do laco; os ganhos sao trocados sem zerar o estado (pid_ganhos)
+ * @param modo estagio do perfil (perfil_t.modo_operacao)
+ * @param setpoint
+ * @param temp temperatura filtrada
+ * @param dt intervalo medido desde a amostra anterior em s
+ * @return float duty (antes da saturacao)
+ */
+float escalonamento_atualiza(escalonamento_t *esc, pid_ctrl_t *pid, int modo, float setpoint, float temp, float dt){
+    esc->ajuste *= expf(-dt / ESCALONAMENTO_TRANSICAO_S);
+
+    esc->atual = escolhe(esc, modo, temp);
+    float kp = esc->kp, ki = esc->ki, kd = esc->kd;
+    if(esc->atual >= 0){
+        const escalonamento_faixa_t *f = &esc->tabela->faixas[esc->atual];
+        kp = f->kp;
+        ki = f->ki;
+        kd = f->kd;
+    }
+    //compara com os ganhos do PID, nao com a ultima faixa: tambem cobre a volta do controle adaptativo
+    if(kp != pid->kp || ki != pid->ki || kd != pid->kd){
+        float erro = setpoint - temp;
+        esc->ajuste += pid_saida_com(pid, pid->kp, pid->ki, pid->kd, erro) - pid_saida_com(pid, kp, ki, kd, erro);
+        pid_ganhos(pid, kp, ki, kd);
+        esc->trocas++;
+    }
+    return pid_atualiza(pid, setpoint, temp, dt) + esc->ajuste;
+}
+
+/**
+ * @brief Le uma tabela em texto, uma faixa por linha:
+ *
+ *   # estagio  temp_min  temp_max  kp   ki   kd
+ *   *          0         130       3    24   4
+ *   2          130       170       2.5  30   4
+ *
+ * O estagio e o indice do segmento do perfil (modo_operacao) ou * para qualquer um. Linhas vazias e comecando com #
+ * sao ignoradas. A tabela so e alterada se o texto inteiro for valido.
+ *
+ * @param tabela
+ * @param texto
+ * @return int 0 se leu, ou o numero da linha com erro
+ */
+int escalonamento_tabela_le(escalonamento_tabela_t *tabela, const char *texto){
+    escalonamento_tabela_t lida;
+    memset(&lida, 0, sizeof(lida));
+
+    int linha = 0;
+    while(*texto){
+        char buf[96];
+        size_t tam = strcspn(texto, "\n");
+        linha++;
+        if(tam >= sizeof(buf)){
+            return linha;
+        }
+        memcpy(buf, texto, tam);
+        buf[tam] = '\0';
+        texto += tam + (texto[tam] == '\n');
+
+        char *p = buf + strspn(buf, " \t\r");
+        if(*p == '\0' || *p == '#'){
+            continue;
+        }
+        if(lida.n == ESCALONAMENTO_MAX_FAIXAS){
+            return linha;
+        }
+
+        escalonamento_faixa_t *f = &lida.faixas[lida.n];
+        char estagio[8];
+        int modo;
+        if(sscanf(p, "%7s %f %f %f %f %f", estagio, &f->temp_min, &f->temp_max, &f->kp, &f->ki, &f->kd) != 6){
+            return linha;
+        }
+        if(strcmp(estagio, "*") == 0){
+            modo = ESCALONAMENTO_QUALQUER;
+        }
+        else if(sscanf(estagio, "%d", &modo) != 1 || modo < 0 || modo > INT8_MAX){
+            return linha;
+        }
+        f->modo = modo;
+        if(!(f->temp_min < f->temp_max) || !isfinite(f->kp) || !isfinite(f->ki) || !isfinite(f->kd) ||
+           f->kp < 0 || f->ki < 0 || f->kd < 0){
+            return linha;
+        }
+        lida.n++;
+    }
+
+    *tabela = lida;
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include <string.h>
+#include <math.h>
+#include "excitacao.h"
+
+static const char *nomes_estado[] = { "rodando", "pronto", "fora da banda", "sem equilibrio" };
+static const char *nomes_fase[] = { "excitacao: equilibrio", "excitacao: sinal", "excitacao: fim" };
+static const char *nomes_sinal[EXCITACAO_N_SINAIS] = { "prbs", "chirp" };
+
+/**
+ * @brief Configuracao padrao (EXCITACAO_*)
+ *
+ * @param cfg
+ * @param sinal EXCITACAO_PRBS ou EXCITACAO_CHIRP
+ */
+void excitacao_config_padrao(excitacao_config_t *cfg, int sinal){
+    cfg->sinal = sinal;
+    cfg->temperatura = EXCITACAO_TEMPERATURA;
+    cfg->banda = EXCITACAO_BANDA;
+    cfg->amplitude = EXCITACAO_AMPLITUDE;
+    cfg->duracao_s = EXCITACAO_DURACAO_S;
+    cfg->bit_s = EXCITACAO_BIT_S;
+    cfg->f_min_hz = EXCITACAO_F_MIN_HZ;
+    cfg->f_max_hz = EXCITACAO_F_MAX_HZ;
+}
+
+/**
+ * @brief Inicia o experimento na fase de equilibrio
+ *
+ * @param ex
+ * @param cfg
+ * @param saida_max duty maximo
+ * @param registro log onde vao a saida e a temperatura lida de cada amostra (pode ser NULL), ja iniciado
+ */
+void excitacao_inicia(excitacao_t *ex, const excitacao_config_t *cfg, float saida_max, registro_t *registro){
+    memset(ex, 0, sizeof(*ex));
+    ex->cfg = *cfg;
+    ex->saida_max = saida_max;
+    ex->registro = registro;
+    ex->estado = EXCITACAO_RODANDO;
+    ex->fase = EXCITACAO_EQUILIBRIO;
+}
+
+/*Passa para o sinal com a media do duty nos ciclos do rele; a amplitude e limitada para o duty nao saturar*/
+static void inicia_sinal(excitacao_t *ex, int64_t t_us){
+    ex->equilibrio = ex->soma_duty_s / ((t_us - ex->t_medida_us) / 1e6f);
+    ex->amplitude = fminf(ex->cfg.amplitude * ex->saida_max, fminf(ex->equilibrio, ex->saida_max - ex->equilibrio));
+    ex->fase = EXCITACAO_SINAL;
+    ex->t_sinal_us = t_us;
+    ex->lfsr = 0x7F;
+    ex->bits = 0;
+}
+
+/*Rele em volta da temperatura de trabalho. A media do duty comeca quando o rele desliga pela primeira vez (fim do
+ aquecimento) e fecha depois de EXCITACAO_CICLOS_EQUILIBRIO ciclos completos, tambem num desligamento*/
+static float equilibrio(excitacao_t *ex, float temp, int64_t t_us){
+    if(t_us - ex->t_inicio_us > (int64_t)EXCITACAO_MAX_EQUILIBRIO_S * 1000000){
+        ex->estado = EXCITACAO_SEM_EQUILIBRIO;
+        return 0;
+    }
+    if(ex->ligado && temp > ex->cfg.temperatura + EXCITACAO_HISTERESE){
+        ex->ligado = false;
+        if(!ex->t_medida_us){
+            ex->t_medida_us = t_us;
+            ex->soma_duty_s = 0;
+        }
+        else if(++ex->ciclos == EXCITACAO_CICLOS_EQUILIBRIO){
+            inicia_sinal(ex, t_us);
+        }
+    }
+    else if(!ex->ligado && temp < ex->cfg.temperatura - EXCITACAO_HISTERESE){
+        ex->ligado = true;
+    }
+    return ex->ligado ? ex->saida_max : 0;
+}
+
+/*PRBS de 7 bits (x^7 + x^6 + 1): periodo de 127 bits, com 64 uns e 63 zeros*/
+static void avanca_lfsr(excitacao_t *ex){
+    uint8_t novo = ((ex->lfsr >> 6) ^ (ex->lfsr >> 5)) & 1;
+    ex->lfsr = ((ex->lfsr << 1) | novo) & 0x7F;
+}
+
+/*Duty de equilibrio mais o sinal, de -1 a 1 vezes a amplitude*/
+static float sinal(excitacao_t *ex, int64_t t_us){
+    const excitacao_config_t *cfg = &ex->cfg;
+    float t = (t_us - ex->t_sinal_us) / 1e6f;
+    if(t >= cfg->duracao_s){
+        ex->estado = EXCITACAO_PRONTO;
+        return 0;
+    }
+    float s;
+    if(cfg->sinal == EXCITACAO_PRBS){
+        int32_t bit = (int32_t)(t / cfg->bit_s);
+        while(ex->bits <= bit){
+            avanca_lfsr(ex);
+            ex->bits++;
+        }
+        s = (ex->lfsr & 1) ? 1 : -1;
+    }
+    else{
+        //chirp exponencial: f(t) = f_min (f_max/f_min)^(t/duracao); a fase e a integral de 2 pi f
+        float razao = cfg->f_max_hz / cfg->f_min_hz;
+        float k = logf(razao) / cfg->duracao_s;
+        s = sinf(2 * (float)M_PI * cfg->f_min_hz * (expf(k * t) - 1) / k);
+    }
+    return ex->equilibrio + ex->amplitude * s;
+}
+
+/**
+ * @brief Uma amostra do experimento. Deve ser chamada uma vez por amostra, no lugar do PID; grava a saida e a
+ * temperatura lida no log, com a fase como segmento
+ *
+ * @param ex
+ * @param lida temperatura lida, gravada no log
+ * @param temp temperatura filtrada, usada no rele do equilibrio e na banda de seguranca
+ * @param t_us instante da amostra
+ * @return float duty. Fora de EXCITACAO_RODANDO e sempre 0
+ */
+float excitacao_passo(excitacao_t *ex, float lida, float temp, int64_t t_us){
+    if(ex->estado != EXCITACAO_RODANDO){
+        return 0;
+    }
+    bool primeira = !ex->t_inicio_us;
+    if(primeira){
+        ex->t_inicio_us = t_us;
+        ex->ligado = temp < ex->cfg.temperatura;
+    }
+    else if(ex->t_medida_us){
+        ex->soma_duty_s += ex->saida * ((t_us - ex->t_anterior_us) / 1e6f);
+    }
+    ex->t_anterior_us = t_us;
+
+    int fase = ex->fase;
+    float saida = 0;
+    if(temp > ex->cfg.temperatura + ex->cfg.banda ||
+       (ex->fase == EXCITACAO_SINAL && temp < ex->cfg.temperatura - ex->cfg.banda)){
+        ex->estado = EXCITACAO_FORA_DA_BANDA;
+    }
+    else if(ex->fase == EXCITACAO_EQUILIBRIO){
+        saida = equilibrio(ex, temp, t_us);
+    }
+    //o sinal comeca na amostra que fecha o equilibrio
+    if(ex->estado == EXCITACAO_RODANDO && ex->fase == EXCITACAO_SINAL){
+        saida = sinal(ex, t_us);
+    }
+    if(ex->estado != EXCITACAO_RODANDO){
+        ex->fase = EXCITACAO_FIM;
+        saida = 0;
+    }
+    ex->saida = saida;
+
+    //a fase que comeca nesta amostra ja vale para ela
+    if(ex->registro){
+        if(primeira || ex->fase != fase){
+            registro_estagio(ex->registro, t_us, EXCITACAO_MODO + ex->fase, ex->cfg.temperatura);
+        }
+        registro_saida(ex->registro, saida);
+        registro_amostra(ex->registro, t_us, lida);
+    }
+    return saida;
+}
+
+/**
+ * @brief Nome do estado, usado nos logs
+ *
+ * @param estado
+ * @return const char*
+ */
+const char *excitacao_nome_estado(int estado){
+    if(estado < 0 || estado > EXCITACAO_SEM_EQUILIBRIO){
+        return "?";
+    }
+    return nomes_estado[estado];
+}
+
+/**
+ * @brief Nome da fase gravada no log como segmento
+ *
+ * @param modo segmento do log (EXCITACAO_MODO + fase)
+ * @return const char* NULL se o segmento nao e de uma excitacao
+ */
+const char *excitacao_nome_fase(int modo){
+    if(modo < EXCITACAO_MODO || modo > EXCITACAO_MODO + EXCITACAO_FIM){
+        return NULL;
+    }
+    return nomes_fase[modo - EXCITACAO_MODO];
+}
+
+/**
+ * @brief Nome do sinal ("prbs" ou "chirp")
+ *
+ * @param sinal
+ * @return const char*
+ */
+const char *excitacao_nome_sinal(int sinal){
+    if(sinal < 0 || sinal >= EXCITACAO_N_SINAIS){
+        return "?";
+    }
+    return nomes_sinal[sinal];
+}
+
+/**
+ * @brief Sinal pelo nome
+ *
+ * @param nome "prbs" ou "chirp"
+ * @return int EXCITACAO_PRBS, EXCITACAO_CHIRP ou -1
+ */
+int excitacao_busca_sinal(const char *nome){
+    for(int i = 0; i < EXCITACAO_N_SINAIS; i++){
+        if(strcmp(nome, nomes_sinal[i]) == 0){
+            return i;
+        }
+    }
+    return -1;
+}
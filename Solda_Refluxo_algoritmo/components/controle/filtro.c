@@ -0,0 +1,121 @@
+#include <math.h>
+#include <string.h>
+#include "filtro.h"
+
+static const int cadeia[] = { FILTRO_CADEIA };
+
+_Static_assert(sizeof(cadeia) / sizeof(cadeia[0]) <= FILTRO_MAX_ESTAGIOS, "FILTRO_CADEIA com estagios demais");
+_Static_assert(FILTRO_MEDIANA_N % 2 == 1 && FILTRO_MEDIANA_N > 0 && FILTRO_MEDIANA_N <= FILTRO_MEDIANA_MAX,
+               "FILTRO_MEDIANA_N deve ser impar e ate FILTRO_MEDIANA_MAX");
+
+/**
+ * @brief Inicia um estagio com os parametros da compilacao
+ *
+ * @param estagio
+ * @param tipo FILTRO_NENHUM, FILTRO_MEDIANA, FILTRO_IIR ou FILTRO_KALMAN
+ * @param T periodo de amostragem em s
+ */
+void filtro_estagio_inicia(filtro_estagio_t *estagio, int tipo, float T){
+    memset(estagio, 0, sizeof(*estagio));
+    estagio->tipo = tipo;
+    switch(tipo){
+    case FILTRO_MEDIANA:
+        estagio->mediana.n = FILTRO_MEDIANA_N;
+        break;
+    case FILTRO_IIR:
+        estagio->iir.a = 1 - expf(-2 * (float)M_PI * FILTRO_IIR_CORTE_HZ * T);
+        break;
+    case FILTRO_KALMAN:
+        estagio->kalman.q = FILTRO_KALMAN_Q;
+        estagio->kalman.r = FILTRO_KALMAN_R;
+        estagio->kalman.p = FILTRO_KALMAN_R;
+        break;
+    }
+}
+
+/**
+ * @brief Monta a cadeia definida em FILTRO_CADEIA
+ *
+ * @param filtro
+ * @param T periodo de amostragem em s
+ */
+void filtro_inicia(filtro_t *filtro, float T){
+    filtro->n = 0;
+    for(unsigned i = 0; i < sizeof(cadeia) / sizeof(cadeia[0]); i++){
+        filtro_estagio_inicia(&filtro->estagios[filtro->n++], cadeia[i], T);
+    }
+}
+
+static float mediana(filtro_estagio_t *e, float x){
+    e->mediana.janela[e->mediana.pos] = x;
+    e->mediana.pos = (e->mediana.pos + 1) % e->mediana.n;
+    if(e->mediana.pos == 0){
+        e->mediana.cheia = 1;
+    }
+    int n = e->mediana.cheia ? e->mediana.n : e->mediana.pos;
+
+    /*Ordena uma copia da janela por insercao (N pequeno)*/
+    float v[FILTRO_MEDIANA_MAX];
+    for(int i = 0; i < n; i++){
+        float t = e->mediana.janela[i];
+        int j = i;
+        while(j > 0 && v[j-1] > t){
+            v[j] = v[j-1];
+            j--;
+        }
+        v[j] = t;
+    }
+    return v[n / 2];
+}
+
+static float iir(filtro_estagio_t *e, float x){
+    if(!e->iir.iniciado){
+        e->iir.y = x;
+        e->iir.iniciado = 1;
+    }
+    e->iir.y += e->iir.a * (x - e->iir.y);
+    return e->iir.y;
+}
+
+static float kalman(filtro_estagio_t *e, float z){
+    if(!e->kalman.iniciado){
+        e->kalman.x = z;
+        e->kalman.iniciado = 1;
+        return z;
+    }
+    e->kalman.p += e->kalman.q;
+    float k = e->kalman.p / (e->kalman.p + e->kalman.r);
+    e->kalman.x += k * (z - e->kalman.x);
+    e->kalman.p *= 1 - k;
+    return e->kalman.x;
+}
+
+/**
+ * @brief Aplica um estagio
+ *
+ * @param estagio
+ * @param x amostra
+ * @return float amostra filtrada
+ */
+float filtro_estagio_aplica(filtro_estagio_t *estagio, float x){
+    switch(estagio->tipo){
+    case FILTRO_MEDIANA: return mediana(estagio, x);
+    case FILTRO_IIR:     return iir(estagio, x);
+    case FILTRO_KALMAN:  return kalman(estagio, x);
+    default:             return x;
+    }
+}
+
+/**
+ * @brief Passa a temperatura por todos os estagios da cadeia
+ *
+ * @param filtro
+ * @param x temperatura lida
+ * @return float temperatura filtrada
+ */
+float filtro_aplica(filtro_t *filtro, float x){
+    for(int i = 0; i < filtro->n; i++){
+        x = filtro_estagio_aplica(&filtro->estagios[i], x);
+    }
+    return x;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file filtro_bench.c
+ * @brief Benchmark dos estagios do filtro: ciclos por amostra e quanto do ruido sobra, sobre uma rampa de
+ * 1 grau/s com ruido e quantizacao de 0,25 grau como a do MAX6675.
+ */
+
+#include <math.h>
+#include "filtro.h"
+#include "filtro_bench.h"
+
+#define N FILTRO_BENCH_AMOSTRAS
+#define T 0.5f
+
+static float limpo[N];
+static float lido[N];
+static float saida[N];
+
+static void gera_sinal(void){
+    uint32_t x = 1;
+    for(int i = 0; i < N; i++){
+        x = x * 1664525u + 1013904223u;
+        float ruido = ((int32_t)((x >> 8) % 2001) - 1000) / 1000.0f;     //+-1 grau
+        limpo[i] = 25 + i * T;
+        lido[i] = floorf((limpo[i] + ruido) * 4) / 4;
+    }
+}
+
+static float rms(void){
+    double s = 0;
+    for(int i = 0; i < N; i++){
+        s += (saida[i] - limpo[i]) * (saida[i] - limpo[i]);
+    }
+    return sqrtf(s / N);
+}
+
+static void bench_estagio(bench_ciclos_t ciclos, filtro_bench_resultado_t *res, int tipo, const char *nome){
+    filtro_estagio_t e;
+    filtro_estagio_inicia(&e, tipo, T);
+    uint32_t inicio = ciclos();
+    for(int i = 0; i < N; i++){
+        saida[i] = filtro_estagio_aplica(&e, lido[i]);
+    }
+    res->ciclos = (ciclos() - inicio) / N;
+    res->nome = nome;
+    res->rms_ruido = rms();
+}
+
+/**
+ * @brief Executa o benchmark de cada estagio e da cadeia definida na compilacao
+ *
+ * @param ciclos contador de ciclos da plataforma
+ * @param res resultados na ordem mediana, IIR, Kalman, cadeia
+ */
+void filtro_bench_executa(bench_ciclos_t ciclos, filtro_bench_resultado_t res[FILTRO_BENCH_N_CASOS]){
+    gera_sinal();
+    bench_estagio(ciclos, &res[0], FILTRO_MEDIANA, "mediana");
+    bench_estagio(ciclos, &res[1], FILTRO_IIR, "iir");
+    bench_estagio(ciclos, &res[2], FILTRO_KALMAN, "kalman");
+
+    filtro_t filtro;
+    filtro_inicia(&filtro, T);
+    uint32_t inicio = ciclos();
+    for(int i = 0; i < N; i++){
+        saida[i] = filtro_aplica(&filtro, lido[i]);
+    }
+    res[3].ciclos = (ciclos() - inicio) / N;
+    res[3].nome = "cadeia";
+    res[3].rms_ruido = rms();
+}
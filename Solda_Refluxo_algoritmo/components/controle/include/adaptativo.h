@@ -0,0 +1,99 @@
+#ifndef ADAPTATIVO_H
+#define ADAPTATIVO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pid.h"
+#include "escalonamento.h"
+
+/**
+ * @brief Controle auto-ajustavel. A cada amostra, minimos quadrados recursivos (RLS) com fator de esquecimento
+ * estimam um modelo de primeira ordem com atraso do forno
+ *
+ *   y[k] = a y[k-1] + b u[k-1-d] + c
+ *
+ * (y temperatura filtrada, u duty aplicado, d = ADAPTATIVO_ATRASO amostras, c as perdas e o ambiente) e o controle
+ * e recalculado a partir dele:
+ *   - kp e ki pela regra SIMC para processo integrador com atraso (o forno tem constante de tempo de dezenas de
+ *     minutos): com k' = b/T graus/s por unidade de duty e theta = (d+1) T, kp = 1 / (k' (ADAPTATIVO_LAMBDA_S +
+ *     theta)) e Ti = 4 (ADAPTATIVO_LAMBDA_S + theta); kd fica 0
+ *   - feedforward: o duty que, pelo modelo, leva a temperatura ao setpoint de daqui a d+1 amostras seguindo a
+ *     derivada do perfil
+ * O c estimado entra no feedforward e compensa as perdas; o integrador do PID so corrige o erro do modelo.
+ *
+ * O custo por amostra e fixo: o RLS de 3 parametros, sem lacos dependentes dos dados, mais uma raiz e duas
+ * divisoes; no laco do ESP32 entra na fase LATENCIA_PID. A estimativa so e usada depois de ADAPTATIVO_AQUECIMENTO
+ * atualizacoes validas seguidas. Com o modelo fora dos limites (a, b, incerteza de b ou erro de previsao) o PID volta
+ * aos ganhos fixos, sem feedforward; com valores nao finitos o estimador e reiniciado. Intervalos fora do periodo
+ * nominal (amostra perdida, termopar aberto) reiniciam o historico, e o RLS so volta a estimar com d+1 amostras
+ * regulares.
+ *
+ * A entrada no modelo, a volta aos ganhos fixos e as mudancas do kp estimado sao sem salto, como no escalonamento: a
+ * diferenca entre a saida antes e depois da troca (pid_saida_com e o feedforward) vai para um ajuste somado a saida,
+ * que decai com constante de tempo ADAPTATIVO_TRANSICAO_S.
+ *
+ * O estimador roda mesmo com o modo desligado (ligado = false), para o modelo ja estar pronto quando for ligado. Com
+ * uma tabela de escalonamento, os ganhos fixos sao os dela (escalonamento.h), com a troca sem salto.
+ */
+
+#ifndef ADAPTATIVO_ATRASO
+#define ADAPTATIVO_ATRASO 8                         //Amostras de atraso: janela do rele, atraso do termopar e do filtro
+#endif
+#ifndef ADAPTATIVO_ESQUECIMENTO
+#define ADAPTATIVO_ESQUECIMENTO 0.998f              //Fator de esquecimento (memoria de ~500 amostras)
+#endif
+#ifndef ADAPTATIVO_LAMBDA_S
+#define ADAPTATIVO_LAMBDA_S 30.0f                   //Constante de tempo pedida para a malha fechada
+#endif
+#ifndef ADAPTATIVO_TRANSICAO_S
+#define ADAPTATIVO_TRANSICAO_S ESCALONAMENTO_TRANSICAO_S //Constante de tempo do ajuste das trocas
+#endif
+#define ADAPTATIVO_AQUECIMENTO 60                   //Atualizacoes validas seguidas antes de usar o modelo
+#define ADAPTATIVO_P0 100.0f                        //Covariancia inicial (regressores escalados)
+#define ADAPTATIVO_TRACO_MAX 1000.0f                //Acima, o esquecimento para (sem excitacao a covariancia so cresce)
+#define ADAPTATIVO_A_MIN 0.9f                       //Polo minimo: constante de tempo de ~10 amostras
+#define ADAPTATIVO_A_MAX 1.01f                      //O forno e quase integrador; a estimativa passa um pouco de 1
+#define ADAPTATIVO_INCERTEZA 0.3f                   //Desvio padrao de b, relativo a b, acima do qual o modelo e invalido
+#define ADAPTATIVO_ERRO_MAX 1.0f                    //Erro de previsao rms maximo em graus
+#define ADAPTATIVO_MEDIA_ERRO 0.02f                 //Peso de cada amostra na media do quadrado do erro
+#define ADAPTATIVO_Y_ESCALA 100.0f                  //Graus por unidade do regressor da temperatura
+
+enum {
+    ADAPTATIVO_APRENDENDO = 0,                      //Ainda sem ADAPTATIVO_AQUECIMENTO estimativas validas
+    ADAPTATIVO_VALIDO,                              //Modelo em uso (com o modo ligado)
+    ADAPTATIVO_INVALIDO,                            //Era valido e saiu dos limites: PID fixo
+};
+
+typedef struct {
+    float kp_fixo, ki_fixo, kd_fixo;                //Ganhos do PID fixo
+    escalonamento_t *escalonamento;                 //Ganhos fixos por estagio e temperatura (NULL = kp_fixo...)
+    float saida_max;
+    float T;                                        //Periodo nominal em s
+    bool ligado;                                    //false: so estima, o PID fica com os ganhos fixos
+    /*estimador, com y em graus / ADAPTATIVO_Y_ESCALA e u em fracao de saida_max*/
+    float theta[3];
+    float P[3][3];
+    float y_ant;
+    float u[ADAPTATIVO_ATRASO + 1];                 //Duty aplicado nas ultimas amostras, em anel
+    uint8_t pos;
+    uint16_t amostras;                              //Amostras regulares seguidas no historico
+    float var_erro;                                 //Media do quadrado do erro de previsao
+    uint32_t validas;                               //Atualizacoes validas seguidas
+    /*resultado*/
+    int estado;                                     //ADAPTATIVO_APRENDENDO, ADAPTATIVO_VALIDO...
+    bool usando;                                    //A ultima saida usou o modelo
+    float a, b, c;                                  //Modelo em graus e unidades de duty
+    float kp, ki;                                   //Ganhos calculados
+    float feedforward;                              //Duty do modelo na ultima amostra
+    float ajuste;                                   //Duty somado a saida desde a ultima troca
+    float saida;                                    //Ultima saida
+    uint32_t quedas;                                //Vezes que voltou ao PID fixo depois de valido
+    uint32_t reinicios;                             //Vezes que o estimador divergiu e foi reiniciado
+} adaptativo_t;
+
+void adaptativo_inicia(adaptativo_t *ad, float kp, float ki, float kd, float T, float saida_max, bool ligado);
+float adaptativo_atualiza(adaptativo_t *ad, pid_ctrl_t *pid, int modo, float setpoint, float derivada, float temp,
+                          float dt);
+const char *adaptativo_nome_estado(int estado);
+
+#endif
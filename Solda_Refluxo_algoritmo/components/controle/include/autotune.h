@@ -0,0 +1,73 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "reflow_hal.h"
+#include "filtro.h"
+#include "pid_nucleo.h"
+
+/**
+ * @brief Sintonia do PID pelo experimento do rele de Astrom-Hagglund. Em vez do PID, o rele liga (saida maxima)
+ * abaixo de setpoint - histerese e desliga (0) acima de setpoint + histerese; o forno oscila em volta do setpoint
+ * com o periodo ultimo Pu. Com a amplitude a da oscilacao e d = saida_max/2, o ganho ultimo e
+ *
+ *   Ku = 4 d / (pi sqrt(a^2 - histerese^2))
+ *
+ * e os ganhos saem de Ku e Pu por uma regra de Ziegler-Nichols (autotune_ganhos). O primeiro ciclo, ainda no
+ * transitorio do aquecimento, e descartado; Ku e Pu sao a media dos AUTOTUNE_CICLOS seguintes.
+ *
+ * A mesma maquina de estados roda no ESP32 (control_pwm, uma chamada de autotune_passo por amostra) e no host
+ * (autotune_executa sobre a HAL simulada, reflow_host -A).
+ */
+
+#ifndef AUTOTUNE_SETPOINT
+#define AUTOTUNE_SETPOINT 150.0f                    //Temperatura da oscilacao; a da imersao termica
+#endif
+#define AUTOTUNE_HISTERESE 1.0f                     //Graus; acima do ruido e da resolucao de 0,25 grau do MAX6675
+#define AUTOTUNE_CICLOS 3                           //Ciclos medidos depois do descartado
+#define AUTOTUNE_MARGEM 40.0f                       //Acima de setpoint + margem o experimento e abortado
+#define AUTOTUNE_MAX_S 3600                         //Duracao maxima, contando o aquecimento ate o setpoint
+#define AUTOTUNE_N_DERIVADA 10.0f                   //Ganho maximo da derivada em alta frequencia, em kp
+
+enum {
+    AUTOTUNE_RODANDO = 0,
+    AUTOTUNE_PRONTO,
+    AUTOTUNE_SEM_OSCILACAO,                         //Amplitude menor que a histerese ou tempo esgotado
+    AUTOTUNE_SOBRETEMPERATURA
+};
+
+/*Regras de sintonia a partir de Ku e Pu*/
+enum {
+    AUTOTUNE_ZN_CLASSICO = 0,                       //Kp = 0,6 Ku, Ti = Pu/2, Td = Pu/8
+    AUTOTUNE_ZN_SEM_SOBRESSINAL,                    //Kp = 0,2 Ku, Ti = Pu/2, Td = Pu/3
+    AUTOTUNE_N_REGRAS
+};
+
+#ifndef AUTOTUNE_REGRA
+#define AUTOTUNE_REGRA AUTOTUNE_ZN_SEM_SOBRESSINAL   //Regra usada pelo firmware e por reflow_host -A
+#endif
+
+typedef struct {
+    float setpoint;
+    float histerese;
+    float saida_max;                                //Duty com o rele ligado (max_d)
+    int estado;                                     //AUTOTUNE_RODANDO, AUTOTUNE_PRONTO...
+    bool ligado;                                    //Estado do rele
+    int64_t t_inicio_us;                            //Primeira amostra
+    int64_t t_ligou_us;                             //Inicio do ciclo atual (0 = ainda nao houve)
+    float max, min;                                 //Extremos do ciclo atual
+    int ciclos;                                     //Ciclos completos, contando o descartado
+    float soma_periodo_s, soma_amplitude;
+    float ku;                                       //Ganho ultimo, em duty por grau
+    float pu_s;                                     //Periodo ultimo
+    float amplitude;                                //Amplitude media da oscilacao em graus
+} autotune_t;
+
+void autotune_inicia(autotune_t *at, float setpoint, float histerese, float saida_max);
+float autotune_passo(autotune_t *at, float temp, int64_t t_us);
+bool autotune_ganhos(const autotune_t *at, int regra, float *kp, float *ki, float *kd);
+int autotune_executa(autotune_t *at, const reflow_hal_t *hal, filtro_t *filtro);
+const char *autotune_nome_estado(int estado);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+/**
+ * @brief Contador de ciclos da plataforma (CCOUNT no ESP32, TSC no host), usado pelos benchmarks do controle
+ */
+typedef uint32_t (*bench_ciclos_t)(void);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CICLO_ARQUIVO_H
+#define CICLO_ARQUIVO_H
+
+/**
+ * @brief Formato dos ciclos guardados na flash (main/arquivo_ciclos.c). Cada ciclo e um arquivo so de acrescimos:
+ * o cabecalho, gravado no inicio do ciclo, seguido dos blocos do log (registro.h) na ordem em que ficaram
+ * completos. Um ciclo interrompido por um reset fica com os blocos gravados ate ali. O cabecalho guarda a tabela
+ * do perfil, entao o arquivo sozinho basta para refazer a curva ideal (perfil_ideal). Uma excitacao (excitacao.h)
+ * comeca um ciclo proprio, com o log reiniciado, marcado pelo tipo no cabecalho.
+ *
+ * O indice tem uma entrada de tamanho fixo por posicao; o ciclo id fica na posicao id % CICLO_MAX_ARQUIVADOS,
+ * entao achar um ciclo e um acesso so. As estruturas sao gravadas como estao na memoria (little endian, mesmo
+ * alinhamento no ESP32 e no host).
+ */
+
+#include <stdint.h>
+#include "perfil.h"
+#include "registro.h"
+
+#define CICLO_MAGICO 0x4C435352                     //"RSCL"
+#define CICLO_VERSAO 2
+#ifndef CICLO_MAX_ARQUIVADOS
+#define CICLO_MAX_ARQUIVADOS 16                     //Ciclos guardados; o mais antigo e apagado
+#endif
+
+enum {
+    CICLO_VAZIO = 0,
+    CICLO_EM_ANDAMENTO,
+    CICLO_COMPLETO,
+    CICLO_INTERROMPIDO,                             //Reset, experimento ou excitacao abortada antes do fim
+};
+
+enum {
+    CICLO_PERFIL = 0,                               //Log de um perfil de solda
+    CICLO_EXCITACAO,                                //Log de uma excitacao; sinal = EXCITACAO_PRBS ou EXCITACAO_CHIRP
+};
+
+typedef struct {
+    uint32_t magico;
+    uint16_t versao;
+    uint16_t periodo_ms;                            //Periodo das amostras do log
+    uint32_t id;
+    uint32_t tam_bloco;                             //sizeof(registro_bloco_t), para o leitor conferir
+    uint8_t tipo;                                   //CICLO_PERFIL ou CICLO_EXCITACAO
+    uint8_t sinal;                                  //Sinal da excitacao
+    uint16_t reservado;
+    perfil_tabela_t tabela;                         //Perfil usado no ciclo
+} ciclo_cabecalho_t;
+
+typedef struct {
+    uint32_t id;                                    //0 = posicao vazia
+    uint8_t estado;                                 //CICLO_*
+    uint32_t n_blocos;                              //Blocos gravados
+    uint32_t perdidos;                              //Blocos descartados do anel antes de serem gravados
+} ciclo_indice_t;
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef ESCALONAMENTO_H
+#define ESCALONAMENTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pid.h"
+
+/**
+ * @brief Escalonamento de ganhos: uma tabela de faixas, cada uma com os ganhos do PID para um estagio do perfil
+ * (modo_operacao, ou qualquer estagio) e uma faixa de temperatura. As perdas do forno crescem com a temperatura,
+ * entao os ganhos que acomodam bem o patamar de 100 graus nao sao os do pico de 240.
+ *
+ * A cada amostra vale a primeira faixa da tabela que contem o estagio e a temperatura filtrada; sem nenhuma, os
+ * ganhos padrao. A faixa atual continua valendo ate a temperatura sair dela por mais de ESCALONAMENTO_HISTERESE,
+ * para os ganhos nao alternarem com o ruido na fronteira.
+ *
+ * A troca e sem salto: o PID deste projeto nao guarda a saida em um integrador, entao a saida mudaria de uma vez
+ * com os ganhos. Na troca, a diferenca entre a saida com os ganhos antigos e com os novos (pid_saida_com) vai para
+ * um ajuste somado a saida, que decai com constante de tempo ESCALONAMENTO_TRANSICAO_S.
+ *
+ * A tabela e lida em texto (escalonamento_tabela_le): no ESP32 da NVS na partida, no host de um arquivo
+ * (reflow_host -s). varredura_pid -s grava uma tabela com os melhores ganhos de cada estagio.
+ */
+
+#define ESCALONAMENTO_MAX_FAIXAS 16
+#define ESCALONAMENTO_QUALQUER -1                   //Faixa valida em todos os estagios ("*" no texto)
+#define ESCALONAMENTO_HISTERESE 2.0f                //Graus alem da faixa atual antes de trocar
+#ifndef ESCALONAMENTO_TRANSICAO_S
+#define ESCALONAMENTO_TRANSICAO_S 10.0f             //Constante de tempo do ajuste da troca
+#endif
+
+typedef struct {
+    int8_t modo;                                    //Estagio do perfil ou ESCALONAMENTO_QUALQUER
+    float temp_min, temp_max;                       //Faixa de temperatura [temp_min, temp_max)
+    float kp, ki, kd;
+} escalonamento_faixa_t;
+
+typedef struct {
+    int n;
+    escalonamento_faixa_t faixas[ESCALONAMENTO_MAX_FAIXAS];
+} escalonamento_tabela_t;
+
+typedef struct {
+    const escalonamento_tabela_t *tabela;
+    float kp, ki, kd;                               //Ganhos padrao, fora de todas as faixas
+    int atual;                                      //Faixa em uso (-1 = ganhos padrao)
+    float ajuste;                                   //Duty somado a saida desde a ultima troca
+    uint32_t trocas;
+} escalonamento_t;
+
+void escalonamento_inicia(escalonamento_t *esc, const escalonamento_tabela_t *tabela, float kp, float ki, float kd);
+float escalonamento_atualiza(escalonamento_t *esc, pid_ctrl_t *pid, int modo, float setpoint, float temp, float dt);
+int escalonamento_tabela_le(escalonamento_tabela_t *tabela, const char *texto);
+
+#endif
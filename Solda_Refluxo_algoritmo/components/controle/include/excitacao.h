@@ -0,0 +1,103 @@
+#ifndef EXCITACAO_H
+#define EXCITACAO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "registro.h"
+
+/**
+ * @brief Excitacao ativa do forno para identificacao. Em malha aberta, em volta de uma temperatura de trabalho, a
+ * saida segue uma sequencia binaria pseudoaleatoria (PRBS de comprimento maximo) ou um chirp (seno com a frequencia
+ * subindo exponencialmente) somada ao duty de equilibrio. A saida e a temperatura lida de cada amostra vao para o
+ * log do ciclo (registro_saida e registro_amostra) e o host calcula a resposta em frequencia (host/resposta_frequencia).
+ *
+ * O experimento tem tres fases, gravadas no log como segmentos EXCITACAO_MODO + fase:
+ *   equilibrio: rele em volta da temperatura de trabalho, como no autotune (o aquecimento e o rele ligado). A media
+ *               do duty nos EXCITACAO_CICLOS_EQUILIBRIO ciclos depois da primeira vez que o rele desliga e o duty que
+ *               mantem o forno na temperatura de trabalho
+ *   sinal:      duty de equilibrio mais o sinal, pela duracao pedida
+ *   fim:        rele desligado
+ * Acima de temperatura + banda, ou abaixo de temperatura - banda durante o sinal, o experimento para com o rele
+ * desligado; as amostras ja gravadas continuam valendo.
+ *
+ * A mesma maquina de estados roda no ESP32 (control_pwm, comando 'e' do console) e no host (reflow_host -E, sobre a
+ * HAL simulada). O sinal de 10 min gera mais amostras que o anel do log guarda: no ESP32 o experimento completo fica
+ * no arquivo do ciclo na flash (arquivo_ciclos.h), e reflow_host grava os blocos conforme ficam completos.
+ */
+
+#ifndef EXCITACAO_TEMPERATURA
+#define EXCITACAO_TEMPERATURA 150.0f                //Temperatura de trabalho; a da imersao termica
+#endif
+#ifndef EXCITACAO_BANDA
+#define EXCITACAO_BANDA 20.0f                       //Graus acima e abaixo da temperatura de trabalho
+#endif
+#define EXCITACAO_AMPLITUDE 0.125f                  //Fracao de saida_max somada e subtraida do duty de equilibrio
+#define EXCITACAO_DURACAO_S 600.0f                  //Duracao do sinal
+#define EXCITACAO_BIT_S 4.0f                        //PRBS: duracao de cada bit (127 bits = 508 s)
+#define EXCITACAO_F_MIN_HZ 0.002f                   //Chirp: frequencia inicial
+#define EXCITACAO_F_MAX_HZ 0.05f                    //Chirp: frequencia final, abaixo da janela de 1 s do rele
+#define EXCITACAO_HISTERESE 1.0f                    //Rele do equilibrio, como AUTOTUNE_HISTERESE
+#define EXCITACAO_CICLOS_EQUILIBRIO 3
+#define EXCITACAO_MAX_EQUILIBRIO_S 3600             //Duracao maxima do aquecimento e do equilibrio
+#define EXCITACAO_MODO 0xE0                         //Segmento do log na fase 0; fora de qualquer tabela de perfil
+
+/*Sinais*/
+enum {
+    EXCITACAO_PRBS = 0,
+    EXCITACAO_CHIRP,
+    EXCITACAO_N_SINAIS
+};
+
+enum {
+    EXCITACAO_RODANDO = 0,
+    EXCITACAO_PRONTO,
+    EXCITACAO_FORA_DA_BANDA,
+    EXCITACAO_SEM_EQUILIBRIO                        //O rele nao completou os ciclos no tempo maximo
+};
+
+/*Fases, na ordem*/
+enum {
+    EXCITACAO_EQUILIBRIO = 0,
+    EXCITACAO_SINAL,
+    EXCITACAO_FIM
+};
+
+typedef struct {
+    int sinal;                                      //EXCITACAO_PRBS ou EXCITACAO_CHIRP
+    float temperatura;                              //Temperatura de trabalho
+    float banda;                                    //Graus acima e abaixo da temperatura de trabalho
+    float amplitude;                                //Fracao de saida_max; limitada para o duty nao saturar
+    float duracao_s;
+    float bit_s;                                    //PRBS
+    float f_min_hz, f_max_hz;                       //Chirp
+} excitacao_config_t;
+
+typedef struct {
+    excitacao_config_t cfg;
+    float saida_max;
+    registro_t *registro;                           //Log das amostras (pode ser NULL)
+    int estado;                                     //EXCITACAO_RODANDO, EXCITACAO_PRONTO...
+    int fase;                                       //EXCITACAO_EQUILIBRIO, EXCITACAO_SINAL...
+    bool ligado;                                    //Rele do equilibrio
+    int ciclos;                                     //Ciclos do rele medidos no equilibrio
+    int64_t t_inicio_us;                            //Primeira amostra
+    int64_t t_medida_us;                            //Inicio da media do duty (0 = ainda nao comecou)
+    int64_t t_sinal_us;                             //Inicio do sinal
+    int64_t t_anterior_us;
+    float saida;                                    //Ultima saida
+    float soma_duty_s;                              //Integral do duty desde t_medida_us
+    float equilibrio;                               //Duty de equilibrio medido
+    float amplitude;                                //Amplitude do sinal em duty
+    uint8_t lfsr;                                   //PRBS de 7 bits
+    int32_t bits;                                   //Bits do PRBS ja gerados
+} excitacao_t;
+
+void excitacao_config_padrao(excitacao_config_t *cfg, int sinal);
+void excitacao_inicia(excitacao_t *ex, const excitacao_config_t *cfg, float saida_max, registro_t *registro);
+float excitacao_passo(excitacao_t *ex, float lida, float temp, int64_t t_us);
+const char *excitacao_nome_estado(int estado);
+const char *excitacao_nome_fase(int modo);
+const char *excitacao_nome_sinal(int sinal);
+int excitacao_busca_sinal(const char *nome);
+
+#endif
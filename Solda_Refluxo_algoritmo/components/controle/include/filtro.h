@@ -0,0 +1,78 @@
+#ifndef FILTRO_H
+#define FILTRO_H
+
+/**
+ * @brief Filtro da temperatura entre a leitura e o PID. E uma cadeia de estagios aplicados em sequencia;
+ * a ordem dos estagios e os parametros de cada um sao definidos na compilacao:
+ *
+ *   -DFILTRO_CADEIA=FILTRO_MEDIANA,FILTRO_IIR   estagios na ordem em que sao aplicados (FILTRO_NENHUM desliga)
+ *   -DFILTRO_MEDIANA_N=5                        janela da mediana (impar, ate FILTRO_MEDIANA_MAX)
+ *   -DFILTRO_IIR_CORTE_HZ=0.1                   frequencia de corte do IIR de primeira ordem
+ *   -DFILTRO_KALMAN_Q=0.05 -DFILTRO_KALMAN_R=1  variancia do processo e da medida do Kalman escalar
+ */
+
+#include <stdint.h>
+
+enum {
+    FILTRO_NENHUM = 0,                              //Passa a amostra sem alterar
+    FILTRO_MEDIANA,                                 //Mediana das ultimas N amostras
+    FILTRO_IIR,                                     //Passa-baixas de primeira ordem
+    FILTRO_KALMAN,                                  //Kalman escalar (temperatura como passeio aleatorio)
+};
+
+#ifndef FILTRO_CADEIA
+#define FILTRO_CADEIA FILTRO_MEDIANA, FILTRO_IIR
+#endif
+#ifndef FILTRO_MEDIANA_N
+#define FILTRO_MEDIANA_N 3
+#endif
+#ifndef FILTRO_IIR_CORTE_HZ
+#define FILTRO_IIR_CORTE_HZ 0.2f
+#endif
+#ifndef FILTRO_KALMAN_Q
+#define FILTRO_KALMAN_Q 0.05f
+#endif
+#ifndef FILTRO_KALMAN_R
+#define FILTRO_KALMAN_R 1.0f
+#endif
+
+#define FILTRO_MEDIANA_MAX 9
+#define FILTRO_MAX_ESTAGIOS 4
+
+/**
+ * @brief Um estagio da cadeia
+ */
+typedef struct {
+    int tipo;
+    union {
+        struct {
+            float janela[FILTRO_MEDIANA_MAX];
+            uint8_t n, pos, cheia;
+        } mediana;
+        struct {
+            float a;                                //Coeficiente: y += a * (x - y)
+            float y;
+            uint8_t iniciado;
+        } iir;
+        struct {
+            float q, r;
+            float x, p;                             //Estimativa e variancia
+            uint8_t iniciado;
+        } kalman;
+    };
+} filtro_estagio_t;
+
+/**
+ * @brief Cadeia de estagios
+ */
+typedef struct {
+    filtro_estagio_t estagios[FILTRO_MAX_ESTAGIOS];
+    int n;
+} filtro_t;
+
+void filtro_inicia(filtro_t *filtro, float T);
+void filtro_estagio_inicia(filtro_estagio_t *estagio, int tipo, float T);
+float filtro_estagio_aplica(filtro_estagio_t *estagio, float x);
+float filtro_aplica(filtro_t *filtro, float x);
+
+#endif
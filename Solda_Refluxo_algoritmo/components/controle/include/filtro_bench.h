@@ -0,0 +1,21 @@
+#ifndef FILTRO_BENCH_H
+#define FILTRO_BENCH_H
+
+#include <stdint.h>
+#include "bench.h"
+
+#define FILTRO_BENCH_N_CASOS 4                      //Mediana, IIR, Kalman e a cadeia da compilacao
+#define FILTRO_BENCH_AMOSTRAS 1024
+
+/**
+ * @brief Resultado do benchmark de um estagio
+ */
+typedef struct {
+    const char *nome;
+    uint32_t ciclos;                                //Ciclos por amostra (media)
+    float rms_ruido;                                //Desvio RMS da saida em relacao ao sinal sem ruido
+} filtro_bench_resultado_t;
+
+void filtro_bench_executa(bench_ciclos_t ciclos, filtro_bench_resultado_t res[FILTRO_BENCH_N_CASOS]);
+
+#endif
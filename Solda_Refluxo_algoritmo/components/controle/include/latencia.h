@@ -0,0 +1,63 @@
+#ifndef LATENCIA_H
+#define LATENCIA_H
+
+/**
+ * @brief Instrumentacao do laco de controle. Cada iteracao registra o tempo de cada fase (aquisicao, filtro,
+ * perfil, PID e atuacao), o tempo de resposta (amostra pronta ate o rele atualizado) e o desvio do intervalo
+ * entre amostras em relacao ao periodo nominal. Os tempos vao para histogramas de faixas fixas em potencias de 2 us.
+ *
+ * Uma iteracao:
+ *   latencia_inicio(lat, t_amostra, t_pronta);
+ *   ... latencia_marca(lat, LATENCIA_FILTRO); ... latencia_marca(lat, LATENCIA_PID); ...
+ *   latencia_fim(lat);
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum {
+    LATENCIA_AQUISICAO = 0,                         //Leitura do sensor ate a amostra chegar no laco
+    LATENCIA_FILTRO,
+    LATENCIA_PERFIL,
+    LATENCIA_PID,
+    LATENCIA_ATUACAO,                               //Alteracao do duty do rele
+    LATENCIA_RESPOSTA,                              //Amostra pronta ate o fim da atuacao
+    LATENCIA_JITTER,                                //|intervalo entre amostras - periodo|
+    LATENCIA_N_FASES
+};
+
+/*Faixa 0: < 1 us; faixa k: [2^(k-1), 2^k) us; a ultima acumula o que passar de 2^(LATENCIA_N_FAIXAS-2) us*/
+#define LATENCIA_N_FAIXAS 24
+
+/**
+ * @brief Histograma de uma fase
+ */
+typedef struct {
+    uint32_t faixas[LATENCIA_N_FAIXAS];
+    uint32_t n;
+    uint32_t max_us;
+    uint64_t soma_us;
+} latencia_hist_t;
+
+typedef struct {
+    int64_t (*relogio_us)(void);                    //Relogio monotonico em us (esp_timer_get_time no ESP32)
+    uint32_t periodo_us;                            //Periodo nominal, que tambem e o prazo da resposta
+    latencia_hist_t hist[LATENCIA_N_FASES];
+    uint32_t prazos_perdidos;                       //Respostas que passaram do periodo
+    uint32_t amostras_atrasadas;                    //Intervalos entre amostras maiores que 1,5 periodo
+    int64_t t_pronta;                               //Inicio da iteracao atual
+    int64_t t_marca;                                //Fim da ultima fase registrada
+    int64_t t_amostra_ant;                          //Instante da amostra anterior (0 = nenhuma)
+    bool zerar;                                     //Pedido de latencia_zera, atendido no proximo latencia_inicio
+} latencia_t;
+
+void latencia_inicia(latencia_t *lat, int64_t (*relogio_us)(void), uint32_t periodo_us);
+void latencia_zera(latencia_t *lat);
+void latencia_registra(latencia_t *lat, int fase, int64_t us);
+void latencia_inicio(latencia_t *lat, int64_t t_amostra_us, int64_t t_pronta_us);
+void latencia_marca(latencia_t *lat, int fase);
+void latencia_fim(latencia_t *lat);
+void latencia_imprime(const latencia_t *lat);
+const char *latencia_nome_fase(int fase);
+
+#endif
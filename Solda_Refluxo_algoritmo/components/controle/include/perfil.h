@@ -0,0 +1,97 @@
+#ifndef PERFIL_H
+#define PERFIL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "trajetoria.h"
+#include "registro.h"
+
+/**
+ * @brief Perfil de temperatura como uma tabela de segmentos. Em todos os tipos o setpoint vai do valor no inicio
+ * do segmento ate o alvo por uma trajetoria com a taxa dada (0 = a maior permitida) e aceleracao e jerk limitados
+ * (ver trajetoria.h); o tipo define quando o segmento termina:
+ *
+ *   PERFIL_RAMPA    quando a temperatura passa de limite (ou depois de duracao_s, se > 0)
+ *   PERFIL_PATAMAR  depois de duracao_s
+ *   PERFIL_RESFRIA  quando a temperatura fica abaixo de limite (ou depois de duracao_s, se > 0). A rampa parte
+ *                   da menor entre o setpoint e a temperatura, para o rele nao religar no inicio do resfriamento
+ */
+enum {
+    PERFIL_RAMPA = 0,
+    PERFIL_PATAMAR,
+    PERFIL_RESFRIA,
+    PERFIL_N_TIPOS
+};
+
+#define PERFIL_MAX_SEGMENTOS 12
+#define PERFIL_NOME_MAX 20
+
+/**
+ * @brief Indices dos segmentos da tabela padrao (o perfil original do firmware)
+ */
+enum {
+    PERFIL_AQUECIMENTO = 0,                         //Aquece ate 100 graus e espera
+    PERFIL_PRE_AQUECIMENTO,                         //Aumenta a temperatura ate 150 graus
+    PERFIL_IMERSAO,                                 //Mantem 150 graus
+    PERFIL_REFLUXO_1,                               //Mantem 195 graus
+    PERFIL_REFLUXO_2,                               //Aumenta a temperatura ate 240 graus
+    PERFIL_REFLUXO_3,                               //Mantem 240 graus
+    PERFIL_RESFRIAMENTO,                            //Ferro desligado
+    PERFIL_N_ESTAGIOS
+};
+
+typedef struct {
+    char nome[PERFIL_NOME_MAX];
+    uint8_t tipo;                                   //PERFIL_RAMPA, PERFIL_PATAMAR ou PERFIL_RESFRIA
+    float alvo;                                     //Setpoint final em graus
+    float taxa;                                     //Graus/s ate o alvo (0 = a maior que a aceleracao e o jerk permitem)
+    float duracao_s;                                //Tempo do patamar; tempo maximo da rampa e do resfriamento (0 = sem limite)
+    float limite;                                   //Temperatura de saida da rampa e do resfriamento
+} perfil_segmento_t;
+
+typedef struct {
+    perfil_segmento_t segmentos[PERFIL_MAX_SEGMENTOS];
+    int n;
+} perfil_tabela_t;
+
+extern const perfil_tabela_t perfil_tabela_padrao;
+
+/**
+ * @brief Estado do perfil de temperatura. Cada chamada de perfil_passo corresponde a uma amostra; a duracao dos
+ * segmentos e o setpoint sao calculados pelo instante das amostras, nao pelo numero de chamadas
+ */
+typedef struct {
+    const perfil_tabela_t *tabela;
+    int modo_operacao;                              //Segmento atual
+    int t_atual;                                    //Numero de amostras desde o inicio
+    int64_t inicio_estagio_us;                      //Instante da amostra em que o segmento atual comecou
+    trajetoria_t trajetoria;                        //Setpoint do segmento atual
+    float setpoint;                                 //Temperatura desejada
+    float derivada;                                 //Taxa do setpoint em graus/s, para feedforward
+    bool terminado;                                 //Perfil concluido
+    bool iniciado;                                  //O primeiro segmento ja comecou
+
+    registro_t *registro;                           //Log da temperatura e dos segmentos (pode ser NULL)
+} perfil_t;
+
+/**
+ * @brief Reconstrucao do setpoint a partir do log, que so guarda o inicio de cada segmento
+ */
+typedef struct {
+    const perfil_tabela_t *tabela;
+    trajetoria_t trajetoria;                        //Trajetoria do segmento do ultimo registro
+    int modo;
+    uint32_t inicio_ms;
+    float inicio;
+} perfil_ideal_t;
+
+void perfil_inicia(perfil_t *perfil, const perfil_tabela_t *tabela, registro_t *registro);
+float perfil_setpoint(perfil_t *perfil, float temp, int64_t t_us);
+int perfil_passo(perfil_t *perfil, float temp, int64_t t_us);
+const char *perfil_nome_estagio(const perfil_tabela_t *tabela, int modo_operacao);
+bool perfil_tabela_valida(const perfil_tabela_t *tabela);
+int perfil_tabela_le(perfil_tabela_t *tabela, const char *texto);
+void perfil_ideal_inicia(perfil_ideal_t *ideal, const perfil_tabela_t *tabela);
+float perfil_ideal(perfil_ideal_t *ideal, const registro_evento_t *ev);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef PERFIS_SOLDA_H
+#define PERFIS_SOLDA_H
+
+/**
+ * @brief Perfis das pastas de solda mais comuns, definidos na compilacao. Cada perfil e uma lista de segmentos
+ * S(tipo, inicio em graus, alvo em graus, taxa em centesimos de grau/s, duracao maxima em s, limite em graus, nome)
+ * expandida em perfis_solda.c para um perfil_tabela_t constante (fica na flash). O inicio e o alvo do segmento
+ * anterior (PERFIS_AMBIENTE_C no primeiro) e so entra nas verificacoes: no ciclo o segmento parte do setpoint em que
+ * o anterior terminou. Na expansao a compilacao falha se algum segmento passar dos limites abaixo, se a curva em S
+ * (trajetoria.h) de algum segmento nao chegar no alvo dentro da duracao maxima (conta so com inteiros, ver CABE) ou
+ * se o perfil nao couber no log sem descartar as primeiras amostras, contando todas as amostras da duracao maxima de
+ * cada segmento no pior caso de REGISTRO_BLOCOS_PIOR_CASO.
+ *
+ * Todo segmento tem duracao maxima, para a rampa nao aquecer para sempre se o forno nao chegar no limite.
+ */
+
+#include "perfil.h"
+
+#ifndef PERFIS_TAXA_MAX_CC_S
+#define PERFIS_TAXA_MAX_CC_S 300                    //Taxa maxima de aquecimento (3 graus/s)
+#endif
+#ifndef PERFIS_RESFRIA_MAX_CC_S
+#define PERFIS_RESFRIA_MAX_CC_S 600                 //Taxa maxima de resfriamento (6 graus/s)
+#endif
+#ifndef PERFIS_PICO_MAX_C
+#define PERFIS_PICO_MAX_C 260                       //Maior temperatura que o ferro pode ter como alvo
+#endif
+#ifndef PERFIS_CAPACIDADE_BLOCOS
+#define PERFIS_CAPACIDADE_BLOCOS REGISTRO_N_BLOCOS  //Blocos do log (o perfil nao pode descartar os primeiros)
+#endif
+#ifndef PERFIS_AMBIENTE_C
+#define PERFIS_AMBIENTE_C 25                        //Temperatura no inicio do primeiro segmento
+#endif
+#ifndef PERFIS_PERIODO_MS
+#define PERFIS_PERIODO_MS 500                       //Periodo de amostragem
+#endif
+
+/*SAC305 (Sn96,5Ag3Cu0,5, liquidus 217 graus): pico de 245 graus*/
+#define PERFIL_SAC305_SEGMENTOS(S)                                                      \
+    S(PERFIL_RAMPA,   PERFIS_AMBIENTE_C, 150, 150, 180, 140, "Pre aquecimento")         \
+    S(PERFIL_PATAMAR, 150,               200,  55, 105,   0, "Imersao termica")         \
+    S(PERFIL_RAMPA,   200,               245, 200,  90, 235, "Refluxo")                 \
+    S(PERFIL_PATAMAR, 245,               245,   0,  30,   0, "Pico")                    \
+    S(PERFIL_RESFRIA, 245,                50, 400, 120, 100, "Resfriamento")
+
+/*Sn63Pb37 (eutetica, 183 graus): pico de 220 graus*/
+#define PERFIL_SN63PB37_SEGMENTOS(S)                                                    \
+    S(PERFIL_RAMPA,   PERFIS_AMBIENTE_C, 140, 150, 180, 130, "Pre aquecimento")         \
+    S(PERFIL_PATAMAR, 140,               165,  30,  95,   0, "Imersao termica")         \
+    S(PERFIL_RAMPA,   165,               220, 200,  90, 210, "Refluxo")                 \
+    S(PERFIL_PATAMAR, 220,               220,   0,  30,   0, "Pico")                    \
+    S(PERFIL_RESFRIA, 220,                50, 400, 120, 100, "Resfriamento")
+
+/*SnBi de baixa temperatura (Sn42Bi58, eutetica, 138 graus): pico de 175 graus*/
+#define PERFIL_SNBI_SEGMENTOS(S)                                                        \
+    S(PERFIL_RAMPA,   PERFIS_AMBIENTE_C, 100, 100, 150,  90, "Pre aquecimento")         \
+    S(PERFIL_PATAMAR, 100,               120,  30,  90,   0, "Imersao termica")         \
+    S(PERFIL_RAMPA,   120,               175, 150,  90, 165, "Refluxo")                 \
+    S(PERFIL_PATAMAR, 175,               175,   0,  30,   0, "Pico")                    \
+    S(PERFIL_RESFRIA, 175,                50, 300, 120,  80, "Resfriamento")
+
+extern const perfil_tabela_t perfil_sac305;
+extern const perfil_tabela_t perfil_sn63pb37;
+extern const perfil_tabela_t perfil_snbi;
+
+const perfil_tabela_t *perfis_solda_busca(const char *nome);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef PID_H
+#define PID_H
+
+#include <stdint.h>
+#include "pid_nucleo.h"
+
+/*Tipos numericos do PID, escolhidos em tempo de compilacao com -DPID_NUMERICO=...*/
+#define PID_FLOAT  0
+#define PID_Q16_16 1
+#define PID_Q8_24  2                                //Sinais Q16.16, ganhos Q8.24
+
+#ifndef PID_NUMERICO
+#define PID_NUMERICO PID_FLOAT
+#endif
+
+#define PID_SAIDA_MAX 1024                          //max_d de rele.c (LEDC de 10 bits)
+
+#if PID_NUMERICO == PID_FLOAT
+typedef pid_f32_t pid_nucleo_t;
+#elif PID_NUMERICO == PID_Q16_16
+typedef pid_q_t pid_nucleo_t;
+#define PID_Q_FRAC PID_Q16_FRAC
+#elif PID_NUMERICO == PID_Q8_24
+typedef pid_q_t pid_nucleo_t;
+#define PID_Q_FRAC PID_Q24_FRAC
+#else
+#error "PID_NUMERICO deve ser PID_FLOAT, PID_Q16_16 ou PID_Q8_24"
+#endif
+
+/**
+ * @brief Estado do PID discretizado por Tustin
+ */
+typedef struct {
+    float kp, ki, kd;                               //Ganhos
+    float T;                                        //Periodo de amostragem usado nos coeficientes, em s
+    pid_nucleo_t nucleo;                            //Estado no tipo numerico escolhido
+    float P, I, D;                                  //Termos da ultima iteracao
+    float saida;                                    //Saida da ultima iteracao
+    uint8_t sat;                                    //Flags de saturacao da ultima iteracao (PID_SAT_*)
+    uint32_t saturacoes;                            //Iteracoes com saturacao
+} pid_ctrl_t;
+
+void pid_inicia(pid_ctrl_t *pid, float kp, float ki, float kd, float T);
+void pid_ganhos(pid_ctrl_t *pid, float kp, float ki, float kd);
+float pid_saida_com(const pid_ctrl_t *pid, float kp, float ki, float kd, float erro);
+float pid_atualiza(pid_ctrl_t *pid, float setpoint, float temp, float dt);
+const char *pid_nome_numerico(void);
+
+#endif
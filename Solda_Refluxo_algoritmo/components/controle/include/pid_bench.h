@@ -0,0 +1,22 @@
+#ifndef PID_BENCH_H
+#define PID_BENCH_H
+
+#include <stdint.h>
+#include "bench.h"
+
+#define PID_BENCH_N_TIPOS 3
+#define PID_BENCH_ATUALIZACOES 1024
+
+/**
+ * @brief Resultado do benchmark de um tipo numerico
+ */
+typedef struct {
+    const char *nome;
+    uint32_t ciclos;                                //Ciclos por atualizacao (media)
+    uint32_t hash;                                  //FNV-1a das saidas: deve ser igual no host e no ESP32
+    uint32_t saturacoes;
+} pid_bench_resultado_t;
+
+void pid_bench_executa(bench_ciclos_t ciclos, pid_bench_resultado_t res[PID_BENCH_N_TIPOS]);
+
+#endif
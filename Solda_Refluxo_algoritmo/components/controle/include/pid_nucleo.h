@@ -0,0 +1,192 @@
+#ifndef PID_NUCLEO_H
+#define PID_NUCLEO_H
+
+/**
+ * @brief Nucleos do PID (Tustin) para cada tipo numerico: float, Q16.16 e ganhos em Q8.24.
+ *
+ * Termos de Tustin, com e o erro e e_ant o da amostra anterior:
+ *
+ *   P[k] = kp e
+ *   I[k] = I[k-1] + ki T/2 (e + e_ant)              limitado a [0, saida_max] (anti-windup: o rele nao sai disso)
+ *   D[k] = cd (e - e_ant) + ad D[k-1]              cd = 2 kd / (2 Tf + T), ad = (2 Tf - T) / (2 Tf + T)
+ *
+ * A derivada tem um filtro de primeira ordem com constante Tf = PID_FILTRO_D_S. Com Tf = 0 ela e a de Tustin pura
+ * (cd = 2 kd / T, ad = -1), cujo polo em -1 oscila na frequencia de Nyquist: qualquer ruido ou mudanca de T a cada
+ * amostra se acumula no termo D e o forno nao acompanha o perfil.
+ *
+ * Os nucleos em ponto fixo trabalham so com inteiros, com deslocamento aritmetico e saturacao em 32 bits,
+ * entao o resultado e identico bit a bit no host e no ESP32. O nucleo em float tambem e, desde que compilado
+ * sem contracao de multiplicacao e soma (-ffp-contract=off, ver CMakeLists.txt do componente).
+ *
+ * Nos dois nucleos em ponto fixo os sinais (erro e saida) sao Q16.16: inteiros em unidades de 2^-16 (grau ou
+ * contagem de duty), saturando em +-32768. So os ganhos (kp, ci e cd) mudam: 16 bits fracionarios em Q16.16 ou 24
+ * em Q8.24. O "Q8.24" e entao sinais Q16.16 com ganhos Q8.24, que tem 256 vezes mais resolucao mas saturam em
+ * +-128 (com T = 0,5 s e Tf = 1 s, kd ate 160); o produto ganho x sinal e feito em 64 bits e volta a Q16.16 (pid_q_mul). Com
+ * ganhos que cabem nos dois formatos a saida so difere pelo arredondamento dos coeficientes (o ad do filtro da
+ * derivada nao e exato em nenhum dos dois, entao os hashes do bench_pid diferem).
+ */
+
+#include <stdint.h>
+#include <math.h>
+
+#define PID_Q_SINAL_FRAC 16                         //Bits fracionarios dos sinais
+#define PID_Q16_FRAC 16                             //Bits fracionarios dos ganhos em Q16.16
+#define PID_Q24_FRAC 24                             //Bits fracionarios dos ganhos em Q8.24
+#ifndef PID_FILTRO_D_S
+#define PID_FILTRO_D_S 1.0f                         //Constante de tempo do filtro da derivada em s
+#endif
+
+/*Flags de saturacao da ultima atualizacao*/
+#define PID_SAT_NUMERICA 0x01                       //Algum calculo estourou o tipo numerico
+#define PID_SAT_SAIDA    0x02                       //Saida fora de [0, saida_max] (o rele vai saturar)
+
+/**
+ * @brief Nucleo em float
+ */
+typedef struct {
+    float kp, ci, cd, ad;                           //kp, ki*T/2, 2*kd/(2*Tf+T) e (2*Tf-T)/(2*Tf+T)
+    float erro_ant;
+    float P, I, D, saida;                           //I e D sao tambem o estado da proxima atualizacao
+    float saida_max;
+    uint32_t saturacoes;                            //Atualizacoes com alguma flag de saturacao
+    uint8_t sat;                                    //Flags da ultima atualizacao
+} pid_f32_t;
+
+/**
+ * @brief Nucleo em ponto fixo: sinais Q16.16, ganhos Q16.16 ou Q8.24, conforme o frac passado
+ */
+typedef struct {
+    int32_t kp, ci, cd, ad;
+    int32_t erro_ant;
+    int32_t P, I, D, saida;
+    int32_t saida_max;
+    uint32_t saturacoes;
+    uint8_t sat;
+} pid_q_t;
+
+static inline void pid_f32_inicia(pid_f32_t *pid, float kp, float ki, float kd, float T, float saida_max){
+    pid->kp = kp;
+    pid->ci = (ki*T)/2;
+    pid->cd = 2*kd/(2*PID_FILTRO_D_S + T);
+    pid->ad = (2*PID_FILTRO_D_S - T)/(2*PID_FILTRO_D_S + T);
+    pid->erro_ant = 0;
+    pid->P = pid->I = pid->D = pid->saida = 0;
+    pid->saida_max = saida_max;
+    pid->saturacoes = 0;
+    pid->sat = 0;
+}
+
+/**
+ * @brief Recalcula os coeficientes de Tustin para um novo periodo de amostragem
+ */
+static inline void pid_f32_periodo(pid_f32_t *pid, float ki, float kd, float T){
+    pid->ci = (ki*T)/2;
+    pid->cd = 2*kd/(2*PID_FILTRO_D_S + T);
+    pid->ad = (2*PID_FILTRO_D_S - T)/(2*PID_FILTRO_D_S + T);
+}
+
+static inline float pid_f32_atualiza(pid_f32_t *pid, float erro){
+    pid->P = pid->kp * erro;
+    pid->I = fminf(fmaxf(pid->I + pid->ci*(erro + pid->erro_ant), 0), pid->saida_max);
+    pid->D = pid->cd*(erro - pid->erro_ant) + pid->ad*pid->D;
+    pid->saida = pid->P + pid->I + pid->D;
+    pid->erro_ant = erro;
+
+    pid->sat = (pid->saida > pid->saida_max || pid->saida < 0) ? PID_SAT_SAIDA : 0;
+    if(pid->sat){
+        pid->saturacoes++;
+    }
+    return pid->saida;
+}
+
+/*Satura em 32 bits e marca a saturacao*/
+static inline int32_t pid_q_sat(int64_t x, uint8_t *sat){
+    if(x > INT32_MAX){
+        *sat = 1;
+        return INT32_MAX;
+    }
+    if(x < INT32_MIN){
+        *sat = 1;
+        return INT32_MIN;
+    }
+    return (int32_t)x;
+}
+
+static inline int32_t pid_q_mul(int32_t a, int32_t b, int frac, uint8_t *sat){
+    return pid_q_sat(((int64_t)a * b) >> frac, sat);
+}
+
+static inline int32_t pid_q_add(int32_t a, int32_t b, uint8_t *sat){
+    return pid_q_sat((int64_t)a + b, sat);
+}
+
+static inline int32_t pid_q_sub(int32_t a, int32_t b, uint8_t *sat){
+    return pid_q_sat((int64_t)a - b, sat);
+}
+
+/**
+ * @brief Converte um float para ponto fixo com frac bits, arredondando e saturando
+ */
+static inline int32_t pid_q_de_float(float x, int frac, uint8_t *sat){
+    return pid_q_sat(llrintf(ldexpf(x, frac)), sat);
+}
+
+static inline float pid_q_para_float(int32_t x, int frac){
+    return ldexpf((float)x, -frac);
+}
+
+/**
+ * @brief Recalcula os coeficientes de Tustin para um novo periodo de amostragem
+ *
+ * @return uint8_t PID_SAT_NUMERICA se algum coeficiente nao coube no formato
+ */
+static inline uint8_t pid_q_periodo(pid_q_t *pid, float ki, float kd, float T, int frac){
+    uint8_t sat = 0;
+    pid->ci = pid_q_de_float((ki*T)/2, frac, &sat);
+    pid->cd = pid_q_de_float(2*kd/(2*PID_FILTRO_D_S + T), frac, &sat);
+    pid->ad = pid_q_de_float((2*PID_FILTRO_D_S - T)/(2*PID_FILTRO_D_S + T), frac, &sat);
+    return sat ? PID_SAT_NUMERICA : 0;
+}
+
+static inline void pid_q_inicia(pid_q_t *pid, float kp, float ki, float kd, float T, float saida_max, int frac){
+    uint8_t sat = 0;
+    pid->kp = pid_q_de_float(kp, frac, &sat);
+    pid->ci = pid_q_de_float((ki*T)/2, frac, &sat);
+    pid->cd = pid_q_de_float(2*kd/(2*PID_FILTRO_D_S + T), frac, &sat);
+    pid->ad = pid_q_de_float((2*PID_FILTRO_D_S - T)/(2*PID_FILTRO_D_S + T), frac, &sat);
+    pid->erro_ant = 0;
+    pid->P = pid->I = pid->D = pid->saida = 0;
+    pid->saida_max = pid_q_de_float(saida_max, PID_Q_SINAL_FRAC, &sat);
+    pid->saturacoes = 0;
+    pid->sat = sat ? PID_SAT_NUMERICA : 0;          //Ganho que nao cabe no formato
+}
+
+/**
+ * @brief Uma atualizacao do PID em ponto fixo
+ *
+ * @param pid
+ * @param erro erro em unidades de 2^-16 grau
+ * @param frac bits fracionarios dos ganhos (PID_Q16_FRAC ou PID_Q24_FRAC)
+ * @return int32_t saida em unidades de 2^-16 contagem de duty
+ */
+static inline int32_t pid_q_atualiza(pid_q_t *pid, int32_t erro, int frac){
+    uint8_t sat = 0;
+    pid->P = pid_q_mul(pid->kp, erro, frac, &sat);
+    int32_t I = pid_q_add(pid->I, pid_q_mul(pid->ci, pid_q_add(erro, pid->erro_ant, &sat), frac, &sat), &sat);
+    pid->I = I < 0 ? 0 : I > pid->saida_max ? pid->saida_max : I;
+    pid->D = pid_q_add(pid_q_mul(pid->cd, pid_q_sub(erro, pid->erro_ant, &sat), frac, &sat),
+                       pid_q_mul(pid->ad, pid->D, frac, &sat), &sat);
+    pid->saida = pid_q_add(pid_q_add(pid->P, pid->I, &sat), pid->D, &sat);
+    pid->erro_ant = erro;
+
+    pid->sat = sat ? PID_SAT_NUMERICA : 0;
+    if(pid->saida > pid->saida_max || pid->saida < 0){
+        pid->sat |= PID_SAT_SAIDA;
+    }
+    if(pid->sat){
+        pid->saturacoes++;
+    }
+    return pid->saida;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef REFLOW_H
+#define REFLOW_H
+
+#include "reflow_hal.h"
+#include "pid.h"
+#include "perfil.h"
+#include "filtro.h"
+#include "latencia.h"
+#include "adaptativo.h"
+#include "escalonamento.h"
+
+/**
+ * @brief Chamada a cada mudanca de estagio do perfil (pode ser NULL)
+ */
+typedef void (*reflow_estagio_cb_t)(void *arg, int modo_operacao);
+
+/**
+ * @brief Um ciclo completo de solda por refluxo sobre uma HAL
+ */
+typedef struct {
+    const reflow_hal_t *hal;
+    pid_ctrl_t *pid;
+    perfil_t *perfil;
+    filtro_t *filtro;                               //Filtro antes do PID (pode ser NULL)
+    latencia_t *latencia;                           //Tempos de cada fase (pode ser NULL)
+    adaptativo_t *adaptativo;                       //Controle auto-ajustavel em volta do PID (NULL = ganhos fixos)
+    escalonamento_t *escalonamento;                 //Ganhos por estagio e temperatura, sem o adaptativo (pode ser NULL)
+    reflow_estagio_cb_t estagio_cb;
+    void *arg;
+    int64_t t_ultima_us;                            //Instante da ultima amostra usada pelo PID (0 = nenhuma)
+    float filtrada;                                 //Temperatura usada pelo PID na ultima amostra
+    float saida;                                    //Duty pedido na ultima amostra
+} reflow_t;
+
+float reflow_passo(reflow_t *reflow);
+int reflow_executa(reflow_t *reflow, int64_t max_us);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef REFLOW_HAL_H
+#define REFLOW_HAL_H
+
+#include <stdint.h>
+#include "max6675_amostra.h"
+
+/**
+ * @brief Camada de abstracao do hardware usado pelo controle do forno.
+ * A logica de controle (PID e perfil de temperatura) so conversa com o sensor, o atuador e o relogio
+ * por meio desta estrutura. No ESP32 ela e preenchida por hal_esp32 (MAX6675 + rele no LEDC) e no
+ * host por hal_host (planta simulada com tempo virtual).
+ */
+typedef struct reflow_hal {
+    void *ctx;                                      //Contexto passado para todas as funcoes
+
+    /*Sensor - le uma amostra do MAX6675. Bloqueia pelo tempo de conversao do sensor*/
+    void (*le_sensor)(void *ctx, max6675_amostra_t *amostra);
+    /*Atuador - altera o duty cycle do rele (0 a max_d)*/
+    void (*altera_duty)(void *ctx, float d);
+    /*Relogio - tempo monotono em microssegundos*/
+    int64_t (*agora_us)(void *ctx);
+    /*Relogio - espera ms milissegundos*/
+    void (*espera_ms)(void *ctx, uint32_t ms);
+} reflow_hal_t;
+
+#endif
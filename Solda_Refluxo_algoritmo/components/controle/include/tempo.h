@@ -0,0 +1,26 @@
+#ifndef TEMPO_H
+#define TEMPO_H
+
+#include <stdint.h>
+
+/**
+ * @brief Base de tempo unica do controle: microssegundos num relogio monotono, desde a partida. Amostras, mudancas
+ * de segmento, registros do log, da telemetria e do diario usam este relogio, e as duracoes sao diferencas entre
+ * instantes, nunca contagens de iteracoes.
+ *
+ *   ESP32  esp_timer_get_time (hal_esp32.c); a leitura do MAX6675 e marcada no mesmo relogio, na interrupcao do SPI
+ *   host   tempo virtual da ultima HAL iniciada na thread (hal_host.c), que so anda com a planta simulada
+ */
+int64_t tempo_us(void);
+
+/**
+ * @brief Tempo em us desde um instante de tempo_us
+ *
+ * @param desde_us
+ * @return int64_t
+ */
+static inline int64_t tempo_decorrido_us(int64_t desde_us){
+    return tempo_us() - desde_us;
+}
+
+#endif
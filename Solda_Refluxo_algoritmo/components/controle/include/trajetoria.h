@@ -0,0 +1,37 @@
+#ifndef TRAJETORIA_H
+#define TRAJETORIA_H
+
+/**
+ * @brief Trajetoria do setpoint entre dois valores com taxa, aceleracao e jerk limitados (curva em S).
+ * A taxa sobe de 0 ate a taxa de cruzeiro por uma curva suave (aceleracao continua), fica constante e desce do
+ * mesmo jeito ate o alvo. O formato das transicoes vem de uma tabela normalizada em flash, entao o valor e a
+ * derivada em qualquer instante custam uma interpolacao.
+ *
+ * Limites definidos na compilacao, inteiros para entrarem nas verificacoes de perfis_solda.c:
+ *   -DTRAJETORIA_ACEL_MAX_MG=100   aceleracao maxima do setpoint em milesimos de grau/s^2 (0 = sem limite)
+ *   -DTRAJETORIA_JERK_MAX_MG=20    jerk maximo em milesimos de grau/s^3 (0 = sem limite)
+ */
+
+#ifndef TRAJETORIA_ACEL_MAX_MG
+#define TRAJETORIA_ACEL_MAX_MG 100
+#endif
+#ifndef TRAJETORIA_JERK_MAX_MG
+#define TRAJETORIA_JERK_MAX_MG 20
+#endif
+#define TRAJETORIA_ACEL_MAX (TRAJETORIA_ACEL_MAX_MG / 1000.0f) //graus/s^2
+#define TRAJETORIA_JERK_MAX (TRAJETORIA_JERK_MAX_MG / 1000.0f) //graus/s^3
+
+typedef struct {
+    float inicio;                                   //Valor no instante 0
+    float sinal;                                    //+1 subindo, -1 descendo
+    float distancia;                                //|alvo - inicio|
+    float v;                                        //Taxa de cruzeiro em graus/s (0 = degrau, sem limites)
+    float ta;                                       //Duracao da aceleracao (e da desaceleracao) em s
+    float tc;                                       //Duracao do cruzeiro em s
+} trajetoria_t;
+
+void trajetoria_inicia(trajetoria_t *traj, float inicio, float alvo, float taxa_max, float acel_max, float jerk_max);
+float trajetoria_valor(const trajetoria_t *traj, float t_s, float *derivada);
+float trajetoria_duracao(const trajetoria_t *traj);
+
+#endif
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <string.h>
+#include "latencia.h"
+
+static const char *nomes[LATENCIA_N_FASES] = {
+    "aquisicao",
+    "filtro",
+    "perfil",
+    "pid",
+    "atuacao",
+    "resposta",
+    "jitter",
+};
+
+/**
+ * @brief Inicia a instrumentacao com os histogramas vazios
+ *
+ * @param lat
+ * @param relogio_us relogio monotonico em us usado para medir as fases
+ * @param periodo_us periodo nominal das amostras
+ */
+void latencia_inicia(latencia_t *lat, int64_t (*relogio_us)(void), uint32_t periodo_us){
+    memset(lat, 0, sizeof(*lat));
+    lat->relogio_us = relogio_us;
+    lat->periodo_us = periodo_us;
+}
+
+/**
+ * @brief Pede para esvaziar os histogramas e os contadores, mantendo o relogio e o periodo. Pode ser chamada de
+ * outra tarefa: so marca o pedido, e quem zera e o proprio laco, no proximo latencia_inicio
+ *
+ * @param lat
+ */
+void latencia_zera(latencia_t *lat){
+    __atomic_store_n(&lat->zerar, true, __ATOMIC_RELEASE);
+}
+
+/*Faixa do histograma: 0 para < 1 us, k para [2^(k-1), 2^k) us*/
+static int faixa(uint32_t us){
+    int k = 0;
+    while(us && k < LATENCIA_N_FAIXAS - 1){
+        us >>= 1;
+        k++;
+    }
+    return k;
+}
+
+/**
+ * @brief Registra um tempo medido fora de latencia_marca
+ *
+ * @param lat
+ * @param fase LATENCIA_AQUISICAO ... LATENCIA_JITTER
+ * @param us tempo em us (negativos contam como 0)
+ */
+void latencia_registra(latencia_t *lat, int fase, int64_t us){
+    uint32_t v = us < 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    latencia_hist_t *h = &lat->hist[fase];
+    h->faixas[faixa(v)]++;
+    h->n++;
+    h->soma_us += v;
+    if(v > h->max_us){
+        h->max_us = v;
+    }
+}
+
+/**
+ * @brief Inicio de uma iteracao. Registra o desvio do intervalo entre amostras; um instante que volta no tempo
+ * (novo ciclo com o relogio reiniciado) so reinicia a contagem do intervalo
+ *
+ * @param lat
+ * @param t_amostra_us instante da amostra (relogio de quem fez a leitura)
+ * @param t_pronta_us instante, no relogio da instrumentacao, a partir do qual se mede a resposta
+ */
+void latencia_inicio(latencia_t *lat, int64_t t_amostra_us, int64_t t_pronta_us){
+    if(__atomic_exchange_n(&lat->zerar, false, __ATOMIC_ACQUIRE)){
+        memset(lat->hist, 0, sizeof(lat->hist));
+        lat->prazos_perdidos = 0;
+        lat->amostras_atrasadas = 0;
+    }
+    if(lat->t_amostra_ant && t_amostra_us > lat->t_amostra_ant){
+        int64_t intervalo = t_amostra_us - lat->t_amostra_ant;
+        int64_t desvio = intervalo - lat->periodo_us;
+        latencia_registra(lat, LATENCIA_JITTER, desvio < 0 ? -desvio : desvio);
+        if(intervalo > lat->periodo_us + lat->periodo_us / 2){
+            lat->amostras_atrasadas++;
+        }
+    }
+    lat->t_amostra_ant = t_amostra_us;
+    lat->t_pronta = t_pronta_us;
+    lat->t_marca = t_pronta_us;
+}
+
+/**
+ * @brief Fim de uma fase: registra o tempo desde a marca anterior
+ *
+ * @param lat
+ * @param fase
+ */
+void latencia_marca(latencia_t *lat, int fase){
+    int64_t agora = lat->relogio_us();
+    latencia_registra(lat, fase, agora - lat->t_marca);
+    lat->t_marca = agora;
+}
+
+/**
+ * @brief Fim da iteracao: registra a resposta e conta o prazo perdido se passou do periodo
+ *
+ * @param lat
+ */
+void latencia_fim(latencia_t *lat){
+    int64_t resposta = lat->t_marca - lat->t_pronta;
+    latencia_registra(lat, LATENCIA_RESPOSTA, resposta);
+    if(resposta > lat->periodo_us){
+        lat->prazos_perdidos++;
+    }
+}
+
+const char *latencia_nome_fase(int fase){
+    if(fase < 0 || fase >= LATENCIA_N_FASES){
+        return "?";
+    }
+    return nomes[fase];
+}
+
+/**
+ * @brief Imprime os histogramas das fases com amostras e os contadores de prazo.
+ * Pode ser chamada de outra tarefa enquanto o laco roda; os valores podem estar uma iteracao desatualizados.
+ *
+ * @param lat
+ */
+void latencia_imprime(const latencia_t *lat){
+    printf("periodo %u us  prazos perdidos %u  amostras atrasadas %u\n", lat->periodo_us, lat->prazos_perdidos,
+           lat->amostras_atrasadas);
+    printf("%-10s %8s %10s %10s\n", "fase", "n", "media us", "max us");
+    for(int i = 0; i < LATENCIA_N_FASES; i++){
+        const latencia_hist_t *h = &lat->hist[i];
+        if(h->n == 0){
+            continue;
+        }
+        printf("%-10s %8u %10.1f %10u\n", nomes[i], h->n, (double)h->soma_us / h->n, h->max_us);
+        printf("          ");
+        for(int k = 0; k < LATENCIA_N_FAIXAS; k++){
+            if(h->faixas[k] == 0){
+                continue;
+            }
+            if(k == 0){
+                printf(" <1:%u", h->faixas[k]);
+            }
+            else if(k == 1){
+                printf(" 1:%u", h->faixas[k]);
+            }
+            else if(k == LATENCIA_N_FAIXAS - 1){
+                printf(" >=%u:%u", 1u << (k - 1), h->faixas[k]);
+            }
+            else{
+                printf(" %u-%u:%u", 1u << (k - 1), (1u << k) - 1, h->faixas[k]);
+            }
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,294 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "perfil.h"
+
+/**
+ * @brief Perfil original do firmware, com os alvos e as saidas de antes e rampas de 1 grau/s (perfis/rampas.txt) no
+ * lugar dos degraus. Os patamares de taxa 0 partem do setpoint em que a rampa anterior saiu pelo limite e chegam no
+ * alvo na maior taxa que TRAJETORIA_ACEL_MAX e TRAJETORIA_JERK_MAX permitem. O resfriamento registra 2 graus a menos
+ * por amostra de 0,5s (4 graus/s) e para depois de 120s.
+ */
+const perfil_tabela_t perfil_tabela_padrao = {
+    .segmentos = {
+        //Aquece ate 100 graus e espera por 3 min
+        { "Aquecimento",     PERFIL_PATAMAR, 100, 1, 180, 0 },
+        //Pre aquecimento - Aumenta a temperatura do ferro ate 150 graus; passando de 130 vai para o proximo
+        { "Pre aquecimento", PERFIL_RAMPA,   150, 1, 0, 150 - 20 },
+        //Imersao termica - Manter a temperatura em 150 graus por 120s
+        { "Imersao termica", PERFIL_PATAMAR, 150, 0, 120, 0 },
+        //Pre aquecimento do refluxo - Manter a temp em 195 por 60s
+        { "Refluxo parte 1", PERFIL_PATAMAR, 195, 1, 60, 0 },
+        //Refluxo parte 2 - Aumentar a temperatura ate 240; passando de 220 vai para o proximo
+        { "Refluxo parte 2", PERFIL_RAMPA,   240, 1, 0, 240 - 20 },
+        //Refluxo parte 3 - Manter a temperatura em 240 por 30s
+        { "Refluxo parte 3", PERFIL_PATAMAR, 240, 0, 30, 0 },
+        //Resfriamento - deixar ferro desligado. Deve ser ate esfriar, mas espera somente 120s para fins praticos
+        { "Resfriamento",    PERFIL_RESFRIA, 0, 4, 120, 0 },
+    },
+    .n = PERFIL_N_ESTAGIOS,
+};
+
+static const char *nomes_tipo[PERFIL_N_TIPOS] = { "rampa", "patamar", "resfria" };
+
+/**
+ * @brief Inicia o perfil no primeiro segmento
+ *
+ * @param perfil
+ * @param tabela segmentos do perfil, devem viver enquanto o perfil for usado
+ * @param registro log de cada amostra (pode ser NULL), ja iniciado
+ */
+void perfil_inicia(perfil_t *perfil, const perfil_tabela_t *tabela, registro_t *registro){
+    perfil->tabela = tabela;
+    perfil->modo_operacao = 0;
+    perfil->t_atual = 0;
+    perfil->inicio_estagio_us = 0;
+    perfil->setpoint = 0;
+    perfil->derivada = 0;
+    perfil->terminado = tabela->n == 0;
+    perfil->iniciado = false;
+    perfil->registro = registro;
+}
+
+/**
+ * @brief Nome do segmento, usado nos logs
+ *
+ * @param tabela
+ * @param modo_operacao
+ * @return const char*
+ */
+const char *perfil_nome_estagio(const perfil_tabela_t *tabela, int modo_operacao){
+    if(modo_operacao < 0 || modo_operacao >= tabela->n){
+        return "?";
+    }
+    return tabela->segmentos[modo_operacao].nome;
+}
+
+/*Armazena a temperatura da amostra atual e avanca t_atual. O setpoint sai do segmento (ver perfil_ideal)*/
+static void registra(perfil_t *perfil, int64_t t_us, float temp){
+    if(perfil->registro){
+        registro_amostra(perfil->registro, t_us, temp);
+    }
+    perfil->t_atual++;
+}
+
+/*Entra no segmento: armazena o tempo e calcula a trajetoria do setpoint ate o alvo. O log guarda o inicio da
+ trajetoria, que e tudo o que perfil_ideal precisa para refazer o setpoint*/
+static void muda_estagio(perfil_t *perfil, int modo_operacao, int64_t t_us, float temp){
+    const perfil_segmento_t *seg = &perfil->tabela->segmentos[modo_operacao];
+    float inicio = perfil->setpoint;
+    if(seg->tipo == PERFIL_RESFRIA && temp < inicio){
+        inicio = temp;
+    }
+    if(perfil->registro){
+        registro_estagio(perfil->registro, t_us, modo_operacao, inicio);
+    }
+    perfil->modo_operacao = modo_operacao;
+    perfil->inicio_estagio_us = t_us;
+    trajetoria_inicia(&perfil->trajetoria, inicio, seg->alvo, seg->taxa, TRAJETORIA_ACEL_MAX, TRAJETORIA_JERK_MAX);
+}
+
+/*Condicao de saida do segmento*/
+static bool segmento_terminou(const perfil_segmento_t *seg, float temp, int64_t decorrido_us){
+    bool tempo = seg->duracao_s > 0 && decorrido_us > (int64_t)(seg->duracao_s * 1e6f);
+    switch(seg->tipo){
+    case PERFIL_RAMPA:
+        return temp > seg->limite || tempo;
+    case PERFIL_RESFRIA:
+        return temp < seg->limite || tempo;
+    default:
+        return tempo;
+    }
+}
+
+/**
+ * @brief Calcula o setpoint da amostra pela trajetoria do segmento atual, sem gravar a amostra nem mudar de
+ * segmento. Para o laco que grava a saida do controle antes da amostra (registro_saida): perfil_setpoint, o
+ * controle, registro_saida e perfil_passo com a mesma amostra, que da o mesmo setpoint
+ *
+ * @param perfil
+ * @param temp Temperatura lida
+ * @param t_us Instante da amostra em us
+ * @return float setpoint
+ */
+float perfil_setpoint(perfil_t *perfil, float temp, int64_t t_us){
+    if(perfil->terminado){
+        return perfil->setpoint;
+    }
+    if(!perfil->iniciado){
+        //A primeira rampa parte da temperatura do forno
+        perfil->setpoint = temp;
+        muda_estagio(perfil, 0, t_us, temp);
+        perfil->iniciado = true;
+    }
+    int64_t decorrido = t_us - perfil->inicio_estagio_us;
+    perfil->setpoint = trajetoria_valor(&perfil->trajetoria, (float)decorrido / 1e6f, &perfil->derivada);
+    return perfil->setpoint;
+}
+
+/**
+ * @brief Calcula o setpoint da amostra pela trajetoria do segmento atual e passa para o proximo segmento quando a
+ * condicao de saida e atingida. Deve ser chamada uma vez por amostra; o setpoint e interpolado pelo instante da
+ * amostra, entao amostras atrasadas ou descartadas nao alteram a duracao do perfil.
+ *
+ * @param perfil
+ * @param temp Temperatura lida
+ * @param t_us Instante da amostra em us
+ * @return int Segmento depois da amostra
+ */
+int perfil_passo(perfil_t *perfil, float temp, int64_t t_us){
+    if(perfil->terminado){
+        return perfil->modo_operacao;
+    }
+    perfil_setpoint(perfil, temp, t_us);
+    const perfil_segmento_t *seg = &perfil->tabela->segmentos[perfil->modo_operacao];
+    int64_t decorrido = t_us - perfil->inicio_estagio_us;
+    registra(perfil, t_us, temp);
+
+    if(segmento_terminou(seg, temp, decorrido)){
+        if(perfil->modo_operacao + 1 < perfil->tabela->n){
+            muda_estagio(perfil, perfil->modo_operacao + 1, t_us, temp);
+        }
+        else{
+            perfil->terminado = true;
+        }
+    }
+    return perfil->modo_operacao;
+}
+
+/**
+ * @brief Prepara a reconstrucao do setpoint a partir do log
+ *
+ * @param ideal
+ * @param tabela a mesma tabela usada no ciclo
+ */
+void perfil_ideal_inicia(perfil_ideal_t *ideal, const perfil_tabela_t *tabela){
+    memset(ideal, 0, sizeof(*ideal));
+    ideal->tabela = tabela;
+    ideal->modo = -1;
+}
+
+/**
+ * @brief Setpoint no instante de um registro do log, refeito pela trajetoria do segmento como em perfil_passo.
+ * A trajetoria so e recalculada quando o segmento muda. Os instantes sao os do log (em ms, no periodo nominal
+ * quando a amostra nao atrasou), entao o valor difere do usado no ciclo no maximo pela taxa vezes o atraso.
+ *
+ * @param ideal
+ * @param ev registro decodificado (registro_decodifica_bloco)
+ * @return float setpoint em graus
+ */
+float perfil_ideal(perfil_ideal_t *ideal, const registro_evento_t *ev){
+    if(ev->modo < 0 || ev->modo >= ideal->tabela->n){
+        return ev->inicio;
+    }
+    if(ev->modo != ideal->modo || ev->inicio_ms != ideal->inicio_ms || ev->inicio != ideal->inicio){
+        const perfil_segmento_t *seg = &ideal->tabela->segmentos[ev->modo];
+        trajetoria_inicia(&ideal->trajetoria, ev->inicio, seg->alvo, seg->taxa, TRAJETORIA_ACEL_MAX, TRAJETORIA_JERK_MAX);
+        ideal->modo = ev->modo;
+        ideal->inicio_ms = ev->inicio_ms;
+        ideal->inicio = ev->inicio;
+    }
+    return trajetoria_valor(&ideal->trajetoria, (ev->t_ms - ev->inicio_ms) / 1000.0f, NULL);
+}
+
+/**
+ * @brief Verifica se o perfil sempre termina: tipos conhecidos, taxas nao negativas, patamar com duracao e rampa ou
+ * resfriamento com um limite que o setpoint alcanca ou com tempo maximo
+ *
+ * @param tabela
+ * @return true se a tabela pode ser usada
+ */
+bool perfil_tabela_valida(const perfil_tabela_t *tabela){
+    if(tabela->n < 1 || tabela->n > PERFIL_MAX_SEGMENTOS){
+        return false;
+    }
+    for(int i = 0; i < tabela->n; i++){
+        const perfil_segmento_t *seg = &tabela->segmentos[i];
+        if(seg->tipo >= PERFIL_N_TIPOS || seg->taxa < 0 || seg->duracao_s < 0){
+            return false;
+        }
+        switch(seg->tipo){
+        case PERFIL_RAMPA:
+            if(seg->limite >= seg->alvo && seg->duracao_s == 0){
+                return false;
+            }
+            break;
+        case PERFIL_RESFRIA:
+            if(seg->limite <= seg->alvo && seg->duracao_s == 0){
+                return false;
+            }
+            break;
+        default:
+            if(seg->duracao_s == 0){
+                return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Le uma tabela em texto, um segmento por linha:
+ *
+ *   # tipo   alvo  taxa  duracao_s  limite  nome
+ *   patamar  100   0     180        0       Aquecimento
+ *   rampa    150   1.5   0          130     Pre aquecimento
+ *
+ * Linhas vazias e comecando com # sao ignoradas. A tabela so e alterada se o texto inteiro for valido.
+ *
+ * @param tabela
+ * @param texto
+ * @return int 0 se leu, o numero da linha com erro, ou -1 se a tabela lida nao e valida
+ */
+int perfil_tabela_le(perfil_tabela_t *tabela, const char *texto){
+    perfil_tabela_t lida;
+    memset(&lida, 0, sizeof(lida));
+
+    int linha = 0;
+    while(*texto){
+        char buf[96];
+        size_t tam = strcspn(texto, "\n");
+        linha++;
+        if(tam >= sizeof(buf)){
+            return linha;
+        }
+        memcpy(buf, texto, tam);
+        buf[tam] = '\0';
+        texto += tam + (texto[tam] == '\n');
+
+        char *p = buf + strspn(buf, " \t\r");
+        if(*p == '\0' || *p == '#'){
+            continue;
+        }
+        if(lida.n == PERFIL_MAX_SEGMENTOS){
+            return linha;
+        }
+
+        perfil_segmento_t *seg = &lida.segmentos[lida.n];
+        char tipo[12];
+        int pos = 0;
+        if(sscanf(p, "%11s %f %f %f %f %n", tipo, &seg->alvo, &seg->taxa, &seg->duracao_s, &seg->limite, &pos) != 5){
+            return linha;
+        }
+        for(seg->tipo = 0; seg->tipo < PERFIL_N_TIPOS; seg->tipo++){
+            if(strcmp(tipo, nomes_tipo[seg->tipo]) == 0){
+                break;
+            }
+        }
+        if(seg->tipo == PERFIL_N_TIPOS){
+            return linha;
+        }
+        char *nome = p + pos;
+        nome[strcspn(nome, "\r")] = '\0';
+        snprintf(seg->nome, sizeof(seg->nome), "%s", nome);
+        lida.n++;
+    }
+
+    if(!perfil_tabela_valida(&lida)){
+        return -1;
+    }
+    *tabela = lida;
+    return 0;
+}
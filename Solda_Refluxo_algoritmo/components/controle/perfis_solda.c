@@ -0,0 +1,73 @@
+#include <stddef.h>
+#include <string.h>
+#include "perfis_solda.h"
+
+/*Expansao de cada segmento da lista*/
+#define SEGMENTO(tipo, inicio, alvo, taxa_cc, duracao, limite, nome) \
+    { nome, tipo, alvo, (taxa_cc) / 100.0f, duracao, limite },
+#define CONTA(tipo, inicio, alvo, taxa_cc, duracao, limite, nome) + 1
+#define DURACAO(tipo, inicio, alvo, taxa_cc, duracao, limite, nome) + (duracao)
+#define TAXA_OK(tipo, inicio, alvo, taxa_cc, duracao, limite, nome) \
+    && (taxa_cc) <= ((tipo) == PERFIL_RESFRIA ? PERFIS_RESFRIA_MAX_CC_S : PERFIS_TAXA_MAX_CC_S)
+#define PICO_OK(tipo, inicio, alvo, taxa_cc, duracao, limite, nome) && (alvo) <= PERFIS_PICO_MAX_C
+#define SEGMENTO_OK(tipo, inicio, alvo, taxa_cc, duracao, limite, nome) \
+    && (duracao) > 0 && sizeof(nome) <= PERFIL_NOME_MAX && (tipo) < PERFIL_N_TIPOS
+
+/*
+ * A trajetoria de inicio ate alvo, na taxa v = c/100 (c = taxa_cc), dura a distancia d/v mais o tempo de uma
+ * transicao ta = max(1,5 v / acel, raiz(6 v / jerk)) (trajetoria_inicia). Com a folga f = duracao - 100 d / c, cabe
+ * se f >= 0, f >= 1,5 v / acel e f^2 >= 6 v / jerk. Tudo multiplicado por c e com acel e jerk em milesimos
+ * (TRAJETORIA_ACEL_MAX_MG...), F = f c = duracao c - 100 d e as condicoes ficam F >= 0, F acel_mg >= 15 c^2 e
+ * F^2 jerk_mg >= 60 c^3, so com inteiros. Quando a distancia e curta e a taxa de cruzeiro e reduzida a conta com a
+ * taxa da tabela continua sendo um limite. Taxa 0 (a maior permitida) so vale sem distancia, nos patamares.
+ */
+#define FOLGA_CC(inicio, alvo, taxa_cc, duracao) \
+    ((long long)(duracao) * (taxa_cc) - 100LL * ((alvo) > (inicio) ? (alvo) - (inicio) : (inicio) - (alvo)))
+#define CABE(tipo, inicio, alvo, taxa_cc, duracao, limite, nome)                                                \
+    && ((alvo) == (inicio) ||                                                                                   \
+        ((taxa_cc) > 0 && FOLGA_CC(inicio, alvo, taxa_cc, duracao) >= 0 &&                                      \
+         FOLGA_CC(inicio, alvo, taxa_cc, duracao) * TRAJETORIA_ACEL_MAX_MG >=                                   \
+             (TRAJETORIA_ACEL_MAX_MG ? 15LL * (taxa_cc) * (taxa_cc) : 0) &&                                     \
+         FOLGA_CC(inicio, alvo, taxa_cc, duracao) * FOLGA_CC(inicio, alvo, taxa_cc, duracao) *                  \
+             TRAJETORIA_JERK_MAX_MG >= (TRAJETORIA_JERK_MAX_MG ? 60LL * (taxa_cc) * (taxa_cc) * (taxa_cc) : 0)))
+
+/*Verifica a lista e define a tabela*/
+#define DEFINE_PERFIL(tabela, SEGMENTOS)                                                                        \
+    _Static_assert(0 SEGMENTOS(CONTA) <= PERFIL_MAX_SEGMENTOS, #tabela ": segmentos demais");                 \
+    _Static_assert(1 SEGMENTOS(SEGMENTO_OK), #tabela ": segmento sem duracao maxima, tipo ou nome invalido");  \
+    _Static_assert(1 SEGMENTOS(TAXA_OK), #tabela ": taxa acima do limite");                                    \
+    _Static_assert(1 SEGMENTOS(PICO_OK), #tabela ": alvo acima de PERFIS_PICO_MAX_C");                         \
+    _Static_assert(1 SEGMENTOS(CABE), #tabela ": segmento sem tempo para chegar no alvo");                     \
+    _Static_assert(REGISTRO_BLOCOS_PIOR_CASO((0 SEGMENTOS(DURACAO)) * 1000 / PERFIS_PERIODO_MS + 1,           \
+                                            0 SEGMENTOS(CONTA) - 1) <= PERFIS_CAPACIDADE_BLOCOS,                \
+                   #tabela ": o perfil pode passar da capacidade do log");                                     \
+    const perfil_tabela_t tabela = { .segmentos = { SEGMENTOS(SEGMENTO) }, .n = 0 SEGMENTOS(CONTA) }
+
+DEFINE_PERFIL(perfil_sac305, PERFIL_SAC305_SEGMENTOS);
+DEFINE_PERFIL(perfil_sn63pb37, PERFIL_SN63PB37_SEGMENTOS);
+DEFINE_PERFIL(perfil_snbi, PERFIL_SNBI_SEGMENTOS);
+
+static const struct {
+    const char *nome;
+    const perfil_tabela_t *tabela;
+} perfis[] = {
+    { "padrao", &perfil_tabela_padrao },
+    { "sac305", &perfil_sac305 },
+    { "sn63pb37", &perfil_sn63pb37 },
+    { "snbi", &perfil_snbi },
+};
+
+/**
+ * @brief Procura um perfil pelo nome ("padrao", "sac305", "sn63pb37" ou "snbi")
+ *
+ * @param nome
+ * @return const perfil_tabela_t* NULL se nao existe
+ */
+const perfil_tabela_t *perfis_solda_busca(const char *nome){
+    for(size_t i = 0; i < sizeof(perfis) / sizeof(perfis[0]); i++){
+        if(strcmp(nome, perfis[i].nome) == 0){
+            return perfis[i].tabela;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,132 @@
+#include <string.h>
+#include <math.h>
+#include "pid.h"
+
+/**
+ * @brief Zera o estado do PID e configura os ganhos
+ *
+ * @param pid
+ * @param kp
+ * @param ki
+ * @param kd
+ * @param T periodo em s
+ */
+void pid_inicia(pid_ctrl_t *pid, float kp, float ki, float kd, float T){
+    memset(pid, 0, sizeof(*pid));
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+    pid->T = T;
+#if PID_NUMERICO == PID_FLOAT
+    pid_f32_inicia(&pid->nucleo, kp, ki, kd, T, PID_SAIDA_MAX);
+#else
+    pid_q_inicia(&pid->nucleo, kp, ki, kd, T, PID_SAIDA_MAX, PID_Q_FRAC);
+#endif
+    pid->sat = pid->nucleo.sat;
+}
+
+/**
+ * @brief Troca os ganhos sem zerar o estado, para o PID continuar de onde estava (controle adaptativo)
+ *
+ * @param pid
+ * @param kp
+ * @param ki
+ * @param kd
+ */
+void pid_ganhos(pid_ctrl_t *pid, float kp, float ki, float kd){
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+#if PID_NUMERICO == PID_FLOAT
+    pid->nucleo.kp = kp;
+    pid_f32_periodo(&pid->nucleo, ki, kd, pid->T);
+#else
+    uint8_t sat = 0;
+    pid->nucleo.kp = pid_q_de_float(kp, PID_Q_FRAC, &sat);
+    if(pid_q_periodo(&pid->nucleo, ki, kd, pid->T, PID_Q_FRAC) || sat){
+        pid->sat |= PID_SAT_NUMERICA;
+    }
+#endif
+}
+
+/**
+ * @brief Saida que o PID daria com outros ganhos para o mesmo erro, a partir do estado atual (I e D anteriores),
+ * sem alterar o estado. A diferenca para a saida com os ganhos atuais e o salto de uma troca de ganhos
+ * (transferencia sem salto, escalonamento.h)
+ *
+ * @param pid
+ * @param kp
+ * @param ki
+ * @param kd
+ * @param erro setpoint - temperatura da amostra atual
+ * @return float
+ */
+float pid_saida_com(const pid_ctrl_t *pid, float kp, float ki, float kd, float erro){
+#if PID_NUMERICO == PID_FLOAT
+    float erro_ant = pid->nucleo.erro_ant;
+#else
+    float erro_ant = pid_q_para_float(pid->nucleo.erro_ant, PID_Q_SINAL_FRAC);
+#endif
+    float I = fminf(fmaxf(pid->I + (ki * pid->T) / 2 * (erro + erro_ant), 0), PID_SAIDA_MAX);
+    float cd = 2 * kd / (2 * PID_FILTRO_D_S + pid->T);
+    float ad = (2 * PID_FILTRO_D_S - pid->T) / (2 * PID_FILTRO_D_S + pid->T);
+    return kp * erro + I + cd * (erro - erro_ant) + ad * pid->D;
+}
+
+/**
+ * @brief Calcula a saida do PID para a temperatura atual
+ *
+ * @param pid
+ * @param setpoint Temperatura desejada
+ * @param temp Temperatura lida
+ * @param dt Tempo medido desde a amostra anterior em s. Os coeficientes de Tustin sao recalculados quando muda.
+ * @return float Saida do PID (duty cycle do rele, antes da saturacao)
+ */
+float pid_atualiza(pid_ctrl_t *pid, float setpoint, float temp, float dt){
+    uint8_t sat_periodo = 0;
+    if(dt > 0 && dt != pid->T){
+        pid->T = dt;
+#if PID_NUMERICO == PID_FLOAT
+        pid_f32_periodo(&pid->nucleo, pid->ki, pid->kd, dt);
+#else
+        sat_periodo = pid_q_periodo(&pid->nucleo, pid->ki, pid->kd, dt, PID_Q_FRAC);
+#endif
+    }
+
+    //Calcula o erro
+    float erro = setpoint - temp;
+
+#if PID_NUMERICO == PID_FLOAT
+    pid_f32_atualiza(&pid->nucleo, erro);
+    pid->P = pid->nucleo.P;
+    pid->I = pid->nucleo.I;
+    pid->D = pid->nucleo.D;
+    pid->saida = pid->nucleo.saida;
+    pid->sat = pid->nucleo.sat | sat_periodo;
+#else
+    uint8_t sat = 0;
+    pid_q_atualiza(&pid->nucleo, pid_q_de_float(erro, PID_Q_SINAL_FRAC, &sat), PID_Q_FRAC);
+    pid->P = pid_q_para_float(pid->nucleo.P, PID_Q_SINAL_FRAC);
+    pid->I = pid_q_para_float(pid->nucleo.I, PID_Q_SINAL_FRAC);
+    pid->D = pid_q_para_float(pid->nucleo.D, PID_Q_SINAL_FRAC);
+    pid->saida = pid_q_para_float(pid->nucleo.saida, PID_Q_SINAL_FRAC);
+    pid->sat = pid->nucleo.sat | sat_periodo | (sat ? PID_SAT_NUMERICA : 0);
+#endif
+    pid->saturacoes = pid->nucleo.saturacoes;
+    return pid->saida;
+}
+
+/**
+ * @brief Nome do tipo numerico escolhido na compilacao
+ *
+ * @return const char*
+ */
+const char *pid_nome_numerico(void){
+#if PID_NUMERICO == PID_FLOAT
+    return "float";
+#elif PID_NUMERICO == PID_Q16_16
+    return "Q16.16";
+#else
+    return "Q8.24";
+#endif
+}
@@ -0,0 +1,84 @@
+/**
+ * @file pid_bench.c
+ * @brief Benchmark dos nucleos do PID. Roda a mesma sequencia de erros em cada tipo numerico, mede os ciclos
+ * por atualizacao e calcula um hash das saidas para conferir que host e ESP32 dao o mesmo resultado.
+ */
+
+#include <string.h>
+#include "pid_nucleo.h"
+#include "pid_bench.h"
+
+#define N PID_BENCH_ATUALIZACOES
+
+static float erros_f[N];
+static int32_t erros_q[N];
+static uint32_t saidas[N];
+
+/*Erro de -300 a +300 graus em passos de 0,25 grau (resolucao do MAX6675), de um LCG fixo*/
+static void gera_erros(void){
+    uint32_t x = 1;
+    uint8_t sat = 0;
+    for(int i = 0; i < N; i++){
+        x = x * 1664525u + 1013904223u;
+        erros_f[i] = (int32_t)((x >> 8) % 2401 - 1200) * 0.25f;
+        erros_q[i] = pid_q_de_float(erros_f[i], PID_Q_SINAL_FRAC, &sat);
+    }
+}
+
+static uint32_t fnv1a(const uint32_t *v, int n){
+    uint32_t h = 2166136261u;
+    for(int i = 0; i < n; i++){
+        for(int b = 0; b < 32; b += 8){
+            h ^= (v[i] >> b) & 0xFF;
+            h *= 16777619u;
+        }
+    }
+    return h;
+}
+
+static void bench_f32(bench_ciclos_t ciclos, pid_bench_resultado_t *res){
+    pid_f32_t pid;
+    pid_f32_inicia(&pid, 3, 24, 4, 0.5f, 1024);
+    uint32_t inicio = ciclos();
+    for(int i = 0; i < N; i++){
+        float s = pid_f32_atualiza(&pid, erros_f[i]);
+        memcpy(&saidas[i], &s, sizeof(s));
+    }
+    res->ciclos = (ciclos() - inicio) / N;
+    res->nome = "float";
+    res->hash = fnv1a(saidas, N);
+    res->saturacoes = pid.saturacoes;
+}
+
+static void bench_q(bench_ciclos_t ciclos, pid_bench_resultado_t *res, int frac, const char *nome){
+    pid_q_t pid;
+    pid_q_inicia(&pid, 3, 24, 4, 0.5f, 1024, frac);
+    uint32_t inicio = ciclos();
+    if(frac == PID_Q16_FRAC){
+        for(int i = 0; i < N; i++){
+            saidas[i] = (uint32_t)pid_q_atualiza(&pid, erros_q[i], PID_Q16_FRAC);
+        }
+    }
+    else{
+        for(int i = 0; i < N; i++){
+            saidas[i] = (uint32_t)pid_q_atualiza(&pid, erros_q[i], PID_Q24_FRAC);
+        }
+    }
+    res->ciclos = (ciclos() - inicio) / N;
+    res->nome = nome;
+    res->hash = fnv1a(saidas, N);
+    res->saturacoes = pid.saturacoes;
+}
+
+/**
+ * @brief Executa o benchmark nos tres tipos numericos
+ *
+ * @param ciclos contador de ciclos da plataforma
+ * @param res resultados na ordem float, Q16.16, Q8.24
+ */
+void pid_bench_executa(bench_ciclos_t ciclos, pid_bench_resultado_t res[PID_BENCH_N_TIPOS]){
+    gera_erros();
+    bench_f32(ciclos, &res[0]);
+    bench_q(ciclos, &res[1], PID_Q16_FRAC, "Q16.16");
+    bench_q(ciclos, &res[2], PID_Q24_FRAC, "Q8.24");
+}
@@ -0,0 +1,96 @@
+#include "reflow.h"
+#include "tempo.h"
+
+static void marca(reflow_t *reflow, int fase){
+    if(reflow->latencia){
+        latencia_marca(reflow->latencia, fase);
+    }
+}
+
+/**
+ * @brief Uma iteracao do controle: le a temperatura, filtra, calcula o setpoint, calcula o PID (ou o controle
+ * adaptativo ou o escalonamento dos ganhos, se houver) e altera o duty do rele. Depois, fora do tempo de resposta,
+ * grava no log do perfil a saida e a amostra (registro_saida antes de registro_amostra, como na excitacao) e passa
+ * de segmento se for o caso; o controle ve o segmento novo a partir da amostra seguinte.
+ * A leitura bloqueia pelo tempo de conversao do sensor, que define o periodo do laco. O PID e o perfil usam o
+ * instante de cada amostra, entao o intervalo real entre amostras (e nao o periodo nominal) entra na
+ * discretizacao. Com o termopar aberto o rele e desligado e a amostra e descartada.
+ * Com a instrumentacao ligada, a resposta e medida a partir do retorno da leitura; o tempo dentro da leitura
+ * (que inclui a espera da conversao) vai para a fase de aquisicao.
+ *
+ * @param reflow
+ * @return float Temperatura lida
+ */
+float reflow_passo(reflow_t *reflow){
+    const reflow_hal_t *hal = reflow->hal;
+    int modo_anterior = reflow->perfil->modo_operacao;
+    latencia_t *lat = reflow->latencia;
+    max6675_amostra_t amostra;
+
+    int64_t t_leitura = lat ? lat->relogio_us() : 0;
+    hal->le_sensor(hal->ctx, &amostra);
+    float temp = max6675_graus(&amostra);
+    if(amostra.aberto){
+        hal->altera_duty(hal->ctx, 0);
+        return temp;
+    }
+    if(lat){
+        int64_t t_pronta = lat->relogio_us();
+        latencia_registra(lat, LATENCIA_AQUISICAO, t_pronta - t_leitura);
+        latencia_inicio(lat, amostra.t_us, t_pronta);
+    }
+
+    float filtrada = reflow->filtro ? filtro_aplica(reflow->filtro, temp) : temp;
+    reflow->filtrada = filtrada;
+    marca(reflow, LATENCIA_FILTRO);
+
+    perfil_setpoint(reflow->perfil, temp, amostra.t_us);
+    marca(reflow, LATENCIA_PERFIL);
+
+    float dt = reflow->t_ultima_us ? (float)(amostra.t_us - reflow->t_ultima_us) / 1e6f : reflow->pid->T;
+    reflow->t_ultima_us = amostra.t_us;
+    if(reflow->adaptativo){
+        reflow->saida = adaptativo_atualiza(reflow->adaptativo, reflow->pid, reflow->perfil->modo_operacao,
+                                            reflow->perfil->setpoint, reflow->perfil->derivada, filtrada, dt);
+    }
+    else if(reflow->escalonamento){
+        reflow->saida = escalonamento_atualiza(reflow->escalonamento, reflow->pid, reflow->perfil->modo_operacao,
+                                               reflow->perfil->setpoint, filtrada, dt);
+    }
+    else{
+        reflow->saida = pid_atualiza(reflow->pid, reflow->perfil->setpoint, filtrada, dt);
+    }
+    marca(reflow, LATENCIA_PID);
+
+    hal->altera_duty(hal->ctx, reflow->saida);
+    marca(reflow, LATENCIA_ATUACAO);
+    if(lat){
+        latencia_fim(lat);
+    }
+
+    if(reflow->perfil->registro && !reflow->perfil->terminado){
+        registro_saida(reflow->perfil->registro, reflow->saida);
+    }
+    perfil_passo(reflow->perfil, temp, amostra.t_us);
+    if(reflow->perfil->modo_operacao != modo_anterior && reflow->estagio_cb){
+        reflow->estagio_cb(reflow->arg, reflow->perfil->modo_operacao);
+    }
+    return temp;
+}
+
+/**
+ * @brief Executa o perfil completo. Ao final desliga o rele.
+ * Alguns estagios so terminam quando a temperatura e atingida, por isso a duracao do ciclo e limitada.
+ *
+ * @param reflow
+ * @param max_us limite de tempo (tempo.h) caso o forno nao atinja a temperatura
+ * @return int Numero de amostras
+ */
+int reflow_executa(reflow_t *reflow, int64_t max_us){
+    int64_t inicio = tempo_us();
+    while(!reflow->perfil->terminado && tempo_decorrido_us(inicio) < max_us){
+        reflow_passo(reflow);
+    }
+    reflow->hal->altera_duty(reflow->hal->ctx, 0);
+    return reflow->perfil->t_atual;
+}
@@ -0,0 +1,121 @@
+#include <math.h>
+#include "trajetoria.h"
+
+#define N_LUT 32
+
+/*
+ * Transicao normalizada em u = t/ta, de 0 a 1, em unidades de 1/65535:
+ *   taxa[]      h(u) = 3u^2 - 2u^3        fracao da taxa de cruzeiro
+ *   posicao[]   2H(u) = 2u^3 - u^4        fracao da distancia percorrida na transicao (v*ta/2), H = integral de h
+ * Com h a aceleracao maxima e 1,5 v/ta e o jerk maximo e 6 v/ta^2.
+ */
+static const unsigned short lut_taxa[N_LUT + 1] = {
+    0, 188, 736, 1620, 2816, 4300, 6048, 8036, 10240, 12636, 15200, 17908, 20736, 23660, 26656, 29700,
+    32768, 35835, 38879, 41875, 44799, 47627, 50335, 52899, 55295, 57499, 59487, 61235, 62719, 63915, 64799, 65347,
+    65535
+};
+static const unsigned short lut_posicao[N_LUT + 1] = {
+    0, 4, 31, 103, 240, 461, 783, 1222, 1792, 2506, 3375, 4409, 5616, 7003, 8575, 10336,
+    12288, 14432, 16767, 19291, 22000, 24889, 27951, 31177, 34559, 38085, 41742, 45516, 49391, 53350, 57374, 61443,
+    65535
+};
+
+/*Interpola a tabela em u (0 a 1)*/
+static float lut(const unsigned short *tabela, float u){
+    float x = u * N_LUT;
+    int i = (int)x;
+    if(i >= N_LUT){
+        return 1;
+    }
+    return (tabela[i] + (tabela[i + 1] - tabela[i]) * (x - i)) / 65535.0f;
+}
+
+/**
+ * @brief Calcula a trajetoria de inicio ate alvo. Se a distancia nao permite chegar na taxa maxima dentro dos
+ * limites de aceleracao e jerk, a taxa de cruzeiro e reduzida.
+ *
+ * @param traj
+ * @param inicio
+ * @param alvo
+ * @param taxa_max graus/s (0 = a maior taxa que os limites de aceleracao e jerk permitem; sem eles, degrau)
+ * @param acel_max graus/s^2 (0 = sem limite)
+ * @param jerk_max graus/s^3 (0 = sem limite)
+ */
+void trajetoria_inicia(trajetoria_t *traj, float inicio, float alvo, float taxa_max, float acel_max, float jerk_max){
+    traj->inicio = inicio;
+    traj->sinal = alvo >= inicio ? 1 : -1;
+    traj->distancia = fabsf(alvo - inicio);
+    traj->v = 0;
+    traj->ta = 0;
+    traj->tc = 0;
+    if(traj->distancia == 0 || (taxa_max <= 0 && acel_max <= 0 && jerk_max <= 0)){
+        return;
+    }
+
+    //Maior taxa que acelera e desacelera dentro da distancia: v*ta <= distancia
+    float v = taxa_max > 0 ? taxa_max : INFINITY;
+    if(acel_max > 0){
+        v = fminf(v, sqrtf(traj->distancia * acel_max / 1.5f));
+    }
+    if(jerk_max > 0){
+        v = fminf(v, cbrtf(traj->distancia * traj->distancia * jerk_max / 6));
+    }
+    float ta = 0;
+    if(acel_max > 0){
+        ta = 1.5f * v / acel_max;
+    }
+    if(jerk_max > 0){
+        ta = fmaxf(ta, sqrtf(6 * v / jerk_max));
+    }
+    traj->v = v;
+    traj->ta = ta;
+    traj->tc = fmaxf(0, (traj->distancia - v * ta) / v);
+}
+
+/**
+ * @brief Duracao total da trajetoria em s
+ */
+float trajetoria_duracao(const trajetoria_t *traj){
+    return 2 * traj->ta + traj->tc;
+}
+
+/**
+ * @brief Valor da trajetoria t_s segundos depois do inicio
+ *
+ * @param traj
+ * @param t_s
+ * @param derivada taxa em graus/s no instante (pode ser NULL), para feedforward
+ * @return float
+ */
+float trajetoria_valor(const trajetoria_t *traj, float t_s, float *derivada){
+    float pos, taxa;
+    float total = trajetoria_duracao(traj);
+
+    if(traj->v == 0 || t_s >= total){
+        pos = traj->distancia;
+        taxa = 0;
+    }
+    else if(t_s <= 0){
+        pos = 0;
+        taxa = 0;
+    }
+    else if(t_s < traj->ta){
+        float u = t_s / traj->ta;
+        pos = traj->v * traj->ta / 2 * lut(lut_posicao, u);
+        taxa = traj->v * lut(lut_taxa, u);
+    }
+    else if(t_s < traj->ta + traj->tc){
+        pos = traj->v * traj->ta / 2 + traj->v * (t_s - traj->ta);
+        taxa = traj->v;
+    }
+    else{
+        float u = (total - t_s) / traj->ta;
+        pos = traj->distancia - traj->v * traj->ta / 2 * lut(lut_posicao, u);
+        taxa = traj->v * lut(lut_taxa, u);
+    }
+
+    if(derivada){
+        *derivada = traj->sinal * taxa;
+    }
+    return traj->inicio + traj->sinal * pos;
+}
@@ -1,8 +1,27 @@
 #ifndef MAX6675_H
 #define MAX6675_H
 
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/spi_master.h"
+#include "max6675_amostra.h"
+
+#define MAX6675_CONVERSAO_MS 220                    //Tempo maximo de conversao do MAX6675
+
+/**
+ * @brief Chamada ao fim de cada leitura da aquisicao periodica, no contexto da interrupcao do SPI
+ * (deve estar na IRAM e so usar funcoes seguras para ISR, sem float)
+ *
+ * @param amostra leitura decodificada, com o instante do fim da transacao (esp_timer)
+ * @param arg
+ */
+typedef void (*max6675_cb_t)(const max6675_amostra_t *amostra, void *arg);
+
 void max6675_set(void);
+void max6675_le(spi_device_handle_t spi, max6675_amostra_t *amostra);
 float readMax6675(spi_device_handle_t spi);
+esp_err_t max6675_aquisicao_inicia(uint32_t periodo_ms, max6675_cb_t cb, void *arg);
+void max6675_aquisicao_para(void);
 extern spi_device_handle_t spi;
 
 #endif
@@ -0,0 +1,45 @@
+#ifndef MAX6675_AMOSTRA_H
+#define MAX6675_AMOSTRA_H
+
+#include <stdint.h>
+
+#define MAX6675_GRAUS_POR_CONTAGEM 0.25f            //Resolucao do MAX6675
+
+/**
+ * @brief Uma leitura do MAX6675 com a resolucao completa do sensor. Nao depende do ESP-IDF, para poder ser
+ * usada tambem no build do host.
+ */
+typedef struct {
+    int64_t t_us;                                   //Instante da leitura em us (relogio monotono)
+    uint16_t contagem;                              //Temperatura em 0,25 grau (12 bits, D14-D3)
+    uint8_t aberto;                                 //Termopar aberto (D2)
+    uint8_t id;                                     //ID do dispositivo (D1, sempre 0 no MAX6675)
+} max6675_amostra_t;
+
+/**
+ * @brief Decodifica a palavra de 16 bits lida do MAX6675. So usa operacoes inteiras, entao pode ser chamada
+ * na interrupcao do SPI.
+ *
+ * @param amostra
+ * @param rawtemp palavra lida pelo SPI (na ordem de bytes do barramento)
+ * @param t_us instante da leitura
+ */
+static inline void max6675_decodifica(max6675_amostra_t *amostra, uint16_t rawtemp, int64_t t_us){
+    uint16_t palavra = ((rawtemp & 0x00FF) << 8) | ((rawtemp & 0xFF00) >> 8);
+    amostra->t_us = t_us;
+    amostra->contagem = (palavra >> 3) & 0x0FFF;
+    amostra->aberto = (palavra >> 2) & 1;
+    amostra->id = (palavra >> 1) & 1;
+}
+
+/**
+ * @brief Temperatura da amostra em graus Celsius (exata em float)
+ *
+ * @param amostra
+ * @return float
+ */
+static inline float max6675_graus(const max6675_amostra_t *amostra){
+    return amostra->contagem * MAX6675_GRAUS_POR_CONTAGEM;
+}
+
+#endif
@@ -1,12 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "driver/spi_master.h"
 #include "soc/gpio_struct.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
 #include "max6675.h"
 
 #define PIN_NUM_MISO 12                         //Master Input Slave Output (Do Slave para o Master)
@@ -24,25 +26,34 @@
 
 int spi_init = 0;
 
+/*Aquisicao periodica: o esp_timer enfileira a transacao e a interrupcao do SPI entrega a leitura*/
+static struct {
+    esp_timer_handle_t timer;
+    spi_transaction_t trans;
+    bool pendente;                              //Transacao enfileirada cujo resultado ainda nao foi retirado
+    max6675_cb_t cb;
+    void *arg;
+} aquisicao;
+
 /**
- * @brief Envia um sinal de clock para o MAX6675 e le os dados recebidos
+ * @brief Envia um sinal de clock para o MAX6675 e le a amostra completa (contagem, termopar aberto, ID e instante)
  * 
  * @param spi 
- * @return uint16_t temp Temperatura lida do MAX6675 em graus Celsius
+ * @param amostra 
  */
-float readMax6675 (spi_device_handle_t spi){
+void max6675_le(spi_device_handle_t spi, max6675_amostra_t *amostra){
 
     spi_transaction_t trans_word;               //Estrutura de dados
     uint16_t data,rawtemp = 0;                  
-    float temp = 0;
 
+    vTaskDelay(500 / portTICK_PERIOD_MS);       //Espera 500ms com CS em HIGH para o MAX6675 terminar a conversao
     gpio_set_level(PIN_NUM_CS,LOW);             //CS é colocado em LOW para iniciar a comunicacao 
-    vTaskDelay(500 / portTICK_PERIOD_MS);       //Espera 500ms para certificar que o dispositivo está pronto para ser lido
 
     rawtemp = 0x000;                            //rawtemp: onde é armazenado o valor da leitura
     data = 0x000;                               //data: valor enviado para iniciar a leitura
 
     /*Configuracao das info de transacao*/
+    memset(&trans_word, 0, sizeof(trans_word));
     trans_word.length = 16; // Tamanho do dado
     trans_word.rxlength = 0; // Número de bits a serem recebidos (0 significa transmitir apenas)
     trans_word.rx_buffer = &rawtemp; // Ponteiro para o buffer de recepção
@@ -54,13 +65,100 @@ float readMax6675 (spi_device_handle_t spi){
 
     gpio_set_level(PIN_NUM_CS,HIGH);            //CS é colocado em HIGH para finalizar a comunicacao
 
-   
-    temp = (((((rawtemp & 0x00FF) << 8) | ((rawtemp & 0xFF00) >> 8))>>3)*25)/100;
-    return temp;
- 
+    max6675_decodifica(amostra, rawtemp, esp_timer_get_time());
+} 
+
+/**
+ * @brief Le a temperatura do MAX6675 em graus Celsius (resolucao de 0,25 grau)
+ * 
+ * @param spi 
+ * @return float temp Temperatura lida do MAX6675 em graus Celsius
+ */
+float readMax6675 (spi_device_handle_t spi){
+    max6675_amostra_t amostra;
+    max6675_le(spi, &amostra);
+    return max6675_graus(&amostra);
+}
 
+/**
+ * @brief Fim de uma transacao do SPI (na interrupcao). So as transacoes da aquisicao periodica tem user != NULL.
+ * 
+ * @param trans 
+ */
+static void IRAM_ATTR transacao_fim(spi_transaction_t *trans){
+    if(trans->user == NULL || aquisicao.cb == NULL){
+        return;
+    }
+    max6675_amostra_t amostra;
+    max6675_decodifica(&amostra, trans->rx_data[0] | (trans->rx_data[1] << 8), esp_timer_get_time());
+    aquisicao.cb(&amostra, aquisicao.arg);
+}
 
-} 
+/**
+ * @brief Disparada pelo esp_timer a cada periodo: retira o resultado da leitura anterior e enfileira a proxima,
+ * sem bloquear
+ * 
+ * @param arg 
+ */
+static void dispara_leitura(void *arg){
+    spi_transaction_t *ret;
+
+    if(aquisicao.pendente){
+        if(spi_device_get_trans_result(spi, &ret, 0) != ESP_OK){
+            return;                             //A leitura anterior ainda nao terminou
+        }
+        aquisicao.pendente = false;
+    }
+
+    memset(&aquisicao.trans, 0, sizeof(aquisicao.trans));
+    aquisicao.trans.flags = SPI_TRANS_USE_RXDATA | SPI_TRANS_USE_TXDATA;
+    aquisicao.trans.length = 16;
+    aquisicao.trans.user = &aquisicao;
+    if(spi_device_queue_trans(spi, &aquisicao.trans, 0) == ESP_OK){
+        aquisicao.pendente = true;
+    }
+}
+
+/**
+ * @brief Inicia a aquisicao periodica. O CS so fica em LOW durante a transacao, entao o MAX6675 converte
+ * durante todo o resto do periodo. max6675_set deve ser chamada antes.
+ * 
+ * @param periodo_ms periodo entre leituras, no minimo MAX6675_CONVERSAO_MS
+ * @param cb chamada com cada leitura, no contexto da interrupcao do SPI
+ * @param arg 
+ * @return esp_err_t 
+ */
+esp_err_t max6675_aquisicao_inicia(uint32_t periodo_ms, max6675_cb_t cb, void *arg){
+    if(periodo_ms < MAX6675_CONVERSAO_MS){
+        return ESP_ERR_INVALID_ARG;
+    }
+    aquisicao.cb = cb;
+    aquisicao.arg = arg;
+    aquisicao.pendente = false;
+
+    const esp_timer_create_args_t args = {
+        .callback = dispara_leitura,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "max6675",
+    };
+    esp_err_t ret = esp_timer_create(&args, &aquisicao.timer);
+    if(ret != ESP_OK){
+        return ret;
+    }
+    return esp_timer_start_periodic(aquisicao.timer, periodo_ms * 1000ULL);
+}
+
+/**
+ * @brief Para a aquisicao periodica
+ * 
+ */
+void max6675_aquisicao_para(void){
+    if(aquisicao.timer){
+        esp_timer_stop(aquisicao.timer);
+        esp_timer_delete(aquisicao.timer);
+        aquisicao.timer = NULL;
+    }
+}
 
 /**
  * @brief Configura o SPI para utilização do max6675 e o inicializa
@@ -90,6 +188,7 @@ void max6675_set(void){
             .spics_io_num=PIN_NUM_CS,               //pino CS (Chip selector) 
             .queue_size=3,                          //Tamanho da fila de transmissão para o dispositivo
             .pre_cb = NULL,                         //Ponteiro para uma função de callback                          
+            .post_cb = transacao_fim,               //Entrega as leituras da aquisicao periodica
             }; 
 
         /* Inicializa o barramento do SPI*/
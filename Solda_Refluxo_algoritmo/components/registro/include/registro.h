@@ -0,0 +1,110 @@
+#ifndef REGISTRO_H
+#define REGISTRO_H
+
+/**
+ * @brief Log do ciclo de refluxo em um anel de blocos de tamanho fixo. Cada bloco comeca com o estado completo
+ * (instante, temperatura e segmento) e guarda as amostras como diferencas de 8 bits, em 0,25 grau; o que nao
+ * cabe em 8 bits vai como valor absoluto de 16 bits. Quando o anel enche, o bloco mais antigo e descartado e
+ * contado, entao o ciclo pode ter qualquer duracao. Cada bloco e decodificado sozinho, no ESP32 ou no host.
+ *
+ * O setpoint nao e gravado: ele so depende da tabela do perfil, do instante em que o segmento comecou e do
+ * setpoint nesse instante, que vao na mudanca de segmento e no cabecalho de cada bloco. A curva ideal e refeita
+ * na decodificacao por perfil_ideal (perfil.h).
+ *
+ * Registros dentro de um bloco (little endian):
+ *   dr                       amostra: diferenca da temperatura (dr != -128)
+ *   0x80 0x00 r:16           amostra com o valor absoluto
+ *   0x80 0x01 modo inicio:f  mudanca de segmento no instante da ultima amostra, com o setpoint inicial
+ *   0x80 0x02 t_ms:32        instante da proxima amostra, quando ela nao chega no periodo
+ *   0x80 0x03 u:16           saida do controle em 1/32 de duty, calculada com a proxima amostra e valida ate a
+ *                            proxima mudanca. So e gravada quando muda (registro_saida, chamada a cada amostra pelo
+ *                            laco do perfil e pela excitacao) e e repetida no inicio de cada bloco
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef REGISTRO_N_BLOCOS
+#define REGISTRO_N_BLOCOS 192                       //12 KB (os vetores antigos ocupavam 24 KB)
+#endif
+#define REGISTRO_DADOS_BLOCO 46
+
+/*
+ * Pior caso do espaco, com as amostras no periodo (sem o instante gravado). Cada amostra e uma diferenca de 1 byte:
+ * o valor absoluto so aparece com um salto de mais de 127 quartos de grau (31 graus em uma amostra, mais de 60
+ * graus/s no periodo de 0,5 s, dez vezes a taxa maxima dos perfis de perfis_solda.h), e o cabecalho de cada bloco
+ * guarda a ultima temperatura. Com a saida mudando em toda amostra, mais 4 bytes. Cada mudanca de segmento ocupa 7.
+ * Um registro nao atravessa blocos, entao cada bloco perde no maximo 6 bytes no fim e 4 com a saida repetida no
+ * inicio.
+ */
+#define REGISTRO_BYTES_AMOSTRA_MAX 5
+#define REGISTRO_BYTES_ESTAGIO 7
+#define REGISTRO_BYTES_UTEIS_BLOCO (REGISTRO_DADOS_BLOCO - 4 - (REGISTRO_BYTES_ESTAGIO - 1))
+//Blocos para um ciclo de amostras e mudancas de segmento no pior caso
+#define REGISTRO_BLOCOS_PIOR_CASO(amostras, mudancas)                                                           \
+    (((amostras) * REGISTRO_BYTES_AMOSTRA_MAX + (mudancas) * REGISTRO_BYTES_ESTAGIO +                            \
+      REGISTRO_BYTES_UTEIS_BLOCO - 1) / REGISTRO_BYTES_UTEIS_BLOCO)
+
+/**
+ * @brief Um bloco de 64 bytes. E gravado como esta nos arquivos lidos pelo decodificador do host
+ */
+typedef struct {
+    uint32_t t_prox_ms;                             //Instante da proxima amostra, desde a primeira amostra
+    uint32_t inicio_ms;                             //Instante em que o segmento comecou
+    float inicio;                                   //Setpoint no inicio do segmento
+    int16_t real;                                   //Ultima temperatura em 0,25 grau
+    uint16_t periodo_ms;
+    uint8_t modo;                                   //Segmento
+    uint8_t n;                                      //Bytes usados em dados
+    uint8_t dados[REGISTRO_DADOS_BLOCO];
+} registro_bloco_t;
+
+_Static_assert(sizeof(registro_bloco_t) == 64, "registro_bloco_t deve ter 64 bytes");
+
+typedef struct {
+    registro_bloco_t blocos[REGISTRO_N_BLOCOS];
+    uint32_t primeiro;                              //Bloco mais antigo
+    uint32_t n_blocos;                              //Blocos em uso
+    uint32_t perdidos;                              //Blocos descartados por falta de espaco
+    uint32_t abertos;                               //Blocos abertos desde o inicio; o bloco k fica em blocos[k % N].
+                                                    //Publicado com release depois do conteudo dos blocos
+    registro_bloco_t estado;                        //Estado depois do ultimo registro (so o cabecalho)
+    uint16_t saida;                                 //Ultima saida gravada, em 1/32 de duty
+    bool com_saida;                                 //Ja houve registro_saida: a saida e repetida em cada bloco
+    int64_t t0_us;                                  //Instante da primeira amostra
+    bool iniciado;
+} registro_t;
+
+enum {
+    REGISTRO_AMOSTRA = 0,
+    REGISTRO_ESTAGIO,
+};
+
+/**
+ * @brief Um registro decodificado
+ */
+typedef struct {
+    int tipo;                                       //REGISTRO_AMOSTRA ou REGISTRO_ESTAGIO
+    uint32_t t_ms;                                  //Instante desde a primeira amostra
+    int modo;                                       //Segmento (o novo, em REGISTRO_ESTAGIO)
+    float real;                                     //Temperatura em graus
+    uint32_t inicio_ms;                             //Instante em que o segmento comecou
+    float inicio;                                   //Setpoint no inicio do segmento
+    float saida;                                    //Saida do controle na amostra (NAN sem saida gravada)
+} registro_evento_t;
+
+typedef void (*registro_cb_t)(void *arg, const registro_evento_t *evento);
+
+void registro_inicia(registro_t *reg, uint16_t periodo_ms);
+void registro_amostra(registro_t *reg, int64_t t_us, float real);
+void registro_estagio(registro_t *reg, int64_t t_us, int modo, float inicio);
+void registro_saida(registro_t *reg, float saida);
+uint32_t registro_n_blocos(const registro_t *reg);
+const registro_bloco_t *registro_bloco(const registro_t *reg, uint32_t i);
+void registro_decodifica_bloco(const registro_bloco_t *bloco, registro_cb_t cb, void *arg);
+void registro_percorre(const registro_t *reg, registro_cb_t cb, void *arg);
+uint32_t registro_blocos_abertos(const registro_t *reg);
+uint32_t registro_blocos_completos(const registro_t *reg);
+bool registro_copia_bloco(const registro_t *reg, uint32_t k, registro_bloco_t *bloco);
+
+#endif
@@ -0,0 +1,337 @@
+#include <string.h>
+#include <math.h>
+#include "registro.h"
+
+#define ESCAPE 0x80
+#define ABSOLUTO 0x00
+#define ESTAGIO 0x01
+#define TEMPO 0x02
+#define SAIDA 0x03
+#define SAIDA_ESCALA 32                             //Passos por unidade de duty
+
+static void escreve16(uint8_t *p, uint16_t v){
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void escreve32(uint8_t *p, uint32_t v){
+    escreve16(p, v & 0xFFFF);
+    escreve16(p + 2, v >> 16);
+}
+
+static uint16_t le16(const uint8_t *p){
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t le32(const uint8_t *p){
+    return le16(p) | ((uint32_t)le16(p + 2) << 16);
+}
+
+/*Temperatura em 0,25 grau*/
+static int16_t quartos(float graus){
+    float q = roundf(graus * 4);
+    if(q > INT16_MAX){
+        return INT16_MAX;
+    }
+    if(q < INT16_MIN){
+        return INT16_MIN;
+    }
+    return (int16_t)q;
+}
+
+/**
+ * @brief Inicia o log vazio
+ *
+ * @param reg
+ * @param periodo_ms periodo nominal das amostras
+ */
+void registro_inicia(registro_t *reg, uint16_t periodo_ms){
+    memset(reg, 0, sizeof(*reg));
+    reg->estado.periodo_ms = periodo_ms;
+}
+
+/*Abre um bloco com o estado atual, descartando o mais antigo se o anel estiver cheio*/
+static registro_bloco_t *abre_bloco(registro_t *reg){
+    if(reg->n_blocos == REGISTRO_N_BLOCOS){
+        reg->primeiro = (reg->primeiro + 1) % REGISTRO_N_BLOCOS;
+        reg->perdidos++;
+    }
+    else{
+        reg->n_blocos++;
+    }
+    registro_bloco_t *bloco = &reg->blocos[(reg->primeiro + reg->n_blocos - 1) % REGISTRO_N_BLOCOS];
+    memcpy(bloco, &reg->estado, sizeof(*bloco));
+    bloco->n = 0;
+    //a saida nao cabe no cabecalho: vai como o primeiro registro, para o bloco ser lido sozinho
+    if(reg->com_saida){
+        bloco->dados[0] = ESCAPE;
+        bloco->dados[1] = SAIDA;
+        escreve16(&bloco->dados[2], reg->saida);
+        bloco->n = 4;
+    }
+    //so depois do cabecalho: a partir daqui o bloco anterior esta completo para registro_copia_bloco. O release
+    //garante que quem le abertos com acquire (em outra tarefa ou nucleo) ve tambem os bytes dos blocos
+    __atomic_store_n(&reg->abertos, reg->abertos + 1, __ATOMIC_RELEASE);
+    return bloco;
+}
+
+/*Bloco atual, se ainda couberem tam bytes nele*/
+static registro_bloco_t *bloco_com_espaco(registro_t *reg, int tam){
+    if(!reg->n_blocos){
+        return NULL;
+    }
+    registro_bloco_t *bloco = &reg->blocos[(reg->primeiro + reg->n_blocos - 1) % REGISTRO_N_BLOCOS];
+    return bloco->n + tam <= REGISTRO_DADOS_BLOCO ? bloco : NULL;
+}
+
+/*Reserva tam bytes no bloco atual; sem espaco, abre outro*/
+static uint8_t *reserva(registro_t *reg, int tam){
+    registro_bloco_t *bloco = bloco_com_espaco(reg, tam);
+    if(!bloco){
+        bloco = abre_bloco(reg);
+    }
+    uint8_t *p = &bloco->dados[bloco->n];
+    bloco->n += tam;
+    return p;
+}
+
+static void escreve_float(uint8_t *p, float v){
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    escreve32(p, u);
+}
+
+static float le_float(const uint8_t *p){
+    uint32_t u = le32(p);
+    float v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief Registra uma amostra
+ *
+ * @param reg
+ * @param t_us instante da amostra
+ * @param real temperatura lida
+ */
+void registro_amostra(registro_t *reg, int64_t t_us, float real){
+    registro_bloco_t *estado = &reg->estado;
+    if(!reg->iniciado){
+        reg->t0_us = t_us;
+        reg->iniciado = true;
+    }
+
+    //O decodificador avanca um periodo por amostra; se a amostra chegou fora do periodo, grava o instante
+    uint32_t t_ms = (uint32_t)((t_us - reg->t0_us) / 1000);
+    int64_t desvio = (int64_t)t_ms - estado->t_prox_ms;
+    if(desvio > estado->periodo_ms / 2 || desvio < -(estado->periodo_ms / 2)){
+        uint8_t *p = reserva(reg, 6);
+        p[0] = ESCAPE;
+        p[1] = TEMPO;
+        escreve32(p + 2, t_ms);
+        estado->t_prox_ms = t_ms;
+    }
+
+    int16_t r = quartos(real);
+    int32_t dr = r - estado->real;
+    if(dr > INT8_MIN && dr <= INT8_MAX){
+        uint8_t *p = reserva(reg, 1);
+        p[0] = (uint8_t)(int8_t)dr;
+    }
+    else{
+        uint8_t *p = reserva(reg, 4);
+        p[0] = ESCAPE;
+        p[1] = ABSOLUTO;
+        escreve16(p + 2, (uint16_t)r);
+    }
+    estado->real = r;
+    estado->t_prox_ms += estado->periodo_ms;
+}
+
+/**
+ * @brief Registra o inicio de um segmento. O primeiro segmento, antes de qualquer amostra, vai so no cabecalho
+ * dos blocos; os outros comecam no instante da ultima amostra
+ *
+ * @param reg
+ * @param t_us instante do inicio do segmento
+ * @param modo novo segmento
+ * @param inicio setpoint no inicio do segmento, de onde parte a trajetoria ate o alvo
+ */
+void registro_estagio(registro_t *reg, int64_t t_us, int modo, float inicio){
+    registro_bloco_t *estado = &reg->estado;
+    if(!reg->iniciado){
+        reg->t0_us = t_us;
+        reg->iniciado = true;
+    }
+    else{
+        uint8_t *p = reserva(reg, 7);
+        p[0] = ESCAPE;
+        p[1] = ESTAGIO;
+        p[2] = (uint8_t)modo;
+        escreve_float(p + 3, inicio);
+        estado->inicio_ms = estado->t_prox_ms - estado->periodo_ms;
+    }
+    estado->modo = (uint8_t)modo;
+    estado->inicio = inicio;
+}
+
+/**
+ * @brief Registra a saida do controle calculada com a proxima amostra (chamar antes de registro_amostra). So grava
+ * quando a saida muda
+ *
+ * @param reg
+ * @param saida duty (0 a 2047, em passos de 1/32)
+ */
+void registro_saida(registro_t *reg, float saida){
+    float q = roundf(saida * SAIDA_ESCALA);
+    uint16_t u = q < 0 ? 0 : q > UINT16_MAX ? UINT16_MAX : (uint16_t)q;
+    if(reg->com_saida && u == reg->saida){
+        return;
+    }
+    reg->saida = u;
+    reg->com_saida = true;
+    registro_bloco_t *bloco = bloco_com_espaco(reg, 4);
+    if(!bloco){
+        //o bloco novo ja comeca com a saida nova
+        abre_bloco(reg);
+        return;
+    }
+    uint8_t *p = &bloco->dados[bloco->n];
+    p[0] = ESCAPE;
+    p[1] = SAIDA;
+    escreve16(p + 2, u);
+    bloco->n += 4;
+}
+
+uint32_t registro_n_blocos(const registro_t *reg){
+    return reg->n_blocos;
+}
+
+/**
+ * @brief i-esimo bloco, do mais antigo para o mais novo
+ *
+ * @param reg
+ * @param i
+ * @return const registro_bloco_t*
+ */
+const registro_bloco_t *registro_bloco(const registro_t *reg, uint32_t i){
+    return &reg->blocos[(reg->primeiro + i) % REGISTRO_N_BLOCOS];
+}
+
+/**
+ * @brief Decodifica um bloco, chamando cb para cada amostra e mudanca de segmento. Para no primeiro registro
+ * invalido, entao um bloco corrompido nao le fora dos dados.
+ *
+ * @param bloco
+ * @param cb
+ * @param arg
+ */
+void registro_decodifica_bloco(const registro_bloco_t *bloco, registro_cb_t cb, void *arg){
+    uint32_t t_prox = bloco->t_prox_ms;
+    registro_evento_t ev = {
+        .modo = bloco->modo,
+        .inicio_ms = bloco->inicio_ms,
+        .inicio = bloco->inicio,
+        .saida = NAN,
+    };
+    int16_t r = bloco->real;
+    int n = bloco->n > REGISTRO_DADOS_BLOCO ? REGISTRO_DADOS_BLOCO : bloco->n;
+    const uint8_t *d = bloco->dados;
+
+    for(int pos = 0; pos < n;){
+        if(d[pos] != ESCAPE){
+            r += (int8_t)d[pos];
+            pos += 1;
+        }
+        else if(pos + 4 <= n && d[pos + 1] == ABSOLUTO){
+            r = (int16_t)le16(&d[pos + 2]);
+            pos += 4;
+        }
+        else if(pos + 7 <= n && d[pos + 1] == ESTAGIO){
+            ev.tipo = REGISTRO_ESTAGIO;
+            ev.t_ms = t_prox - bloco->periodo_ms;
+            ev.modo = d[pos + 2];
+            ev.inicio_ms = ev.t_ms;
+            ev.inicio = le_float(&d[pos + 3]);
+            ev.real = r / 4.0f;
+            pos += 7;
+            cb(arg, &ev);
+            continue;
+        }
+        else if(pos + 6 <= n && d[pos + 1] == TEMPO){
+            t_prox = le32(&d[pos + 2]);
+            pos += 6;
+            continue;
+        }
+        else if(pos + 4 <= n && d[pos + 1] == SAIDA){
+            ev.saida = le16(&d[pos + 2]) / (float)SAIDA_ESCALA;
+            pos += 4;
+            continue;
+        }
+        else{
+            return;
+        }
+
+        ev.tipo = REGISTRO_AMOSTRA;
+        ev.t_ms = t_prox;
+        ev.real = r / 4.0f;
+        cb(arg, &ev);
+        t_prox += bloco->periodo_ms;
+    }
+}
+
+/**
+ * @brief Decodifica todos os blocos do anel, do mais antigo para o mais novo
+ *
+ * @param reg
+ * @param cb
+ * @param arg
+ */
+void registro_percorre(const registro_t *reg, registro_cb_t cb, void *arg){
+    for(uint32_t b = 0; b < reg->n_blocos; b++){
+        registro_decodifica_bloco(registro_bloco(reg, b), cb, arg);
+    }
+}
+
+/**
+ * @brief Blocos abertos desde o inicio do log, contando o atual. Pode ser chamada de outra tarefa
+ *
+ * @param reg
+ * @return uint32_t
+ */
+uint32_t registro_blocos_abertos(const registro_t *reg){
+    return __atomic_load_n(&reg->abertos, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Blocos que nao mudam mais: todos os abertos menos o atual. Pode ser chamada de outra tarefa
+ *
+ * @param reg
+ * @return uint32_t
+ */
+uint32_t registro_blocos_completos(const registro_t *reg){
+    uint32_t abertos = registro_blocos_abertos(reg);
+    return abertos ? abertos - 1 : 0;
+}
+
+/**
+ * @brief Copia o k-esimo bloco desde o inicio do log. Pode ser chamada de outra tarefa enquanto o log e escrito,
+ * para blocos ja completos (ou para o ultimo, depois do fim do ciclo)
+ *
+ * @param reg
+ * @param k
+ * @param bloco
+ * @return true se o bloco ainda esta no anel. O mais antigo de um anel cheio tambem e recusado, porque o proximo
+ * bloco aberto o sobrescreve antes de incrementar abertos
+ */
+bool registro_copia_bloco(const registro_t *reg, uint32_t k, registro_bloco_t *bloco){
+    uint32_t abertos = registro_blocos_abertos(reg);
+    if(k >= abertos || abertos - k >= REGISTRO_N_BLOCOS){
+        return false;
+    }
+    memcpy(bloco, &reg->blocos[k % REGISTRO_N_BLOCOS], sizeof(*bloco));
+    //o anel pode ter dado a volta durante a copia: a releitura nao pode passar na frente da copia
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return registro_blocos_abertos(reg) - k < REGISTRO_N_BLOCOS;
+}
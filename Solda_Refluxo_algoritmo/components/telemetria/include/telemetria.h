@@ -0,0 +1,100 @@
+#ifndef TELEMETRIA_H
+#define TELEMETRIA_H
+
+/**
+ * @brief Quadros binarios da telemetria do ciclo, enviados a cada amostra e a cada mudanca de segmento.
+ * Cada mensagem vira um quadro:
+ *
+ *   COBS(tipo:8 seq:16 dados crc:16) 0x00
+ *
+ * Os campos sao little endian e o CRC (CRC-16/CCITT-FALSE) cobre tipo, seq e dados. O COBS tira os zeros do
+ * quadro, entao o 0x00 so aparece como delimitador: quem recebe pode comecar a ler no meio do fluxo e descarta
+ * o primeiro quadro incompleto. seq e contado por mensagem, na ordem de envio; um salto no seq e uma mensagem
+ * perdida, seja na fila do ESP32 ou na serial.
+ *
+ * O mesmo codigo monta os quadros no ESP32 (main/telemetria_uart.c) e le no host (host/telemetria_captura.c).
+ *
+ * No sentido contrario, o host manda COMANDO pela mesma serial para exportar os dados guardados
+ * (host/registro_exporta.c):
+ *   TELEMETRIA_CMD_BAUD      muda a velocidade da serial para valor; o ESP32 responde com o mesmo comando na
+ *                            velocidade antiga antes de mudar (valor = velocidade que ficou) e volta para a padrao
+ *                            depois de alguns segundos sem comandos
+ *   TELEMETRIA_CMD_EXPORTA   envia o arquivo a partir do byte valor, em PEDACOs com o deslocamento e o tamanho total,
+ *                            e termina com um PEDACO vazio. Um pedaco perdido e pedido de novo a partir do deslocamento.
+ *                            Todo PEDACO leva o CRC-16 dos primeiros TELEMETRIA_PEDACO_MAX bytes do arquivo, que
+ *                            identifica o ciclo (o cabecalho dos ciclos da flash tem o id; o primeiro bloco do log,
+ *                            as primeiras amostras): quem continua uma exportacao compara com o que ja recebeu
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+enum {
+    TELEMETRIA_AMOSTRA = 1,                         //Uma iteracao do controle
+    TELEMETRIA_ESTAGIO,                             //Inicio de um segmento do perfil
+    TELEMETRIA_FIM,                                 //Perfil concluido
+    TELEMETRIA_COMANDO,                             //Pedido do host (e a resposta do ESP32)
+    TELEMETRIA_PEDACO,                              //Parte de um arquivo exportado
+};
+
+enum {
+    TELEMETRIA_CMD_BAUD = 1,
+    TELEMETRIA_CMD_EXPORTA,
+};
+
+#define TELEMETRIA_PEDACO_MAX 64                    //Um bloco do log por pedaco
+#define TELEMETRIA_MAX_DADOS (TELEMETRIA_PEDACO_MAX + 12)
+#define TELEMETRIA_MAX_QUADRO (TELEMETRIA_MAX_DADOS + 5 + (TELEMETRIA_MAX_DADOS + 5) / 254 + 2)
+
+typedef struct {
+    uint32_t seq;                                   //Numero da amostra do MAX6675
+    int64_t t_us;                                   //Instante da leitura
+    float temp;                                     //Temperatura lida
+    float filtrada;                                 //Temperatura depois do filtro, usada no PID
+    float setpoint;
+    float P, I, D;                                  //Termos do PID
+    float saida;                                    //Duty do rele
+    uint8_t modo;                                   //Segmento do perfil
+    uint8_t sat;                                    //Flags de saturacao do PID (PID_SAT_*)
+} telemetria_amostra_t;
+
+typedef struct {
+    int64_t t_us;                                   //Instante da amostra em que o segmento comecou (ou terminou, em FIM)
+    uint8_t modo;                                   //Novo segmento
+    float setpoint;                                 //Setpoint no inicio do segmento
+} telemetria_estagio_t;
+
+typedef struct {
+    uint8_t cmd;                                    //TELEMETRIA_CMD_*
+    uint8_t arquivo;                                //O que exportar (0 = log do ultimo ciclo)
+    uint32_t valor;                                 //Velocidade ou deslocamento
+} telemetria_comando_t;
+
+typedef struct {
+    uint8_t arquivo;
+    uint32_t deslocamento;                          //Posicao do primeiro byte no arquivo
+    uint32_t total;                                 //Tamanho do arquivo (0 = nada para exportar)
+    uint16_t ciclo;                                 //CRC-16 dos primeiros TELEMETRIA_PEDACO_MAX bytes do arquivo
+    uint8_t n;                                      //Bytes neste pedaco (0 = fim)
+    uint8_t dados[TELEMETRIA_PEDACO_MAX];
+} telemetria_pedaco_t;
+
+typedef struct {
+    uint8_t tipo;                                   //TELEMETRIA_AMOSTRA ... TELEMETRIA_PEDACO
+    uint16_t seq;                                   //Preenchido por quem envia
+    union {
+        telemetria_amostra_t amostra;
+        telemetria_estagio_t estagio;               //ESTAGIO e FIM
+        telemetria_comando_t comando;
+        telemetria_pedaco_t pedaco;
+    };
+} telemetria_msg_t;
+
+uint16_t telemetria_crc16(const uint8_t *dados, size_t n);
+size_t telemetria_cobs_codifica(const uint8_t *dados, size_t n, uint8_t *saida);
+int telemetria_cobs_decodifica(const uint8_t *dados, size_t n, uint8_t *saida);
+size_t telemetria_quadro(const telemetria_msg_t *msg, uint8_t *quadro);
+bool telemetria_le_quadro(const uint8_t *quadro, size_t n, telemetria_msg_t *msg);
+
+#endif
@@ -0,0 +1,249 @@
+#include <string.h>
+#include "telemetria.h"
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polinomio 0x1021, inicio 0xFFFF)
+ *
+ * @param dados
+ * @param n
+ * @return uint16_t
+ */
+uint16_t telemetria_crc16(const uint8_t *dados, size_t n){
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < n; i++){
+        crc ^= (uint16_t)dados[i] << 8;
+        for(int b = 0; b < 8; b++){
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Codifica em COBS: a saida nao tem nenhum byte 0x00
+ *
+ * @param dados
+ * @param n
+ * @param saida pelo menos n + n / 254 + 1 bytes
+ * @return size_t bytes escritos
+ */
+size_t telemetria_cobs_codifica(const uint8_t *dados, size_t n, uint8_t *saida){
+    size_t codigo = 0;                              //Posicao do byte de contagem do grupo atual
+    size_t pos = 1;
+    uint8_t cont = 1;
+    for(size_t i = 0; i < n; i++){
+        if(dados[i] == 0){
+            saida[codigo] = cont;
+            codigo = pos++;
+            cont = 1;
+            continue;
+        }
+        saida[pos++] = dados[i];
+        if(++cont == 0xFF){
+            saida[codigo] = cont;
+            codigo = pos++;
+            cont = 1;
+        }
+    }
+    saida[codigo] = cont;
+    return pos;
+}
+
+/**
+ * @brief Decodifica um quadro COBS (sem o delimitador)
+ *
+ * @param dados
+ * @param n
+ * @param saida pelo menos n bytes
+ * @return int bytes decodificados, ou -1 se o quadro for invalido
+ */
+int telemetria_cobs_decodifica(const uint8_t *dados, size_t n, uint8_t *saida){
+    size_t pos = 0;
+    int tam = 0;
+    while(pos < n){
+        uint8_t cont = dados[pos++];
+        if(cont == 0 || pos + cont - 1 > n){
+            return -1;
+        }
+        for(int i = 1; i < cont; i++){
+            if(dados[pos] == 0){
+                return -1;
+            }
+            saida[tam++] = dados[pos++];
+        }
+        if(cont < 0xFF && pos < n){
+            saida[tam++] = 0;
+        }
+    }
+    return tam;
+}
+
+static uint8_t *escreve16(uint8_t *p, uint16_t v){
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *escreve32(uint8_t *p, uint32_t v){
+    return escreve16(escreve16(p, v & 0xFFFF), v >> 16);
+}
+
+static uint8_t *escreve64(uint8_t *p, int64_t v){
+    return escreve32(escreve32(p, (uint64_t)v & 0xFFFFFFFF), (uint64_t)v >> 32);
+}
+
+static uint8_t *escreve_float(uint8_t *p, float v){
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    return escreve32(p, u);
+}
+
+static uint16_t le16(const uint8_t **p){
+    uint16_t v = (*p)[0] | ((*p)[1] << 8);
+    *p += 2;
+    return v;
+}
+
+static uint32_t le32(const uint8_t **p){
+    uint32_t v = le16(p);
+    return v | ((uint32_t)le16(p) << 16);
+}
+
+static int64_t le64(const uint8_t **p){
+    uint64_t v = le32(p);
+    return (int64_t)(v | ((uint64_t)le32(p) << 32));
+}
+
+static float le_float(const uint8_t **p){
+    uint32_t u = le32(p);
+    float v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+/*Campos da mensagem, sem o CRC*/
+static size_t serializa(const telemetria_msg_t *msg, uint8_t *buf){
+    uint8_t *p = buf;
+    *p++ = msg->tipo;
+    p = escreve16(p, msg->seq);
+    if(msg->tipo == TELEMETRIA_AMOSTRA){
+        const telemetria_amostra_t *a = &msg->amostra;
+        p = escreve32(p, a->seq);
+        p = escreve64(p, a->t_us);
+        p = escreve_float(p, a->temp);
+        p = escreve_float(p, a->filtrada);
+        p = escreve_float(p, a->setpoint);
+        p = escreve_float(p, a->P);
+        p = escreve_float(p, a->I);
+        p = escreve_float(p, a->D);
+        p = escreve_float(p, a->saida);
+        *p++ = a->modo;
+        *p++ = a->sat;
+    }
+    else if(msg->tipo == TELEMETRIA_COMANDO){
+        *p++ = msg->comando.cmd;
+        *p++ = msg->comando.arquivo;
+        p = escreve32(p, msg->comando.valor);
+    }
+    else if(msg->tipo == TELEMETRIA_PEDACO){
+        const telemetria_pedaco_t *d = &msg->pedaco;
+        uint8_t n = d->n > TELEMETRIA_PEDACO_MAX ? TELEMETRIA_PEDACO_MAX : d->n;
+        *p++ = d->arquivo;
+        p = escreve32(p, d->deslocamento);
+        p = escreve32(p, d->total);
+        p = escreve16(p, d->ciclo);
+        *p++ = n;
+        memcpy(p, d->dados, n);
+        p += n;
+    }
+    else{
+        const telemetria_estagio_t *e = &msg->estagio;
+        p = escreve64(p, e->t_us);
+        *p++ = e->modo;
+        p = escreve_float(p, e->setpoint);
+    }
+    return p - buf;
+}
+
+/**
+ * @brief Monta o quadro de uma mensagem, pronto para enviar
+ *
+ * @param msg
+ * @param quadro pelo menos TELEMETRIA_MAX_QUADRO bytes
+ * @return size_t tamanho do quadro, com o delimitador
+ */
+size_t telemetria_quadro(const telemetria_msg_t *msg, uint8_t *quadro){
+    uint8_t buf[TELEMETRIA_MAX_DADOS + 5];
+    size_t n = serializa(msg, buf);
+    escreve16(&buf[n], telemetria_crc16(buf, n));
+    n = telemetria_cobs_codifica(buf, n + 2, quadro);
+    quadro[n++] = 0;
+    return n;
+}
+
+/**
+ * @brief Le um quadro recebido
+ *
+ * @param quadro bytes entre dois delimitadores
+ * @param n
+ * @param msg
+ * @return true se o COBS, o CRC, o tipo e o tamanho estao corretos
+ */
+bool telemetria_le_quadro(const uint8_t *quadro, size_t n, telemetria_msg_t *msg){
+    uint8_t buf[TELEMETRIA_MAX_QUADRO];
+    if(n > sizeof(buf)){
+        return false;
+    }
+    int tam = telemetria_cobs_decodifica(quadro, n, buf);
+    if(tam < 5 || telemetria_crc16(buf, tam - 2) != (buf[tam - 2] | (buf[tam - 1] << 8))){
+        return false;
+    }
+
+    const uint8_t *p = buf;
+    memset(msg, 0, sizeof(*msg));
+    msg->tipo = *p++;
+    msg->seq = le16(&p);
+    if(msg->tipo == TELEMETRIA_AMOSTRA){
+        telemetria_amostra_t *a = &msg->amostra;
+        a->seq = le32(&p);
+        a->t_us = le64(&p);
+        a->temp = le_float(&p);
+        a->filtrada = le_float(&p);
+        a->setpoint = le_float(&p);
+        a->P = le_float(&p);
+        a->I = le_float(&p);
+        a->D = le_float(&p);
+        a->saida = le_float(&p);
+        a->modo = *p++;
+        a->sat = *p++;
+    }
+    else if(msg->tipo == TELEMETRIA_COMANDO){
+        msg->comando.cmd = *p++;
+        msg->comando.arquivo = *p++;
+        msg->comando.valor = le32(&p);
+    }
+    else if(msg->tipo == TELEMETRIA_PEDACO){
+        telemetria_pedaco_t *d = &msg->pedaco;
+        d->arquivo = *p++;
+        d->deslocamento = le32(&p);
+        d->total = le32(&p);
+        d->ciclo = le16(&p);
+        d->n = *p++;
+        if(d->n > TELEMETRIA_PEDACO_MAX || (p - buf) + d->n != tam - 2){
+            return false;
+        }
+        memcpy(d->dados, p, d->n);
+        p += d->n;
+    }
+    else if(msg->tipo == TELEMETRIA_ESTAGIO || msg->tipo == TELEMETRIA_FIM){
+        telemetria_estagio_t *e = &msg->estagio;
+        e->t_us = le64(&p);
+        e->modo = *p++;
+        e->setpoint = le_float(&p);
+    }
+    else{
+        return false;
+    }
+    //O tamanho tem que bater com o tipo
+    return p - buf == tam - 2;
+}
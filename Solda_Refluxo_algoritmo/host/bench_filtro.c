@@ -0,0 +1,31 @@
+/**
+ * @file bench_filtro.c
+ * @brief Ciclos por amostra de cada estagio do filtro no host. No ESP32, compilar com -DFILTRO_BENCH=1.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "filtro_bench.h"
+
+/*TSC no x86; nos demais, nanossegundos*/
+static uint32_t ciclos(void){
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)(t.tv_sec * 1000000000ull + t.tv_nsec);
+#endif
+}
+
+int main(void){
+    filtro_bench_resultado_t res[FILTRO_BENCH_N_CASOS];
+    filtro_bench_executa(ciclos, res);
+
+    printf("%-8s %8s %10s\n", "estagio", "ciclos", "rms graus");
+    for(int i = 0; i < FILTRO_BENCH_N_CASOS; i++){
+        printf("%-8s %8u %10.3f\n", res[i].nome, res[i].ciclos, res[i].rms_ruido);
+    }
+    return 0;
+}
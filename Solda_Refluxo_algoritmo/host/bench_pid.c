@@ -0,0 +1,34 @@
+/**
+ * @file bench_pid.c
+ * @brief Ciclos por atualizacao de cada nucleo do PID no host. Os hashes devem ser iguais aos que o ESP32
+ * imprime quando compilado com -DPID_BENCH=1.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "pid.h"
+#include "pid_bench.h"
+
+/*TSC no x86; nos demais, nanossegundos*/
+static uint32_t ciclos(void){
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)(t.tv_sec * 1000000000ull + t.tv_nsec);
+#endif
+}
+
+int main(void){
+    pid_bench_resultado_t res[PID_BENCH_N_TIPOS];
+    pid_bench_executa(ciclos, res);
+
+    printf("PID compilado em %s\n", pid_nome_numerico());
+    printf("%-8s %8s %10s %12s\n", "tipo", "ciclos", "hash", "saturacoes");
+    for(int i = 0; i < PID_BENCH_N_TIPOS; i++){
+        printf("%-8s %8u   %08x %12u\n", res[i].nome, res[i].ciclos, res[i].hash, res[i].saturacoes);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <time.h>
+#include "hal_host.h"
+#include "tempo.h"
+
+/*HAL cujo tempo virtual e o de tempo_us; cada thread de varredura_pid tem a sua simulacao*/
+static __thread const hal_host_t *relogio;
+
+static void avanca(hal_host_t *host, int64_t dt_us){
+    host->planta.avanca(host->planta.ctx, dt_us);
+    host->t_us += dt_us;
+
+    if(host->escala > 0){
+        int64_t ns = (int64_t)(dt_us * 1000 / host->escala);
+        struct timespec espera = { ns / 1000000000, ns % 1000000000 };
+        nanosleep(&espera, NULL);
+    }
+}
+
+/*Sensor - espera a conversao como o MAX6675 e le a planta*/
+static void le_sensor(void *ctx, max6675_amostra_t *amostra){
+    hal_host_t *host = ctx;
+    avanca(host, (int64_t)host->conversao_ms * 1000);
+    max6675_decodifica(amostra, host->planta.palavra_spi(host->planta.ctx), host->t_us);
+}
+
+/*Atuador - satura como rele_d_altera*/
+static void altera_duty(void *ctx, float d){
+    hal_host_t *host = ctx;
+    if(d >= HAL_HOST_DUTY_MAX){
+        d = HAL_HOST_DUTY_MAX;
+    }
+    else if(d < 0){
+        d = 0;
+    }
+    host->planta.aplica_duty(host->planta.ctx, d);
+}
+
+static int64_t agora_us(void *ctx){
+    hal_host_t *host = ctx;
+    return host->t_us;
+}
+
+static void espera_ms(void *ctx, uint32_t ms){
+    avanca(ctx, (int64_t)ms * 1000);
+}
+
+/**
+ * @brief Preenche a HAL com a planta simulada
+ *
+ * @param host estado da HAL, deve viver enquanto a HAL for usada
+ * @param planta
+ * @param hal
+ */
+void hal_host_inicia(hal_host_t *host, const planta_t *planta, reflow_hal_t *hal){
+    host->planta = *planta;
+    host->t_us = 0;
+    host->conversao_ms = HAL_HOST_CONVERSAO_MS;
+    host->escala = 0;
+
+    hal->ctx = host;
+    hal->le_sensor = le_sensor;
+    hal->altera_duty = altera_duty;
+    hal->agora_us = agora_us;
+    hal->espera_ms = espera_ms;
+    relogio = host;
+}
+
+/**
+ * @brief Relogio do controle no host (ver tempo.h): o tempo virtual da ultima HAL iniciada nesta thread
+ *
+ * @return int64_t
+ */
+int64_t tempo_us(void){
+    return relogio ? relogio->t_us : 0;
+}
+
+/**
+ * @brief Relogio real monotonico em us, para a instrumentacao (o relogio da HAL e virtual)
+ *
+ * @return int64_t
+ */
+int64_t hal_host_relogio_us(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
@@ -0,0 +1,35 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdint.h>
+#include "reflow_hal.h"
+
+#define HAL_HOST_DUTY_MAX 1024                      //Mesmo limite de rele.c (LEDC de 10 bits)
+#define HAL_HOST_CONVERSAO_MS 500                   //Mesma espera de readMax6675
+
+/**
+ * @brief Modelo do forno que fica atras da HAL do host
+ */
+typedef struct {
+    void *ctx;
+    uint16_t (*palavra_spi)(void *ctx);             //Palavra que o MAX6675 colocaria no barramento
+    void (*aplica_duty)(void *ctx, float d);        //Novo duty do rele (ja saturado)
+    void (*avanca)(void *ctx, int64_t dt_us);       //Avanca a simulacao
+} planta_t;
+
+/**
+ * @brief HAL do host. O relogio e virtual: so anda quando a planta e avancada. Com escala = 0 a simulacao
+ * roda tao rapido quanto a CPU permitir; com escala > 0 cada segundo simulado leva 1/escala segundo real.
+ * hal_host_inicia tambem liga tempo_us (tempo.h) a este relogio, na thread que chama.
+ */
+typedef struct {
+    planta_t planta;
+    int64_t t_us;                                   //Tempo virtual
+    uint32_t conversao_ms;                          //Tempo que a leitura do sensor bloqueia
+    double escala;                                  //Tempo simulado por tempo real (0 = o mais rapido possivel)
+} hal_host_t;
+
+void hal_host_inicia(hal_host_t *host, const planta_t *planta, reflow_hal_t *hal);
+int64_t hal_host_relogio_us(void);
+
+#endif
@@ -0,0 +1,736 @@
+/**
+ * @file identifica.c
+ * @brief Ajusta modelos do forno a ciclos gravados (temperatura lida e saida do PID de cada amostra), usando
+ * todos os nucleos.
+ *
+ * identifica [-j threads] [-P potencia_w] [-a ambiente_c] [-d atraso_max_s] [-o modelo.txt] [-F fopdt.txt] [-l] ciclo.csv|telemetria.bin|log.bin ...
+ *   -j  numero de threads (padrao: todos os nucleos)
+ *   -P  potencia da resistencia, que fica fixa no ajuste (padrao: a de planta_forno_param_padrao). So a razao
+ *       entre a potencia e a capacidade termica aparece na temperatura, entao uma das duas precisa ser dada
+ *   -a  temperatura ambiente (padrao: a menor primeira leitura dos ciclos, a de um ciclo com o forno frio). Livre,
+ *       ela se confunde com as perdas
+ *   -d  maior atraso procurado no modelo de primeira ordem (padrao 60 s)
+ *   -o  grava o modelo de duas massas ajustado a todos os ciclos, para reflow_host -m e varredura_pid -m
+ *   -F  grava o modelo de primeira ordem no mesmo formato: sem radiacao e com o atraso como a constante do termopar
+ *   -l  os arquivos que nao sao CSV sao logs do ciclo (blocos de registro.h) e nao quadros da telemetria
+ *
+ * Os ciclos vem do CSV de telemetria_captura, dos quadros binarios (telemetria_captura -o, reflow_host -T) ou dos
+ * logs do ciclo: os ciclos da flash (registro_exporta -a N, com o cabecalho de ciclo_arquivo.h, reconhecidos sozinhos)
+ * e, com -l, os logs sem cabecalho (registro_exporta, reflow_host -w ou -E). Dos logs so entram as amostras com a
+ * saida gravada (registro_saida), que os perfis e os experimentos de excitacao gravam a cada amostra (os logs de
+ * antes disso nao tem a saida dos perfis). Um arquivo com
+ * varios ciclos e dividido no fim de cada um. Dois modelos sao ajustados a cada ciclo, em paralelo, e
+ * depois a todos juntos:
+ *
+ *   primeira ordem com atraso (FOPDT): T[k+1] - Ta = a (T[k] - Ta) + b u[k-d], por minimos quadrados lineares
+ *       para cada atraso d, ficando o de menor erro. Da K = b/(1-a) graus por unidade de duty e tau = -Ts/ln(a)
+ *   duas massas: o modelo do simulador (planta_forno.c), forno com perdas por conveccao e radiacao e o termopar
+ *       atras dele, com o PWM do rele e a quantizacao do MAX6675. Capacidade, perdas e constante do termopar sao
+ *       ajustados por Levenberg-Marquardt sobre o erro da simulacao de cada ciclo com as saidas
+ *       gravadas, partindo do FOPDT
+ *
+ * O erro rms de cada modelo e o da simulacao do ciclo inteiro a partir da primeira amostra, nao o da previsao de
+ * uma amostra.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "planta_forno.h"
+#include "serial_host.h"
+#include "registro.h"
+#include "ciclo_arquivo.h"
+
+#define N_PAR 4                                     //ln capacidade, ln perda, ln radiacao, ln tau do termopar
+#define LM_MAX_ITER 100
+
+typedef struct {
+    double K;                                       //Graus por unidade de duty em regime
+    double tau_s;
+    double atraso_s;
+    double rms;
+    bool ok;
+} fopdt_t;
+
+/**
+ * @brief Um ciclo gravado e os modelos ajustados a ele
+ */
+typedef struct {
+    char nome[80];
+    int n, cap;
+    double *t_s;
+    float *temp;
+    float *duty;                                    //Saida do PID saturada como no rele
+    fopdt_t fopdt;
+    double x[N_PAR];
+    double rms;
+    bool ok;
+} corrida_t;
+
+static struct {
+    corrida_t *corridas;
+    int n_corridas;
+    double ts;                                      //Periodo das amostras
+    double potencia_w;
+    double ambiente_c;
+    double atraso_max_s;
+    planta_forno_param_t base;                      //Parametros que nao sao ajustados
+    atomic_int proximo;
+} id;
+
+/*---------------------------------------------------------------- leitura */
+
+static corrida_t *nova_corrida(const char *arquivo){
+    id.corridas = realloc(id.corridas, (id.n_corridas + 1) * sizeof(corrida_t));
+    corrida_t *c = &id.corridas[id.n_corridas];
+    memset(c, 0, sizeof(*c));
+    snprintf(c->nome, sizeof(c->nome), "%s", arquivo);
+    id.n_corridas++;
+    return c;
+}
+
+static void acrescenta(corrida_t *c, double t_s, float temp, float saida){
+    if(c->n == c->cap){
+        c->cap = c->cap ? 2 * c->cap : 1024;
+        c->t_s = realloc(c->t_s, c->cap * sizeof(double));
+        c->temp = realloc(c->temp, c->cap * sizeof(float));
+        c->duty = realloc(c->duty, c->cap * sizeof(float));
+    }
+    c->t_s[c->n] = t_s;
+    c->temp[c->n] = temp;
+    c->duty[c->n] = saida < 0 ? 0 : saida > HAL_HOST_DUTY_MAX ? HAL_HOST_DUTY_MAX : saida;
+    c->n++;
+}
+
+/*Acrescenta a amostra no ciclo atual ou abre outro (no primeiro arquivo, depois do fim ou se o tempo voltou)*/
+static corrida_t *amostra(corrida_t *c, const char *arquivo, int *ciclo, double t_s, float temp, float saida){
+    if(!c || (c->n && t_s <= c->t_s[c->n - 1])){
+        c = nova_corrida(arquivo);
+        if(++*ciclo > 1){
+            snprintf(c->nome, sizeof(c->nome), "%s#%d", arquivo, *ciclo);
+        }
+    }
+    acrescenta(c, t_s, temp, saida);
+    return c;
+}
+
+/*CSV de telemetria_captura: tipo,seq,amostra,t_s,temp,filtrada,setpoint,P,I,D,saida,segmento,sat*/
+static bool le_csv(const char *arquivo){
+    FILE *f = fopen(arquivo, "r");
+    if(!f){
+        perror(arquivo);
+        return false;
+    }
+    char linha[256];
+    int ciclo = 0;
+    corrida_t *c = NULL;
+    while(fgets(linha, sizeof(linha), f)){
+        double t_s;
+        float temp, saida;
+        if(sscanf(linha, "amostra,%*u,%*u,%lf,%f,%*f,%*f,%*f,%*f,%*f,%f", &t_s, &temp, &saida) == 3){
+            c = amostra(c, arquivo, &ciclo, t_s, temp, saida);
+        }
+        else if(!strncmp(linha, "fim,", 4)){
+            c = NULL;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/*Quadros binarios da telemetria*/
+static bool le_quadros(const char *arquivo){
+    serial_t s;
+    if(!serial_abre(&s, arquivo, 0, false)){
+        return false;
+    }
+    telemetria_msg_t msg;
+    int ciclo = 0;
+    corrida_t *c = NULL;
+    while(serial_recebe(&s, &msg, -1) > 0){
+        if(msg.tipo == TELEMETRIA_AMOSTRA){
+            c = amostra(c, arquivo, &ciclo, msg.amostra.t_us / 1e6, msg.amostra.temp, msg.amostra.saida);
+        }
+        else if(msg.tipo == TELEMETRIA_FIM){
+            c = NULL;
+        }
+    }
+    serial_fecha(&s);
+    return true;
+}
+
+typedef struct {
+    const char *arquivo;
+    corrida_t *c;
+    int ciclo;
+    int sem_saida;                                  //Amostras descartadas por nao ter a saida gravada
+} leitura_log_t;
+
+static void evento_log(void *arg, const registro_evento_t *ev){
+    leitura_log_t *l = arg;
+    if(ev->tipo != REGISTRO_AMOSTRA){
+        return;
+    }
+    if(isnan(ev->saida)){
+        l->sem_saida++;
+        return;
+    }
+    l->c = amostra(l->c, l->arquivo, &l->ciclo, ev->t_ms / 1000.0, ev->real, ev->saida);
+}
+
+/*Indica se o arquivo comeca com o cabecalho de um ciclo da flash*/
+static bool ciclo_da_flash(const char *arquivo){
+    FILE *f = fopen(arquivo, "rb");
+    uint32_t magico = 0;
+    if(f){
+        if(fread(&magico, sizeof(magico), 1, f) != 1){
+            magico = 0;
+        }
+        fclose(f);
+    }
+    return magico == CICLO_MAGICO;
+}
+
+/*Log do ciclo (blocos de registro.h), com ou sem o cabecalho de um ciclo da flash, como em resposta_frequencia*/
+static bool le_log(const char *arquivo){
+    FILE *f = fopen(arquivo, "rb");
+    if(!f){
+        perror(arquivo);
+        return false;
+    }
+    static ciclo_cabecalho_t cab;
+    if(fread(&cab, sizeof(cab), 1, f) != 1 || cab.magico != CICLO_MAGICO){
+        rewind(f);
+    }
+    else if(cab.versao != CICLO_VERSAO || cab.tam_bloco != sizeof(registro_bloco_t)){
+        fprintf(stderr, "%s: versao %u do arquivo nao suportada\n", arquivo, cab.versao);
+        fclose(f);
+        return false;
+    }
+    leitura_log_t l = { .arquivo = arquivo };
+    registro_bloco_t bloco;
+    while(fread(&bloco, sizeof(bloco), 1, f) == 1){
+        registro_decodifica_bloco(&bloco, evento_log, &l);
+    }
+    fclose(f);
+    if(l.sem_saida){
+        fprintf(stderr, "%s: %d amostras sem a saida gravada ignoradas\n", arquivo, l.sem_saida);
+    }
+    return true;
+}
+
+static int compara_double(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*Periodo das amostras: a mediana dos intervalos de todos os ciclos*/
+static double periodo(void){
+    int total = 0;
+    for(int i = 0; i < id.n_corridas; i++){
+        total += id.corridas[i].n - 1;
+    }
+    double *dt = malloc(total * sizeof(double));
+    int n = 0;
+    for(int i = 0; i < id.n_corridas; i++){
+        const corrida_t *c = &id.corridas[i];
+        for(int k = 1; k < c->n; k++){
+            dt[n++] = c->t_s[k] - c->t_s[k - 1];
+        }
+    }
+    qsort(dt, n, sizeof(double), compara_double);
+    double ts = dt[n / 2];
+    free(dt);
+    return ts;
+}
+
+/*---------------------------------------------------------------- algebra */
+
+/*Resolve A x = b (n x n, eliminacao com pivotamento parcial); a solucao fica em b*/
+static bool resolve(double *A, double *b, int n){
+    for(int i = 0; i < n; i++){
+        int p = i;
+        for(int k = i + 1; k < n; k++){
+            if(fabs(A[k * n + i]) > fabs(A[p * n + i])){
+                p = k;
+            }
+        }
+        if(fabs(A[p * n + i]) < 1e-300){
+            return false;
+        }
+        if(p != i){
+            for(int j = 0; j < n; j++){
+                double t = A[i * n + j];
+                A[i * n + j] = A[p * n + j];
+                A[p * n + j] = t;
+            }
+            double t = b[i];
+            b[i] = b[p];
+            b[p] = t;
+        }
+        for(int k = i + 1; k < n; k++){
+            double f = A[k * n + i] / A[i * n + i];
+            for(int j = i; j < n; j++){
+                A[k * n + j] -= f * A[i * n + j];
+            }
+            b[k] -= f * b[i];
+        }
+    }
+    for(int i = n - 1; i >= 0; i--){
+        for(int j = i + 1; j < n; j++){
+            b[i] -= A[i * n + j] * b[j];
+        }
+        b[i] /= A[i * n + i];
+    }
+    return true;
+}
+
+/*---------------------------------------------------------------- primeira ordem com atraso */
+
+/*A amostra k tem as anteriores no periodo: k+1 e k-d estao onde deveriam (sem amostras perdidas no meio)*/
+static bool continua(const corrida_t *c, int k, int d){
+    return fabs(c->t_s[k + 1] - c->t_s[k] - id.ts) < id.ts / 2 && fabs(c->t_s[k] - c->t_s[k - d] - d * id.ts) < id.ts / 2;
+}
+
+/*Simula o FOPDT discreto a partir da primeira amostra e devolve a soma dos quadrados do erro*/
+static double simula_fopdt(const corrida_t *c, const double th[2], int d, int *n){
+    double y = c->temp[0] - id.ambiente_c, sse = 0;
+    for(int k = 0; k + 1 < c->n; k++){
+        y = th[0] * y + th[1] * c->duty[k >= d ? k - d : 0];
+        double e = y + id.ambiente_c - c->temp[k + 1];
+        sse += e * e;
+    }
+    *n += c->n - 1;
+    return sse;
+}
+
+/**
+ * @brief Minimos quadrados de T[k+1] - Ta = a (T[k] - Ta) + b u[k-d] sobre os ciclos, para cada atraso d; fica o de menor
+ * erro de previsao
+ */
+static void ajusta_fopdt(corrida_t **cs, int nc, fopdt_t *f){
+    int d_max = (int)(id.atraso_max_s / id.ts);
+    double melhor = INFINITY, th_melhor[2] = { 0 };
+    int d_melhor = -1;
+    for(int d = 0; d <= d_max; d++){
+        double A[4] = { 0 }, b[2] = { 0 }, yy = 0;
+        int linhas = 0;
+        for(int i = 0; i < nc; i++){
+            const corrida_t *c = cs[i];
+            for(int k = d; k + 1 < c->n; k++){
+                if(!continua(c, k, d)){
+                    continue;
+                }
+                double phi[2] = { c->temp[k] - id.ambiente_c, c->duty[k - d] };
+                double y = c->temp[k + 1] - id.ambiente_c;
+                for(int r = 0; r < 2; r++){
+                    for(int s = 0; s < 2; s++){
+                        A[r * 2 + s] += phi[r] * phi[s];
+                    }
+                    b[r] += phi[r] * y;
+                }
+                yy += y * y;
+                linhas++;
+            }
+        }
+        double th[2] = { b[0], b[1] };
+        double M[4];
+        memcpy(M, A, sizeof(M));
+        if(linhas < 10 || !resolve(M, th, 2)){
+            continue;
+        }
+        //sse = y'y - 2 th'b + th'A th
+        double sse = yy;
+        for(int r = 0; r < 2; r++){
+            sse -= 2 * th[r] * b[r];
+            for(int s = 0; s < 2; s++){
+                sse += th[r] * A[r * 2 + s] * th[s];
+            }
+        }
+        if(sse < melhor && th[0] > 0 && th[0] < 1 && th[1] > 0){
+            melhor = sse;
+            d_melhor = d;
+            memcpy(th_melhor, th, sizeof(th));
+        }
+    }
+
+    memset(f, 0, sizeof(*f));
+    if(d_melhor < 0){
+        return;
+    }
+    double a = th_melhor[0];
+    f->K = th_melhor[1] / (1 - a);
+    f->tau_s = -id.ts / log(a);
+    f->atraso_s = d_melhor * id.ts;
+    double sse = 0;
+    int n = 0;
+    for(int i = 0; i < nc; i++){
+        sse += simula_fopdt(cs[i], th_melhor, d_melhor, &n);
+    }
+    f->rms = sqrt(sse / n);
+    f->ok = true;
+}
+
+/*O FOPDT como parametros do simulador: sem radiacao e com o atraso como a constante do termopar*/
+static void fopdt_para_planta(const fopdt_t *f, planta_forno_param_t *p){
+    *p = id.base;
+    p->perda_w_k = id.potencia_w / (HAL_HOST_DUTY_MAX * f->K);
+    p->capacidade_j_k = f->tau_s * p->perda_w_k;
+    p->radiacao_w_k4 = 0;
+    p->tau_termopar_s = fmax(f->atraso_s, p->passo_s);
+}
+
+/*---------------------------------------------------------------- duas massas */
+
+static void x_para_planta(const double x[N_PAR], planta_forno_param_t *p){
+    *p = id.base;
+    p->capacidade_j_k = exp(x[0]);
+    p->perda_w_k = exp(x[1]);
+    p->radiacao_w_k4 = exp(x[2]);
+    p->tau_termopar_s = exp(x[3]);
+}
+
+static void planta_para_x(const planta_forno_param_t *p, double x[N_PAR]){
+    x[0] = log(p->capacidade_j_k);
+    x[1] = log(p->perda_w_k);
+    x[2] = log(fmax(p->radiacao_w_k4, 1e-15));
+    x[3] = log(p->tau_termopar_s);
+}
+
+/*Erro da simulacao de um ciclo com as saidas gravadas: o forno e o termopar partem da primeira leitura, e o
+relogio da simulacao parte do instante dela, para as janelas do PWM ficarem alinhadas com as do ciclo*/
+static void simula_planta(const planta_forno_param_t *p, const corrida_t *c, double *r){
+    planta_forno_t forno;
+    planta_t planta;
+    planta_forno_inicia(&forno, p);
+    planta_forno_planta(&forno, &planta);
+    forno.temp_forno = forno.temp_termopar = c->temp[0];
+    forno.t_s = c->t_s[0];
+    for(int k = 0; k < c->n; k++){
+        r[k] = forno.temp_termopar - c->temp[k];
+        planta.aplica_duty(&forno, c->duty[k]);
+        if(k + 1 < c->n){
+            planta.avanca(&forno, (int64_t)llround((c->t_s[k + 1] - c->t_s[k]) * 1e6));
+        }
+    }
+}
+
+static void residuos(const double x[N_PAR], corrida_t **cs, int nc, double *r){
+    planta_forno_param_t p;
+    x_para_planta(x, &p);
+    for(int i = 0; i < nc; i++){
+        simula_planta(&p, cs[i], r);
+        r += cs[i]->n;
+    }
+}
+
+static double soma_quadrados(const double *r, int m){
+    double s = 0;
+    for(int i = 0; i < m; i++){
+        s += r[i] * r[i];
+    }
+    return s;
+}
+
+/*Uma coluna do jacobiano por diferenca a frente*/
+typedef struct {
+    const double *x;
+    int j;
+    corrida_t **cs;
+    int nc;
+    const double *r;
+    double *coluna;
+    int m;
+} coluna_t;
+
+static const double passo_jacobiano[N_PAR] = { 1e-4, 1e-4, 1e-3, 1e-4 };
+
+static void *calcula_coluna(void *arg){
+    coluna_t *c = arg;
+    double x[N_PAR];
+    memcpy(x, c->x, sizeof(x));
+    x[c->j] += passo_jacobiano[c->j];
+    residuos(x, c->cs, c->nc, c->coluna);
+    for(int i = 0; i < c->m; i++){
+        c->coluna[i] = (c->coluna[i] - c->r[i]) / passo_jacobiano[c->j];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Levenberg-Marquardt sobre o erro da simulacao dos ciclos. Com paralelo, as colunas do jacobiano sao
+ * calculadas em threads (usado no ajuste de todos os ciclos juntos; os ajustes de cada ciclo ja rodam em paralelo)
+ *
+ * @return double erro rms em graus
+ */
+static double ajusta_planta(corrida_t **cs, int nc, double x[N_PAR], bool paralelo){
+    int m = 0;
+    for(int i = 0; i < nc; i++){
+        m += cs[i]->n;
+    }
+    double *r = malloc(m * sizeof(double));
+    double *r_novo = malloc(m * sizeof(double));
+    double *J = malloc((size_t)N_PAR * m * sizeof(double));
+    residuos(x, cs, nc, r);
+    double sse = soma_quadrados(r, m);
+    double lambda = 1e-3;
+
+    for(int iter = 0; iter < LM_MAX_ITER && lambda < 1e10; iter++){
+        coluna_t colunas[N_PAR];
+        pthread_t t[N_PAR] = { 0 };
+        bool thread[N_PAR];
+        for(int j = 0; j < N_PAR; j++){
+            colunas[j] = (coluna_t){ x, j, cs, nc, r, J + (size_t)j * m, m };
+            thread[j] = paralelo && pthread_create(&t[j], NULL, calcula_coluna, &colunas[j]) == 0;
+            if(!thread[j]){
+                calcula_coluna(&colunas[j]);
+            }
+        }
+        for(int j = 0; j < N_PAR; j++){
+            if(thread[j]){
+                pthread_join(t[j], NULL);
+            }
+        }
+
+        double A[N_PAR * N_PAR], g[N_PAR];
+        for(int a = 0; a < N_PAR; a++){
+            g[a] = 0;
+            for(int i = 0; i < m; i++){
+                g[a] += J[(size_t)a * m + i] * r[i];
+            }
+            for(int b = 0; b <= a; b++){
+                double s = 0;
+                for(int i = 0; i < m; i++){
+                    s += J[(size_t)a * m + i] * J[(size_t)b * m + i];
+                }
+                A[a * N_PAR + b] = A[b * N_PAR + a] = s;
+            }
+        }
+
+        //tenta passos cada vez mais curtos ate o erro cair
+        bool melhorou = false;
+        double reducao = 0;
+        while(lambda < 1e10){
+            double M[N_PAR * N_PAR], delta[N_PAR], x_novo[N_PAR];
+            memcpy(M, A, sizeof(M));
+            for(int a = 0; a < N_PAR; a++){
+                M[a * N_PAR + a] += lambda * (A[a * N_PAR + a] + 1e-12);
+                delta[a] = -g[a];
+            }
+            if(!resolve(M, delta, N_PAR)){
+                lambda *= 10;
+                continue;
+            }
+            for(int a = 0; a < N_PAR; a++){
+                x_novo[a] = x[a] + delta[a];
+            }
+            residuos(x_novo, cs, nc, r_novo);
+            double sse_novo = soma_quadrados(r_novo, m);
+            if(isfinite(sse_novo) && sse_novo < sse){
+                reducao = (sse - sse_novo) / sse;
+                memcpy(x, x_novo, sizeof(x_novo));
+                memcpy(r, r_novo, m * sizeof(double));
+                sse = sse_novo;
+                lambda = fmax(lambda / 10, 1e-9);
+                melhorou = true;
+                break;
+            }
+            lambda *= 10;
+        }
+        if(!melhorou || reducao < 1e-9){
+            break;
+        }
+    }
+    free(r);
+    free(r_novo);
+    free(J);
+    return sqrt(sse / m);
+}
+
+/**
+ * @brief Ajusta as duas massas partindo do FOPDT e dos parametros padrao e fica com o melhor: com um atraso curto
+ * o FOPDT leva a constante do termopar para perto de zero, de onde o ajuste nao sai
+ *
+ * @return double erro rms em graus
+ */
+static double ajusta_partidas(corrida_t **cs, int nc, const fopdt_t *f, double x[N_PAR], bool paralelo){
+    planta_para_x(&id.base, x);
+    double rms = ajusta_planta(cs, nc, x, paralelo);
+    if(f->ok){
+        planta_forno_param_t p;
+        double x_fopdt[N_PAR];
+        fopdt_para_planta(f, &p);
+        p.radiacao_w_k4 = id.base.radiacao_w_k4;
+        planta_para_x(&p, x_fopdt);
+        double rms_fopdt = ajusta_planta(cs, nc, x_fopdt, paralelo);
+        if(rms_fopdt < rms || !isfinite(rms)){
+            memcpy(x, x_fopdt, sizeof(x_fopdt));
+            rms = rms_fopdt;
+        }
+    }
+    return rms;
+}
+
+/*---------------------------------------------------------------- threads */
+
+/*Cada thread pega o proximo ciclo livre e ajusta os dois modelos a ele*/
+static void *trabalhador(void *arg){
+    int i;
+    while((i = atomic_fetch_add(&id.proximo, 1)) < id.n_corridas){
+        corrida_t *c = &id.corridas[i];
+        ajusta_fopdt(&c, 1, &c->fopdt);
+        c->rms = ajusta_partidas(&c, 1, &c->fopdt, c->x, false);
+        c->ok = isfinite(c->rms);
+    }
+    return NULL;
+}
+
+static void imprime(const char *nome, int n, const fopdt_t *f, const double x[N_PAR], double rms){
+    planta_forno_param_t p;
+    x_para_planta(x, &p);
+    if(f->ok){
+        printf("%-28.28s %6d %8.4f %7.1f %6.1f %6.2f", nome, n, f->K, f->tau_s, f->atraso_s, f->rms);
+    }
+    else{
+        printf("%-28.28s %6d %8s %7s %6s %6s", nome, n, "-", "-", "-", "-");
+    }
+    printf(" | %8.0f %6.2f %9.2e %6.2f %6.2f\n", p.capacidade_j_k, p.perda_w_k, p.radiacao_w_k4, p.tau_termopar_s, rms);
+}
+
+static bool grava(const char *arquivo, const planta_forno_param_t *p, const char *modelo, double rms){
+    FILE *f = fopen(arquivo, "w");
+    if(!f){
+        perror(arquivo);
+        return false;
+    }
+    fprintf(f, "# identifica: %s ajustado a %d ciclo(s), erro rms %.2f graus; potencia_w e ambiente_c fixos (-P, -a)\n",
+            modelo, id.n_corridas, rms);
+    planta_forno_param_grava(f, p);
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv){
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *arquivo_modelo = NULL, *arquivo_fopdt = NULL;
+    planta_forno_param_padrao(&id.base);
+    id.potencia_w = id.base.potencia_w;
+    id.atraso_max_s = 60;
+    id.ambiente_c = NAN;
+
+    int opt;
+    bool logs = false;
+    while((opt = getopt(argc, argv, "j:P:a:d:o:F:l")) != -1){
+        switch(opt){
+        case 'j': threads = atoi(optarg); break;
+        case 'P': id.potencia_w = atof(optarg); break;
+        case 'a': id.ambiente_c = atof(optarg); break;
+        case 'd': id.atraso_max_s = atof(optarg); break;
+        case 'o': arquivo_modelo = optarg; break;
+        case 'F': arquivo_fopdt = optarg; break;
+        case 'l': logs = true; break;
+        default:
+            fprintf(stderr, "uso: %s [-j threads] [-P potencia_w] [-a ambiente_c] [-d atraso_max_s] [-o modelo.txt] [-F fopdt.txt] [-l] "
+                            "ciclo.csv|telemetria.bin|log.bin ...\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc || id.potencia_w <= 0){
+        fprintf(stderr, "uso: %s [-j threads] [-P potencia_w] [-a ambiente_c] [-d atraso_max_s] [-o modelo.txt] [-F fopdt.txt] [-l] "
+                        "ciclo.csv|telemetria.bin|log.bin ...\n", argv[0]);
+        return 1;
+    }
+    if(threads < 1){
+        threads = 1;
+    }
+    id.base.potencia_w = id.potencia_w;
+    id.base.ruido_c = 0;
+
+    for(int a = optind; a < argc; a++){
+        size_t tam = strlen(argv[a]);
+        bool ok;
+        if(tam > 4 && !strcmp(argv[a] + tam - 4, ".csv")){
+            ok = le_csv(argv[a]);
+        }
+        else if(logs || ciclo_da_flash(argv[a])){
+            ok = le_log(argv[a]);
+        }
+        else{
+            ok = le_quadros(argv[a]);
+        }
+        if(!ok){
+            return 1;
+        }
+    }
+    //ciclos curtos demais (um reset logo na partida) nao dizem nada
+    int n = 0;
+    for(int i = 0; i < id.n_corridas; i++){
+        if(id.corridas[i].n >= 20){
+            id.corridas[n++] = id.corridas[i];
+        }
+    }
+    id.n_corridas = n;
+    if(n == 0){
+        fprintf(stderr, "nenhum ciclo com amostras suficientes\n");
+        return 1;
+    }
+    id.ts = periodo();
+    if(isnan(id.ambiente_c)){
+        id.ambiente_c = INFINITY;
+        for(int i = 0; i < n; i++){
+            id.ambiente_c = fmin(id.ambiente_c, id.corridas[i].temp[0]);
+        }
+    }
+    id.base.ambiente_c = id.ambiente_c;
+
+    pthread_t *t = malloc(threads * sizeof(pthread_t));
+    for(int i = 0; i < threads; i++){
+        pthread_create(&t[i], NULL, trabalhador, NULL);
+    }
+    for(int i = 0; i < threads; i++){
+        pthread_join(t[i], NULL);
+    }
+    free(t);
+
+    //todos os ciclos juntos
+    corrida_t **todas = malloc(n * sizeof(corrida_t *));
+    int amostras = 0;
+    for(int i = 0; i < n; i++){
+        todas[i] = &id.corridas[i];
+        amostras += id.corridas[i].n;
+    }
+    fopdt_t fopdt;
+    double x[N_PAR];
+    ajusta_fopdt(todas, n, &fopdt);
+    double rms = ajusta_partidas(todas, n, &fopdt, x, true);
+
+    printf("periodo %.3f s, potencia %.0f W, ambiente %.1f graus\n", id.ts, id.potencia_w, id.ambiente_c);
+    printf("%-28s %6s %8s %7s %6s %6s | %8s %6s %9s %6s %6s\n", "ciclo", "amostr", "K", "tau s", "atraso", "rms",
+           "C J/K", "h W/K", "rad W/K4", "tc s", "rms");
+    for(int i = 0; i < n; i++){
+        const corrida_t *c = &id.corridas[i];
+        imprime(c->nome, c->n, &c->fopdt, c->x, c->ok ? c->rms : NAN);
+    }
+    imprime("todos", amostras, &fopdt, x, rms);
+
+    planta_forno_param_t p;
+    x_para_planta(x, &p);
+    if(arquivo_modelo && !grava(arquivo_modelo, &p, "modelo de duas massas", rms)){
+        return 1;
+    }
+    if(arquivo_fopdt){
+        if(!fopdt.ok){
+            fprintf(stderr, "o modelo de primeira ordem nao foi ajustado\n");
+            return 1;
+        }
+        fopdt_para_planta(&fopdt, &p);
+        if(!grava(arquivo_fopdt, &p, "modelo de primeira ordem com atraso", fopdt.rms)){
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <math.h>
+#include <string.h>
+#include "metricas.h"
+
+/**
+ * @brief Zera as metricas
+ *
+ * @param m
+ * @param tabela segmentos do perfil do ciclo, devem viver enquanto as metricas forem usadas
+ */
+void metricas_inicia(metricas_t *m, const perfil_tabela_t *tabela){
+    memset(m, 0, sizeof(*m));
+    m->tabela = tabela;
+    for(int i = 0; i < PERFIL_MAX_SEGMENTOS; i++){
+        m->sobressinal[i] = -INFINITY;
+    }
+}
+
+/*Fecha o estagio atual*/
+static void fecha_estagio(metricas_t *m){
+    m->duracao_s[m->modo] = m->t_s - m->inicio_estagio;
+    m->acomodacao_s[m->modo] = m->ultima_fora - m->inicio_estagio;
+}
+
+/**
+ * @brief Acumula uma amostra
+ *
+ * @param m
+ * @param t_s instante da amostra
+ * @param dt_s periodo desde a amostra anterior
+ * @param modo_operacao estagio do perfil que usou a amostra
+ * @param setpoint
+ * @param temp
+ */
+void metricas_amostra(metricas_t *m, double t_s, double dt_s, int modo_operacao, float setpoint, float temp){
+    if(modo_operacao != m->modo){
+        fecha_estagio(m);
+        m->modo = modo_operacao;
+        m->inicio_estagio = m->t_s;
+        m->ultima_fora = m->t_s;
+    }
+    m->t_s = t_s;
+
+    float erro = temp - setpoint;
+    if(erro > m->sobressinal[modo_operacao]){
+        m->sobressinal[modo_operacao] = erro;
+    }
+    m->iae[modo_operacao] += fabsf(erro) * dt_s;
+    if(fabsf(erro) > METRICAS_BANDA_C){
+        m->ultima_fora = t_s;
+    }
+}
+
+/**
+ * @brief Fecha o ultimo estagio
+ *
+ * @param m
+ * @param terminado se o perfil chegou ao fim
+ */
+void metricas_fim(metricas_t *m, bool terminado){
+    fecha_estagio(m);
+    m->terminado = terminado;
+}
+
+/**
+ * @brief Alvo da imersao: o da primeira rampa, onde termina o pre aquecimento (NAN se o perfil nao tem rampa)
+ */
+float metricas_alvo_imersao(const metricas_t *m){
+    for(int i = 0; i < m->tabela->n; i++){
+        if(m->tabela->segmentos[i].tipo == PERFIL_RAMPA){
+            return m->tabela->segmentos[i].alvo;
+        }
+    }
+    return NAN;
+}
+
+/**
+ * @brief Alvo do pico: o maior alvo dos segmentos com setpoint
+ */
+float metricas_alvo_pico(const metricas_t *m){
+    float pico = NAN;
+    for(int i = 0; i < m->tabela->n; i++){
+        const perfil_segmento_t *seg = &m->tabela->segmentos[i];
+        if(seg->tipo != PERFIL_RESFRIA && !(seg->alvo <= pico)){
+            pico = seg->alvo;
+        }
+    }
+    return pico;
+}
+
+/*Maior sobressinal dos segmentos com setpoint que tem o alvo (o que chega nele e os que o mantem)*/
+static float sobressinal_no_alvo(const metricas_t *m, float alvo){
+    float s = -INFINITY;
+    for(int i = 0; i < m->tabela->n; i++){
+        const perfil_segmento_t *seg = &m->tabela->segmentos[i];
+        if(seg->tipo != PERFIL_RESFRIA && seg->alvo == alvo){
+            s = fmaxf(s, m->sobressinal[i]);
+        }
+    }
+    return s;
+}
+
+/**
+ * @brief Sobressinal no alvo da imersao (150 graus no perfil padrao: pre aquecimento e imersao)
+ */
+float metricas_sobressinal_imersao(const metricas_t *m){
+    return sobressinal_no_alvo(m, metricas_alvo_imersao(m));
+}
+
+/**
+ * @brief Sobressinal no alvo do pico (240 graus no perfil padrao: refluxo partes 2 e 3)
+ */
+float metricas_sobressinal_pico(const metricas_t *m){
+    return sobressinal_no_alvo(m, metricas_alvo_pico(m));
+}
+
+/**
+ * @brief Soma dos tempos de acomodacao dos estagios com setpoint (o resfriamento fica de fora)
+ */
+float metricas_acomodacao_total(const metricas_t *m){
+    float s = 0;
+    for(int i = 0; i < m->tabela->n; i++){
+        if(m->tabela->segmentos[i].tipo != PERFIL_RESFRIA){
+            s += m->acomodacao_s[i];
+        }
+    }
+    return s;
+}
+
+/**
+ * @brief Soma das IAE dos estagios com setpoint
+ */
+float metricas_iae_total(const metricas_t *m){
+    float s = 0;
+    for(int i = 0; i < m->tabela->n; i++){
+        if(m->tabela->segmentos[i].tipo != PERFIL_RESFRIA){
+            s += m->iae[i];
+        }
+    }
+    return s;
+}
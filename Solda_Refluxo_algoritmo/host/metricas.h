@@ -0,0 +1,39 @@
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <stdbool.h>
+#include "perfil.h"
+
+#define METRICAS_BANDA_C 5.0                        //Faixa em torno do setpoint considerada acomodada
+
+/**
+ * @brief Desempenho de um ciclo, por segmento do perfil. Os alvos dos sobressinais e os estagios dos totais saem dos
+ * segmentos da tabela do ciclo: a imersao e o alvo da primeira rampa, o pico e o maior alvo, e o resfriamento fica
+ * fora dos totais
+ */
+typedef struct {
+    const perfil_tabela_t *tabela;                  //Perfil do ciclo
+    float sobressinal[PERFIL_MAX_SEGMENTOS];           //Maior (temp - setpoint) no estagio
+    float acomodacao_s[PERFIL_MAX_SEGMENTOS];          //Tempo ate entrar de vez na banda do setpoint
+    float iae[PERFIL_MAX_SEGMENTOS];                   //Integral do erro absoluto (grau * s)
+    float duracao_s[PERFIL_MAX_SEGMENTOS];             //Duracao do estagio
+    bool terminado;                                 //O perfil chegou ao fim
+    double t_s;                                     //Tempo da ultima amostra
+
+    /*Estado interno*/
+    int modo;
+    double inicio_estagio;
+    double ultima_fora;
+} metricas_t;
+
+void metricas_inicia(metricas_t *m, const perfil_tabela_t *tabela);
+void metricas_amostra(metricas_t *m, double t_s, double dt_s, int modo_operacao, float setpoint, float temp);
+void metricas_fim(metricas_t *m, bool terminado);
+float metricas_alvo_imersao(const metricas_t *m);
+float metricas_alvo_pico(const metricas_t *m);
+float metricas_sobressinal_imersao(const metricas_t *m);
+float metricas_sobressinal_pico(const metricas_t *m);
+float metricas_acomodacao_total(const metricas_t *m);
+float metricas_iae_total(const metricas_t *m);
+
+#endif
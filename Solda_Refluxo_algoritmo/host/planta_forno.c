@@ -0,0 +1,252 @@
+/**
+ * @file planta_forno.c
+ * @brief Modelo concentrado do forno para rodar atras da HAL do host.
+ *
+ * Forno:    C dT/dt = P * rele(t) - h (T - Ta) - r (T^4 - Ta^4)   (r em kelvin)
+ * Termopar: tau dTt/dt = T - Tt
+ *
+ * O rele segue o PWM do LEDC: janela de 1s, fechado durante duty/1024 da janela, e o novo duty so vale
+ * a partir da proxima janela. A leitura e entregue como a palavra do SPI e passa pela mesma decodificacao
+ * do firmware (max6675_decodifica), com a quantizacao de 0,25 grau do MAX6675.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "planta_forno.h"
+
+#define KELVIN 273.15
+
+/*Parametros gravados e lidos em texto, pelo nome do campo*/
+static const struct {
+    const char *nome;
+    size_t desl;
+} campos[] = {
+    { "potencia_w",     offsetof(planta_forno_param_t, potencia_w) },
+    { "capacidade_j_k", offsetof(planta_forno_param_t, capacidade_j_k) },
+    { "perda_w_k",      offsetof(planta_forno_param_t, perda_w_k) },
+    { "radiacao_w_k4",  offsetof(planta_forno_param_t, radiacao_w_k4) },
+    { "ambiente_c",     offsetof(planta_forno_param_t, ambiente_c) },
+    { "tau_termopar_s", offsetof(planta_forno_param_t, tau_termopar_s) },
+    { "janela_rele_s",  offsetof(planta_forno_param_t, janela_rele_s) },
+    { "passo_s",        offsetof(planta_forno_param_t, passo_s) },
+    { "ruido_c",        offsetof(planta_forno_param_t, ruido_c) },
+};
+#define N_CAMPOS (sizeof(campos) / sizeof(campos[0]))
+
+/**
+ * @brief Parametros padrao: forno de 4000W que aquece ~1,3 grau/s e perde ~800W a 220 graus
+ *
+ * @param p
+ */
+void planta_forno_param_padrao(planta_forno_param_t *p){
+    p->potencia_w = 4000;
+    p->capacidade_j_k = 3000;
+    p->perda_w_k = 3.0;
+    p->radiacao_w_k4 = 4e-9;
+    p->ambiente_c = 25;
+    p->tau_termopar_s = 5;
+    p->janela_rele_s = 1;
+    p->passo_s = 0.01;
+    p->ruido_c = 0;
+}
+
+/**
+ * @brief Le parametros em texto, um por linha ("perda_w_k 3.2"), como os gravados por planta_forno_param_grava
+ * (ver identifica). Linhas vazias e comecando com # sao ignoradas; os parametros ausentes ficam como estao. Os
+ * parametros so sao alterados se o texto inteiro for valido.
+ *
+ * @param p
+ * @param texto
+ * @return int 0 se leu, ou o numero da linha com erro
+ */
+int planta_forno_param_le(planta_forno_param_t *p, const char *texto){
+    planta_forno_param_t lido = *p;
+    int linha = 0;
+    while(*texto){
+        char buf[96];
+        size_t tam = strcspn(texto, "\n");
+        const char *c = texto + strspn(texto, " \t\r");
+        linha++;
+        texto += tam + (texto[tam] == '\n');
+        if(c >= texto || *c == '\n' || *c == '#'){
+            continue;
+        }
+        tam = strcspn(c, "\n");
+        if(tam >= sizeof(buf)){
+            return linha;
+        }
+        memcpy(buf, c, tam);
+        buf[tam] = '\0';
+        char nome[32];
+        double v;
+        if(sscanf(buf, "%31s %lf", nome, &v) != 2 || !isfinite(v)){
+            return linha;
+        }
+        size_t i;
+        for(i = 0; i < N_CAMPOS && strcmp(nome, campos[i].nome); i++);
+        if(i == N_CAMPOS){
+            return linha;
+        }
+        *(double *)((char *)&lido + campos[i].desl) = v;
+    }
+    if(lido.capacidade_j_k <= 0 || lido.tau_termopar_s <= 0 || lido.janela_rele_s <= 0 || lido.passo_s <= 0){
+        return linha;
+    }
+    *p = lido;
+    return 0;
+}
+
+/**
+ * @brief Le os parametros de um arquivo (planta_forno_param_le), avisando os erros na saida de erro
+ *
+ * @param p
+ * @param arquivo
+ * @return true se leu
+ */
+bool planta_forno_param_carrega(planta_forno_param_t *p, const char *arquivo){
+    static char texto[4096];
+    FILE *f = fopen(arquivo, "r");
+    if(!f){
+        perror(arquivo);
+        return false;
+    }
+    size_t n = fread(texto, 1, sizeof(texto) - 1, f);
+    fclose(f);
+    texto[n] = '\0';
+
+    int erro = planta_forno_param_le(p, texto);
+    if(erro){
+        fprintf(stderr, "%s:%d: parametro invalido\n", arquivo, erro);
+    }
+    return erro == 0;
+}
+
+/**
+ * @brief Grava os parametros em texto, no formato de planta_forno_param_le
+ *
+ * @param f
+ * @param p
+ */
+void planta_forno_param_grava(FILE *f, const planta_forno_param_t *p){
+    for(size_t i = 0; i < N_CAMPOS; i++){
+        fprintf(f, "%-16s %.9g\n", campos[i].nome, *(const double *)((const char *)p + campos[i].desl));
+    }
+}
+
+/**
+ * @brief Inicia o forno na temperatura ambiente e com o rele aberto
+ *
+ * @param forno
+ * @param p
+ */
+void planta_forno_inicia(planta_forno_t *forno, const planta_forno_param_t *p){
+    forno->p = *p;
+    forno->t_s = 0;
+    forno->temp_forno = p->ambiente_c;
+    forno->temp_termopar = p->ambiente_c;
+    forno->duty = 0;
+    forno->duty_janela = 0;
+    forno->inicio_janela = 0;
+    forno->resto_s = 0;
+    forno->semente = 12345;
+}
+
+/*Ruido gaussiano (Box-Muller sobre um xorshift), deterministico para cada simulacao*/
+static double ruido(planta_forno_t *forno){
+    double u[2];
+    for(int i = 0; i < 2; i++){
+        uint32_t x = forno->semente;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        forno->semente = x;
+        u[i] = (x + 1.0) / 4294967297.0;
+    }
+    return sqrt(-2 * log(u[0])) * cos(2 * M_PI * u[1]);
+}
+
+static void passo(planta_forno_t *forno, double dt){
+    const planta_forno_param_t *p = &forno->p;
+
+    /*Nova janela do PWM: o LEDC so aplica o duty novo no inicio do periodo*/
+    if(forno->t_s - forno->inicio_janela >= p->janela_rele_s){
+        forno->inicio_janela += p->janela_rele_s * floor((forno->t_s - forno->inicio_janela) / p->janela_rele_s);
+        forno->duty_janela = forno->duty;
+    }
+    double fase = (forno->t_s - forno->inicio_janela) / p->janela_rele_s;
+    int fechado = fase < forno->duty_janela / HAL_HOST_DUTY_MAX;
+
+    double T = forno->temp_forno + KELVIN;
+    double Ta = p->ambiente_c + KELVIN;
+    double q = (fechado ? p->potencia_w : 0)
+             - p->perda_w_k * (T - Ta)
+             - p->radiacao_w_k4 * (T*T*T*T - Ta*Ta*Ta*Ta);
+    forno->temp_forno += q * dt / p->capacidade_j_k;
+    forno->temp_termopar += (forno->temp_forno - forno->temp_termopar) * dt / p->tau_termopar_s;
+    forno->t_s += dt;
+}
+
+/**
+ * @brief Avanca a simulacao em passos fixos de p.passo_s
+ *
+ * @param forno
+ * @param dt_s
+ */
+static void avanca(planta_forno_t *forno, double dt_s){
+    double h = forno->p.passo_s;
+    forno->resto_s += dt_s;
+    while(forno->resto_s >= h){
+        passo(forno, h);
+        forno->resto_s -= h;
+    }
+}
+
+/**
+ * @brief Palavra de 16 bits que o MAX6675 colocaria no barramento (bytes trocados, como chega em rawtemp)
+ *
+ * @param forno
+ * @return uint16_t
+ */
+uint16_t planta_forno_palavra_spi(planta_forno_t *forno){
+    double t = forno->temp_termopar;
+    if(forno->p.ruido_c > 0){
+        t += forno->p.ruido_c * ruido(forno);
+    }
+    /*12 bits de 0,25 grau, de 0 a 1023,75 graus*/
+    long contagem = lround(t * 4);
+    if(contagem < 0){
+        contagem = 0;
+    }
+    else if(contagem > 0xFFF){
+        contagem = 0xFFF;
+    }
+    uint16_t palavra = (uint16_t)(contagem << 3);
+    return (uint16_t)((palavra >> 8) | (palavra << 8));
+}
+
+static uint16_t palavra_spi(void *ctx){
+    return planta_forno_palavra_spi(ctx);
+}
+
+static void aplica_duty(void *ctx, float d){
+    ((planta_forno_t *)ctx)->duty = d;
+}
+
+static void avanca_planta(void *ctx, int64_t dt_us){
+    avanca(ctx, dt_us / 1e6);
+}
+
+/**
+ * @brief Interface de planta para hal_host_inicia
+ *
+ * @param forno
+ * @param planta
+ */
+void planta_forno_planta(planta_forno_t *forno, planta_t *planta){
+    planta->ctx = forno;
+    planta->palavra_spi = palavra_spi;
+    planta->aplica_duty = aplica_duty;
+    planta->avanca = avanca_planta;
+}
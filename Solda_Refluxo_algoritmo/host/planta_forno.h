@@ -0,0 +1,47 @@
+#ifndef PLANTA_FORNO_H
+#define PLANTA_FORNO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "hal_host.h"
+
+/**
+ * @brief Parametros do modelo concentrado do forno
+ */
+typedef struct {
+    double potencia_w;                              //Potencia da resistencia com o rele fechado
+    double capacidade_j_k;                          //Massa termica do forno + placa
+    double perda_w_k;                               //Perda por conveccao/conducao para o ambiente
+    double radiacao_w_k4;                           //Perda por radiacao (eps * sigma * area)
+    double ambiente_c;                              //Temperatura ambiente
+    double tau_termopar_s;                          //Constante de tempo do termopar
+    double janela_rele_s;                           //Periodo do PWM do rele (LEDC a 1 Hz em rele_pwm_set)
+    double passo_s;                                 //Passo de integracao
+    double ruido_c;                                 //Desvio padrao do ruido do termopar
+} planta_forno_param_t;
+
+/**
+ * @brief Estado da simulacao
+ */
+typedef struct {
+    planta_forno_param_t p;
+    double t_s;                                     //Tempo simulado
+    double temp_forno;                              //Temperatura do forno
+    double temp_termopar;                           //Temperatura da junta do termopar
+    float duty;                                     //Duty pedido pelo controle (0 a HAL_HOST_DUTY_MAX)
+    float duty_janela;                              //Duty da janela atual do PWM
+    double inicio_janela;                           //Inicio da janela atual
+    double resto_s;                                 //Tempo que sobrou do ultimo passo
+    uint32_t semente;                               //Estado do gerador do ruido
+} planta_forno_t;
+
+void planta_forno_param_padrao(planta_forno_param_t *p);
+int planta_forno_param_le(planta_forno_param_t *p, const char *texto);
+bool planta_forno_param_carrega(planta_forno_param_t *p, const char *arquivo);
+void planta_forno_param_grava(FILE *f, const planta_forno_param_t *p);
+void planta_forno_inicia(planta_forno_t *forno, const planta_forno_param_t *p);
+void planta_forno_planta(planta_forno_t *forno, planta_t *planta);
+uint16_t planta_forno_palavra_spi(planta_forno_t *forno);
+
+#endif
@@ -0,0 +1,323 @@
+/**
+ * @file reflow_host.c
+ * @brief Executa o ciclo de solda por refluxo no host, com a mesma logica de controle do ESP32.
+ *
+ * reflow_host [-n ciclos] [-e escala] [-r ruido] [-m modelo.txt] [-g kp,ki,kd] [-s ganhos.txt] [-a] [-A setpoint] [-E prbs|chirp] [-p perfil] [-v] [-l] [-w log.bin] [-T telemetria.bin]
+ *   -n  numero de ciclos completos a executar (padrao 1)
+ *   -e  tempo simulado por tempo real (padrao 0 = o mais rapido possivel; 1 = tempo real)
+ *   -r  desvio padrao do ruido do termopar em graus (padrao 0)
+ *   -m  parametros do forno em texto (planta_forno_param_le), como os ajustados por identifica
+ *   -g  ganhos do PID (padrao 3,24,4 como em main.c)
+ *   -s  escalonamento dos ganhos: tabela em texto com os ganhos por estagio e faixa de temperatura (ver
+ *       escalonamento_tabela_le), como a gravada por varredura_pid -s; fora das faixas usa os ganhos de -g
+ *   -a  controle auto-ajustavel (ver adaptativo.h): estima o modelo do forno a cada amostra e recalcula o controle,
+ *       voltando aos ganhos de -g enquanto o modelo nao e valido. Imprime o modelo no fim do primeiro ciclo
+ *   -A  antes dos ciclos, sintoniza o PID pelo experimento do rele em volta do setpoint (ver autotune.h), como o
+ *       comando 't' do console do ESP32, e usa os ganhos encontrados
+ *   -E  em vez dos ciclos, faz o experimento de excitacao em EXCITACAO_TEMPERATURA (ver excitacao.h), como o comando
+ *       'e' do console do ESP32. O log (-w, gravado durante o experimento) fica com a saida e a temperatura de cada
+ *       amostra, para resposta_frequencia
+ *   -p  perfil: padrao, sac305, sn63pb37, snbi (perfis_solda.h) ou um arquivo com a tabela em texto (ver perfil_tabela_le)
+ *   -v  imprime as temperaturas ideal (refeita pelo perfil) e real do ultimo ciclo, decodificadas do log, como printar_task
+ *   -l  mede o tempo de cada fase do laco em todos os ciclos e imprime os histogramas no final
+ *   -w  grava os blocos do log do ultimo ciclo, do mais antigo para o mais novo (ver registro_decodifica)
+ *   -T  grava os quadros de telemetria de todos os ciclos, como sairiam da UART do ESP32 (ver telemetria_captura).
+ *       Com -e 1 e um fifo, simula o fluxo ao vivo
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include "simulacao.h"
+#include "tempo.h"
+#include "autotune.h"
+#include "excitacao.h"
+#include "adaptativo.h"
+
+static void imprime_estagio(void *arg, int modo_operacao){
+    simulacao_t *sim = arg;
+    printf("[%7.1f s] %-16s forno %6.1f  termopar %6.1f\n", tempo_us() / 1e6,
+           perfil_nome_estagio(sim->perfil.tabela, modo_operacao),
+           sim->forno.temp_forno, sim->forno.temp_termopar);
+}
+
+static bool le_escalonamento(escalonamento_tabela_t *tabela, const char *arquivo){
+    static char texto[4096];
+    FILE *f = fopen(arquivo, "r");
+    if(!f){
+        perror(arquivo);
+        return false;
+    }
+    size_t n = fread(texto, 1, sizeof(texto) - 1, f);
+    fclose(f);
+    texto[n] = '\0';
+
+    int erro = escalonamento_tabela_le(tabela, texto);
+    if(erro > 0){
+        fprintf(stderr, "%s:%d: faixa invalida\n", arquivo, erro);
+    }
+    return erro == 0;
+}
+
+static void imprime_ideal(void *arg, const registro_evento_t *ev){
+    if(ev->tipo == REGISTRO_AMOSTRA){
+        printf("%.2f ", perfil_ideal(arg, ev));
+    }
+}
+
+static void imprime_real(void *arg, const registro_evento_t *ev){
+    if(ev->tipo == REGISTRO_AMOSTRA){
+        printf("%.2f ", ev->real);
+    }
+}
+
+/*Grava os blocos do log como estao na memoria*/
+static bool grava_registro(const registro_t *reg, const char *arquivo){
+    FILE *f = fopen(arquivo, "wb");
+    if(!f){
+        perror(arquivo);
+        return false;
+    }
+    for(uint32_t b = 0; b < registro_n_blocos(reg); b++){
+        fwrite(registro_bloco(reg, b), sizeof(registro_bloco_t), 1, f);
+    }
+    fclose(f);
+    return true;
+}
+
+/*Experimento do rele sobre um forno novo; troca os ganhos pelos encontrados*/
+static bool sintoniza(const planta_forno_param_t *param, float setpoint, float *kp, float *ki, float *kd){
+    static simulacao_t sim;
+    autotune_t at;
+    simulacao_inicia(&sim, param, NULL, *kp, *ki, *kd);
+    autotune_inicia(&at, setpoint, AUTOTUNE_HISTERESE, HAL_HOST_DUTY_MAX);
+    int estado = autotune_executa(&at, &sim.hal, &sim.filtro);
+    printf("autotune em %.0f graus: %s em %.1f s\n", setpoint, autotune_nome_estado(estado), tempo_us() / 1e6);
+    if(!autotune_ganhos(&at, AUTOTUNE_REGRA, kp, ki, kd)){
+        return false;
+    }
+    printf("Ku %.1f  Pu %.1f s  amplitude %.2f graus -> kp %.3f ki %.4f kd %.2f\n", at.ku, at.pu_s, at.amplitude,
+           *kp, *ki, *kd);
+    return true;
+}
+
+/*Grava no arquivo os blocos do log que ficaram completos desde a ultima chamada (ou todos, no fim), antes que o
+ anel de a volta, como arquivo_task no ESP32*/
+static uint32_t grava_completos(const registro_t *reg, uint32_t gravados, bool fim, FILE *f){
+    uint32_t completos = fim ? registro_blocos_abertos(reg) : registro_blocos_completos(reg);
+    registro_bloco_t bloco;
+    for(; gravados < completos && registro_copia_bloco(reg, gravados, &bloco); gravados++){
+        fwrite(&bloco, sizeof(bloco), 1, f);
+    }
+    return gravados;
+}
+
+/*Excitacao para identificacao sobre um forno novo, uma amostra por leitura do sensor como em control_pwm*/
+static bool excita(const planta_forno_param_t *param, int sinal, const char *arquivo){
+    static simulacao_t sim;
+    excitacao_config_t cfg;
+    excitacao_t ex;
+    FILE *f = NULL;
+    if(arquivo && !(f = fopen(arquivo, "wb"))){
+        perror(arquivo);
+        return false;
+    }
+    simulacao_inicia(&sim, param, NULL, 0, 0, 0);
+    excitacao_config_padrao(&cfg, sinal);
+    excitacao_inicia(&ex, &cfg, HAL_HOST_DUTY_MAX, &sim.registro);
+    uint32_t gravados = 0;
+    while(ex.estado == EXCITACAO_RODANDO){
+        max6675_amostra_t amostra;
+        sim.hal.le_sensor(sim.hal.ctx, &amostra);
+        if(amostra.aberto){
+            sim.hal.altera_duty(sim.hal.ctx, 0);
+            continue;
+        }
+        float lida = max6675_graus(&amostra);
+        float temp = filtro_aplica(&sim.filtro, lida);
+        sim.hal.altera_duty(sim.hal.ctx, excitacao_passo(&ex, lida, temp, amostra.t_us));
+        if(f){
+            gravados = grava_completos(&sim.registro, gravados, false, f);
+        }
+    }
+    sim.hal.altera_duty(sim.hal.ctx, 0);
+    printf("excitacao %s em %.0f graus: %s em %.1f s, duty de equilibrio %.1f, amplitude %.1f\n",
+           excitacao_nome_sinal(sinal), cfg.temperatura, excitacao_nome_estado(ex.estado), tempo_us() / 1e6,
+           ex.equilibrio, ex.amplitude);
+    if(f){
+        gravados = grava_completos(&sim.registro, gravados, true, f);
+        fclose(f);
+        printf("log: %u blocos de %u bytes gravados\n", gravados, (unsigned)sizeof(registro_bloco_t));
+    }
+    return ex.estado == EXCITACAO_PRONTO;
+}
+
+static void imprime_metricas(const metricas_t *m, const perfil_tabela_t *tabela){
+    printf("%-16s %10s %12s %10s %10s\n", "estagio", "duracao s", "acomodacao s", "sobressin.", "IAE");
+    for(int i = 0; i < tabela->n; i++){
+        printf("%-16s %10.1f %12.1f %10.1f %10.0f\n", perfil_nome_estagio(tabela, i), m->duracao_s[i], m->acomodacao_s[i],
+               m->sobressinal[i], m->iae[i]);
+    }
+}
+
+int main(int argc, char **argv){
+    int ciclos = 1;
+    bool verboso = false;
+    bool instrumenta = false;
+    const char *arquivo_registro = NULL;
+    FILE *telemetria = NULL;
+    double escala = 0;
+    float kp = 3, ki = 24, kd = 4;
+    planta_forno_param_t param;
+    perfil_tabela_t tabela = perfil_tabela_padrao;
+    planta_forno_param_padrao(&param);
+
+    bool adaptativo = false;
+    static escalonamento_tabela_t escalonamento;
+    bool escalona = false;
+    float autotune = 0;
+    int excitacao = -1;
+    int opt;
+    while((opt = getopt(argc, argv, "n:e:r:m:g:s:aA:E:p:vlw:T:")) != -1){
+        switch(opt){
+        case 'n':
+            ciclos = atoi(optarg);
+            //sem nenhum ciclo nao ha metricas para imprimir
+            if(ciclos < 1){
+                fprintf(stderr, "numero de ciclos invalido: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'e': escala = atof(optarg); break;
+        case 'r': param.ruido_c = atof(optarg); break;
+        case 'm':
+            if(!planta_forno_param_carrega(&param, optarg)){
+                return 1;
+            }
+            break;
+        case 'g':
+            if(sscanf(optarg, "%f,%f,%f", &kp, &ki, &kd) != 3){
+                fprintf(stderr, "ganhos invalidos: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            if(!le_escalonamento(&escalonamento, optarg)){
+                return 1;
+            }
+            escalona = true;
+            break;
+        case 'a': adaptativo = true; break;
+        case 'A': autotune = atof(optarg); break;
+        case 'E':
+            excitacao = excitacao_busca_sinal(optarg);
+            if(excitacao < 0){
+                fprintf(stderr, "sinal desconhecido: %s (prbs ou chirp)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            if(!simulacao_perfil(&tabela, optarg)){
+                return 1;
+            }
+            break;
+        case 'v': verboso = true; break;
+        case 'l': instrumenta = true; break;
+        case 'w': arquivo_registro = optarg; break;
+        case 'T':
+            telemetria = fopen(optarg, "wb");
+            if(!telemetria){
+                perror(optarg);
+                return 1;
+            }
+            //sem buffer, para quem le o fifo ver cada quadro quando ele e gerado
+            setvbuf(telemetria, NULL, _IONBF, 0);
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n ciclos] [-e escala] [-r ruido] [-m modelo.txt] [-g kp,ki,kd] [-s ganhos.txt] [-a] [-A setpoint] [-E prbs|chirp] [-p perfil] [-v] [-l] [-w log.bin] [-T telemetria.bin]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if(autotune > 0 && !sintoniza(&param, autotune, &kp, &ki, &kd)){
+        return 1;
+    }
+
+    if(excitacao >= 0){
+        return excita(&param, excitacao, arquivo_registro) ? 0 : 1;
+    }
+
+    static simulacao_t sim;
+    metricas_t m;
+    latencia_t lat;
+    latencia_inicia(&lat, hal_host_relogio_us, HAL_HOST_CONVERSAO_MS * 1000);
+    struct timespec inicio, fim;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+    for(int c = 0; c < ciclos; c++){
+        simulacao_inicia(&sim, &param, &tabela, kp, ki, kd);
+        sim.host.escala = escala;
+        sim.telemetria = telemetria;
+        if(instrumenta){
+            sim.reflow.latencia = &lat;
+        }
+        if(escalona){
+            escalonamento_inicia(&sim.escalonamento, &escalonamento, kp, ki, kd);
+            sim.reflow.escalonamento = &sim.escalonamento;
+        }
+        if(adaptativo){
+            adaptativo_inicia(&sim.adaptativo, kp, ki, kd, HAL_HOST_CONVERSAO_MS / 1000.0f, HAL_HOST_DUTY_MAX, true);
+            sim.adaptativo.escalonamento = sim.reflow.escalonamento;
+            sim.reflow.adaptativo = &sim.adaptativo;
+        }
+        if(c == 0){
+            sim.reflow.estagio_cb = imprime_estagio;
+            sim.reflow.arg = &sim;
+        }
+        if(!simulacao_executa(&sim, c == 0 ? &m : NULL) && c == 0){
+            printf("ciclo nao terminou: %s parado em %.2f graus\n", perfil_nome_estagio(&tabela, sim.perfil.modo_operacao),
+                   sim.forno.temp_termopar);
+        }
+        if(escalona && c == 0){
+            printf("escalonamento: %d faixa(s), %u troca(s) de ganhos\n", escalonamento.n, sim.escalonamento.trocas);
+        }
+        if(adaptativo && c == 0){
+            adaptativo_t *ad = &sim.adaptativo;
+            printf("adaptativo %s: a %.5f b %.3g graus/duty c %.3f graus, kp %.2f ki %.4f, feedforward %.1f; "
+                   "%u queda(s) para o PID fixo, %u reinicio(s)\n", adaptativo_nome_estado(ad->estado), ad->a, ad->b,
+                   ad->c, ad->kp, ad->ki, ad->feedforward, ad->quedas, ad->reinicios);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &fim);
+    if(telemetria){
+        fclose(telemetria);
+    }
+    double s = (fim.tv_sec - inicio.tv_sec) + (fim.tv_nsec - inicio.tv_nsec) / 1e9;
+    imprime_metricas(&m, &tabela);
+    printf("%d ciclo(s) de %.1f s simulados em %.3f s (%.0f ciclos/s)\n",
+           ciclos, sim.host.t_us / 1e6, s, ciclos / s);
+    if(instrumenta){
+        latencia_imprime(&lat);
+    }
+
+    printf("log: %u blocos de %u bytes, %u descartados\n", registro_n_blocos(&sim.registro),
+           (unsigned)sizeof(registro_bloco_t), sim.registro.perdidos);
+
+    if(verboso){
+        perfil_ideal_t ideal;
+        perfil_ideal_inicia(&ideal, &tabela);
+        printf("Temperatura ideal: ");
+        registro_percorre(&sim.registro, imprime_ideal, &ideal);
+        printf("\nTemperatura real: ");
+        registro_percorre(&sim.registro, imprime_real, NULL);
+        printf("\n");
+    }
+    if(arquivo_registro && !grava_registro(&sim.registro, arquivo_registro)){
+        return 1;
+    }
+    return 0;
+}
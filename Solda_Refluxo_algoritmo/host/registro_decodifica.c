@@ -0,0 +1,101 @@
+/**
+ * @file registro_decodifica.c
+ * @brief Converte os blocos do log do ciclo (registro.h) em CSV.
+ *
+ * registro_decodifica [-t perfil] log.bin > ciclo.csv
+ *   -t  perfil usado no ciclo (padrao, sac305, sn63pb37 ou snbi; padrao se o arquivo nao tem cabecalho). O log nao
+ *       guarda o setpoint: a coluna ideal e refeita pela tabela do perfil (perfil_ideal), entao o perfil e os
+ *       limites TRAJETORIA_* devem ser os do ciclo
+ *
+ * O arquivo e a sequencia de blocos de 64 bytes do mais antigo para o mais novo, como gravada por reflow_host -w.
+ * O ESP32 e o host sao little endian e o bloco nao tem enchimento, entao o mesmo formato vale para os dois.
+ * A coluna saida e a saida do controle calculada com a amostra (registro_saida), vazia nos logs sem ela.
+ *
+ * Um ciclo guardado na flash (registro_exporta -a 1) comeca com o cabecalho de ciclo_arquivo.h; nesse caso a
+ * tabela do perfil vem do cabecalho e -t nao e necessario.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "registro.h"
+#include "perfis_solda.h"
+#include "ciclo_arquivo.h"
+#include "excitacao.h"
+
+static void imprime(void *arg, const registro_evento_t *ev){
+    perfil_ideal_t *ideal = arg;
+    if(ev->tipo == REGISTRO_AMOSTRA){
+        printf("%.3f,%d,%.2f,%.2f,", ev->t_ms / 1000.0, ev->modo, perfil_ideal(ideal, ev), ev->real);
+        if(!isnan(ev->saida)){
+            printf("%.2f", ev->saida);
+        }
+        printf(",\n");
+    }
+    else{
+        const char *nome = excitacao_nome_fase(ev->modo);
+        printf("%.3f,%d,,,,%s\n", ev->t_ms / 1000.0, ev->modo, nome ? nome : perfil_nome_estagio(ideal->tabela, ev->modo));
+    }
+}
+
+int main(int argc, char **argv){
+    const perfil_tabela_t *tabela = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "t:")) != -1){
+        switch(opt){
+        case 't':
+            tabela = perfis_solda_busca(optarg);
+            if(!tabela){
+                fprintf(stderr, "perfil desconhecido: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-t perfil] log.bin\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc){
+        fprintf(stderr, "uso: %s [-t perfil] log.bin\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(argv[optind], "rb");
+    if(!f){
+        perror(argv[optind]);
+        return 1;
+    }
+    //ciclo da flash: o perfil vem do cabecalho, a nao ser que -t tenha sido dado
+    static ciclo_cabecalho_t cab;
+    if(fread(&cab, sizeof(cab), 1, f) == 1 && cab.magico == CICLO_MAGICO){
+        if(cab.versao != CICLO_VERSAO || cab.tam_bloco != sizeof(registro_bloco_t)){
+            fprintf(stderr, "%s: versao %u do arquivo nao suportada\n", argv[optind], cab.versao);
+            return 1;
+        }
+        fprintf(stderr, "ciclo %u (%s), periodo %u ms\n", cab.id, cab.tipo == CICLO_EXCITACAO ? "excitacao" : "perfil",
+                cab.periodo_ms);
+        if(!tabela){
+            tabela = &cab.tabela;
+        }
+    }
+    else{
+        rewind(f);
+    }
+    if(!tabela){
+        tabela = &perfil_tabela_padrao;
+    }
+
+    perfil_ideal_t ideal;
+    perfil_ideal_inicia(&ideal, tabela);
+    registro_bloco_t bloco;
+    int n = 0;
+    printf("t_s,segmento,ideal,real,saida,evento\n");
+    while(fread(&bloco, sizeof(bloco), 1, f) == 1){
+        registro_decodifica_bloco(&bloco, imprime, &ideal);
+        n++;
+    }
+    fclose(f);
+    fprintf(stderr, "%d blocos\n", n);
+    return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file registro_exporta.c
+ * @brief Le o log do ultimo ciclo do ESP32 pela UART da telemetria, em binario, e grava no formato de
+ * reflow_host -w (ver registro_decodifica).
+ *
+ * registro_exporta [-b baud] [-B rapido] [-a arquivo] [-r] /dev/ttyUSB0 log.bin
+ *   -b  velocidade atual da serial (padrao 115200, como TELEMETRIA_BAUD)
+ *   -B  velocidade usada na exportacao (padrao 921600; igual a -b para nao mudar)
+ *   -a  arquivo a exportar: 0 (padrao) e o log do ultimo ciclo na RAM; 1, 2... sao os ciclos guardados na flash,
+ *       do mais recente para o mais antigo, com o cabecalho de ciclo_arquivo.h
+ *   -r  continua uma exportacao interrompida a partir do tamanho de log.bin, se o ESP32 ainda tiver o mesmo
+ *       ciclo; se nao tiver, exporta de novo desde o inicio
+ *
+ * O ESP32 envia o arquivo em pedacos com deslocamento e CRC (telemetria.h). Um pedaco perdido ou com erro
+ * interrompe a sequencia; no fim da resposta o arquivo e pedido de novo a partir do primeiro byte que faltou.
+ * Todo pedaco traz o CRC do inicio do arquivo, que identifica o ciclo: se ele mudar no meio (um ciclo novo
+ * terminou) ou nao bater com o inicio de log.bin, o que ja foi gravado e descartado e a exportacao recomeca do 0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include "serial_host.h"
+
+#define ESPERA_MS 500                               //Silencio que encerra uma resposta
+#define TENTATIVAS 5                                //Pedidos seguidos sem progresso antes de desistir
+
+/*Pede a velocidade ao ESP32; so muda a serial do host se ele confirmar*/
+static bool negocia_baud(serial_t *s, uint32_t baud){
+    for(int t = 0; t < TENTATIVAS; t++){
+        telemetria_msg_t msg = { .tipo = TELEMETRIA_COMANDO };
+        msg.comando.cmd = TELEMETRIA_CMD_BAUD;
+        msg.comando.valor = baud;
+        serial_envia(s, &msg);
+        int r;
+        while((r = serial_recebe(s, &msg, ESPERA_MS)) > 0){
+            if(msg.tipo == TELEMETRIA_COMANDO && msg.comando.cmd == TELEMETRIA_CMD_BAUD){
+                if(msg.comando.valor != baud){
+                    fprintf(stderr, "o ESP32 ficou em %u baud\n", msg.comando.valor);
+                    return false;
+                }
+                return serial_baud(s, baud);
+            }
+        }
+        if(r < 0){
+            return false;
+        }
+    }
+    fprintf(stderr, "o ESP32 nao respondeu a mudanca de velocidade\n");
+    return false;
+}
+
+static double agora(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+    int baud = 115200, rapido = 921600;
+    int arquivo = 0;
+    bool continua = false;
+    int opt;
+    while((opt = getopt(argc, argv, "b:B:a:r")) != -1){
+        switch(opt){
+        case 'b': baud = atoi(optarg); break;
+        case 'B': rapido = atoi(optarg); break;
+        case 'a': arquivo = atoi(optarg); break;
+        case 'r': continua = true; break;
+        default:
+            fprintf(stderr, "uso: %s [-b baud] [-B rapido] [-a arquivo] [-r] dispositivo log.bin\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind + 2 > argc){
+        fprintf(stderr, "uso: %s [-b baud] [-B rapido] [-a arquivo] [-r] dispositivo log.bin\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = continua ? fopen(argv[optind + 1], "r+b") : NULL;
+    if(!f){
+        f = fopen(argv[optind + 1], "w+b");
+    }
+    if(!f){
+        perror(argv[optind + 1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    uint32_t prox = ftell(f);                       //Primeiro byte que falta
+    int32_t ciclo = -1;                             //CRC do inicio do arquivo exportado (-1 = ainda nao sabe)
+    if(prox < TELEMETRIA_PEDACO_MAX){
+        //sem o inicio inteiro nao da para conferir o ciclo; e pouco para exportar de novo
+        prox = 0;
+    }else{
+        uint8_t inicio_local[TELEMETRIA_PEDACO_MAX];
+        fseek(f, 0, SEEK_SET);
+        if(fread(inicio_local, 1, sizeof(inicio_local), f) == sizeof(inicio_local)){
+            ciclo = telemetria_crc16(inicio_local, sizeof(inicio_local));
+        }else{
+            prox = 0;
+        }
+    }
+
+    serial_t serial;
+    if(!serial_abre(&serial, argv[optind], baud, true)){
+        return 1;
+    }
+    double inicio = agora();
+    bool mudou = rapido != baud && negocia_baud(&serial, rapido);
+
+    int64_t total = -1;
+    int pedidos = 0, sem_progresso = 0;
+    while((total < 0 || prox < total) && sem_progresso < TENTATIVAS){
+        uint32_t antes = prox;
+        telemetria_msg_t msg = { .tipo = TELEMETRIA_COMANDO };
+        msg.comando.cmd = TELEMETRIA_CMD_EXPORTA;
+        msg.comando.arquivo = arquivo;
+        msg.comando.valor = prox;
+        serial_envia(&serial, &msg);
+        pedidos++;
+
+        int r;
+        while((r = serial_recebe(&serial, &msg, ESPERA_MS)) > 0){
+            if(msg.tipo != TELEMETRIA_PEDACO || msg.pedaco.arquivo != arquivo){
+                continue;
+            }
+            total = msg.pedaco.total;
+            if(total > 0 && ciclo >= 0 && msg.pedaco.ciclo != ciclo){
+                fprintf(stderr, "o ESP32 tem outro ciclo; exportando de novo\n");
+                prox = 0;
+            }
+            if(total > 0){
+                ciclo = msg.pedaco.ciclo;
+            }
+            if(msg.pedaco.n == 0){
+                break;
+            }
+            //so grava em sequencia; depois de um pedaco perdido espera o fim e pede de novo
+            if(msg.pedaco.deslocamento == prox){
+                fseek(f, prox, SEEK_SET);
+                fwrite(msg.pedaco.dados, 1, msg.pedaco.n, f);
+                prox += msg.pedaco.n;
+            }
+        }
+        if(r < 0){
+            break;
+        }
+        if(total == 0){
+            fprintf(stderr, "nada para exportar (o ciclo ainda nao terminou?)\n");
+            break;
+        }
+        if(total > 0 && prox > total){
+            //log.bin era de outro ciclo, maior que este
+            fprintf(stderr, "%s maior que o arquivo do ESP32; exportando de novo\n", argv[optind + 1]);
+            prox = 0;
+        }
+        sem_progresso = prox > antes ? 0 : sem_progresso + 1;
+    }
+    fflush(f);
+    if(total >= 0 && ftruncate(fileno(f), prox) != 0){
+        perror(argv[optind + 1]);
+    }
+    fclose(f);
+
+    if(mudou){
+        negocia_baud(&serial, baud);
+    }
+    serial_fecha(&serial);
+
+    bool completo = total > 0 && prox == total;
+    fprintf(stderr, "%u de %lld bytes em %.2f s, %d pedido(s), %u quadro(s) invalido(s)%s\n", prox, (long long)total,
+            agora() - inicio, pedidos, serial.invalidos, completo ? "" : ": incompleto (use -r para continuar)");
+    return completo ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+/**
+ * @file resposta_frequencia.c
+ * @brief Resposta em frequencia do forno a partir do log de um experimento de excitacao (excitacao.h).
+ *
+ * resposta_frequencia [-n pontos] [-c resposta.csv] log.bin
+ *   -n  amostras por segmento do metodo de Welch (padrao 256); segmentos maiores resolvem frequencias mais baixas,
+ *       com mais variancia
+ *   -c  grava a resposta em CSV: f_hz,ganho,ganho_db,fase_graus,coerencia (padrao: na saida padrao)
+ *
+ * O log e o do ciclo (reflow_host -E -w, ou registro_exporta -a 1 com o cabecalho de ciclo_arquivo.h). So as
+ * amostras da fase de sinal entram: a saida u e a temperatura lida y de cada uma. Em segmentos de n amostras com
+ * metade de sobreposicao, sem a tendencia linear (a deriva da temperatura de trabalho) e com janela de Hann:
+ *
+ *   H(f) = Syu(f) / Suu(f)                       graus por unidade de duty
+ *   coerencia(f) = |Syu(f)|^2 / (Suu(f) Syy(f))  perto de 1 onde a resposta e confiavel
+ *
+ * As frequencias em que u tem menos de 1/1000 da potencia maxima nao sao impressas. A saida gravada na amostra k e
+ * aplicada depois dela, entao a fase inclui o atraso de uma amostra e o da janela do rele, como o PID ve o forno.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "registro.h"
+#include "ciclo_arquivo.h"
+#include "excitacao.h"
+
+#define SEM_EXCITACAO 1e-3                          //Potencia de u, relativa ao maximo, abaixo da qual a frequencia e omitida
+
+typedef struct {
+    int n, cap;
+    double *t_s;
+    double *u;
+    double *y;
+} serie_t;
+
+static void acrescenta(void *arg, const registro_evento_t *ev){
+    serie_t *s = arg;
+    if(ev->tipo != REGISTRO_AMOSTRA || ev->modo != EXCITACAO_MODO + EXCITACAO_SINAL || isnan(ev->saida)){
+        return;
+    }
+    if(s->n == s->cap){
+        s->cap = s->cap ? 2 * s->cap : 1024;
+        s->t_s = realloc(s->t_s, s->cap * sizeof(double));
+        s->u = realloc(s->u, s->cap * sizeof(double));
+        s->y = realloc(s->y, s->cap * sizeof(double));
+    }
+    s->t_s[s->n] = ev->t_ms / 1000.0;
+    s->u[s->n] = ev->saida;
+    s->y[s->n] = ev->real;
+    s->n++;
+}
+
+/*Le os blocos do log, com ou sem o cabecalho de um ciclo da flash*/
+static bool le_log(const char *arquivo, serie_t *s){
+    FILE *f = fopen(arquivo, "rb");
+    if(!f){
+        perror(arquivo);
+        return false;
+    }
+    static ciclo_cabecalho_t cab;
+    if(fread(&cab, sizeof(cab), 1, f) != 1 || cab.magico != CICLO_MAGICO){
+        rewind(f);
+    }
+    else if(cab.versao != CICLO_VERSAO || cab.tam_bloco != sizeof(registro_bloco_t)){
+        fprintf(stderr, "%s: versao %u do arquivo nao suportada\n", arquivo, cab.versao);
+        fclose(f);
+        return false;
+    }
+    registro_bloco_t bloco;
+    while(fread(&bloco, sizeof(bloco), 1, f) == 1){
+        registro_decodifica_bloco(&bloco, acrescenta, s);
+    }
+    fclose(f);
+    return true;
+}
+
+/*Segmento sem a reta de minimos quadrados, com a janela de Hann. A reta sai de u e de y, para a deriva da
+ temperatura nao aparecer como resposta nas frequencias baixas*/
+static void prepara(const double *x, int n, double *saida){
+    double sk = 0, sx = 0, skx = 0, skk = 0;
+    for(int k = 0; k < n; k++){
+        sk += k;
+        sx += x[k];
+        skx += k * x[k];
+        skk += (double)k * k;
+    }
+    double b = (n * skx - sk * sx) / (n * skk - sk * sk);
+    double a = (sx - b * sk) / n;
+    for(int k = 0; k < n; k++){
+        saida[k] = (x[k] - a - b * k) * (0.5 - 0.5 * cos(2 * M_PI * k / n));
+    }
+}
+
+int main(int argc, char **argv){
+    int n = 256;
+    FILE *csv = stdout;
+    int opt;
+    while((opt = getopt(argc, argv, "n:c:")) != -1){
+        switch(opt){
+        case 'n': n = atoi(optarg); break;
+        case 'c':
+            csv = fopen(optarg, "w");
+            if(!csv){
+                perror(optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n pontos] [-c resposta.csv] log.bin\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc || n < 8){
+        fprintf(stderr, "uso: %s [-n pontos] [-c resposta.csv] log.bin\n", argv[0]);
+        return 1;
+    }
+
+    serie_t s = { 0 };
+    if(!le_log(argv[optind], &s)){
+        return 1;
+    }
+    if(s.n < n){
+        fprintf(stderr, "%s: %d amostras da fase de sinal, menos que um segmento de %d\n", argv[optind], s.n, n);
+        return 1;
+    }
+    double ts = (s.t_s[s.n - 1] - s.t_s[0]) / (s.n - 1);
+    int falhas = 0;
+    for(int k = 1; k < s.n; k++){
+        falhas += fabs(s.t_s[k] - s.t_s[k - 1] - ts) > ts / 2;
+    }
+    if(falhas){
+        fprintf(stderr, "aviso: %d intervalos fora do periodo (amostras perdidas); a resposta supoe periodo fixo\n",
+                falhas);
+    }
+
+    //espectros medios dos segmentos, so ate a metade da frequencia de amostragem
+    int m = n / 2;
+    double *suu = calloc(m + 1, sizeof(double));
+    double *syy = calloc(m + 1, sizeof(double));
+    double *re = calloc(m + 1, sizeof(double));
+    double *im = calloc(m + 1, sizeof(double));
+    double *u = malloc(n * sizeof(double));
+    double *y = malloc(n * sizeof(double));
+    int segmentos = 0;
+    for(int inicio = 0; inicio + n <= s.n; inicio += n / 2, segmentos++){
+        prepara(&s.u[inicio], n, u);
+        prepara(&s.y[inicio], n, y);
+        for(int j = 1; j <= m; j++){
+            double ur = 0, ui = 0, yr = 0, yi = 0;
+            for(int k = 0; k < n; k++){
+                double c = cos(2 * M_PI * j * k / n), sn = -sin(2 * M_PI * j * k / n);
+                ur += u[k] * c;
+                ui += u[k] * sn;
+                yr += y[k] * c;
+                yi += y[k] * sn;
+            }
+            suu[j] += ur * ur + ui * ui;
+            syy[j] += yr * yr + yi * yi;
+            //Y conj(U)
+            re[j] += yr * ur + yi * ui;
+            im[j] += yi * ur - yr * ui;
+        }
+    }
+
+    fprintf(stderr, "%d amostras da fase de sinal, periodo %.3f s, %d segmentos de %d\n", s.n, ts, segmentos, n);
+    fprintf(csv, "f_hz,ganho,ganho_db,fase_graus,coerencia\n");
+    //frequencias que o sinal nao excita (acima do fim do chirp, nos zeros do espectro do PRBS) ficam de fora
+    double suu_max = 0;
+    for(int j = 1; j <= m; j++){
+        suu_max = fmax(suu_max, suu[j]);
+    }
+    double ganho_0 = 0, corte = 0;
+    for(int j = 1; j <= m; j++){
+        if(suu[j] < suu_max * SEM_EXCITACAO){
+            continue;
+        }
+        double ganho = hypot(re[j], im[j]) / suu[j];
+        double fase = atan2(im[j], re[j]) * 180 / M_PI;
+        double coerencia = syy[j] > 0 ? (re[j] * re[j] + im[j] * im[j]) / (suu[j] * syy[j]) : 0;
+        double f = j / (n * ts);
+        fprintf(csv, "%.5f,%.5g,%.2f,%.1f,%.3f\n", f, ganho, 20 * log10(ganho), fase, coerencia);
+        if(!ganho_0){
+            ganho_0 = ganho;
+        }
+        else if(!corte && ganho < ganho_0 / 2){
+            corte = f;
+        }
+    }
+    fprintf(stderr, "ganho em %.4f Hz: %.3g graus por unidade de duty", 1 / (n * ts), ganho_0);
+    if(corte){
+        fprintf(stderr, "; cai a metade (-6 dB) em %.4f Hz", corte);
+    }
+    fprintf(stderr, "\n");
+    if(csv != stdout){
+        fclose(csv);
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "serial_host.h"
+
+/**
+ * @brief Abre a serial em modo bruto na velocidade pedida. Arquivos e fifos sao lidos como estao
+ *
+ * @param s
+ * @param caminho
+ * @param baud
+ * @param escrita abre tambem para enviar comandos
+ * @return true se abriu
+ */
+bool serial_abre(serial_t *s, const char *caminho, int baud, bool escrita){
+    memset(s, 0, sizeof(*s));
+    s->fd = open(caminho, (escrita ? O_RDWR : O_RDONLY) | O_NOCTTY);
+    if(s->fd < 0){
+        perror(caminho);
+        return false;
+    }
+    s->tty = isatty(s->fd);
+    if(s->tty && !serial_baud(s, baud)){
+        close(s->fd);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Muda a velocidade da serial, depois de enviar o que estava pendente
+ *
+ * @param s
+ * @param baud
+ * @return true se mudou (ou se nao e uma serial)
+ */
+bool serial_baud(serial_t *s, int baud){
+    static const struct { int baud; speed_t v; } velocidades[] = {
+        { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 }, { 115200, B115200 },
+        { 230400, B230400 }, { 460800, B460800 }, { 921600, B921600 }, { 1000000, B1000000 },
+        { 1500000, B1500000 }, { 2000000, B2000000 },
+    };
+    if(!s->tty){
+        return true;
+    }
+    struct termios tio;
+    if(tcgetattr(s->fd, &tio) != 0){
+        perror("tcgetattr");
+        return false;
+    }
+    cfmakeraw(&tio);
+    for(size_t i = 0; i < sizeof(velocidades) / sizeof(velocidades[0]); i++){
+        if(velocidades[i].baud == baud){
+            cfsetispeed(&tio, velocidades[i].v);
+            cfsetospeed(&tio, velocidades[i].v);
+            tcdrain(s->fd);
+            if(tcsetattr(s->fd, TCSANOW, &tio) != 0){
+                perror("tcsetattr");
+                return false;
+            }
+            return true;
+        }
+    }
+    fprintf(stderr, "velocidade nao suportada: %d\n", baud);
+    return false;
+}
+
+/**
+ * @brief Envia uma mensagem em um quadro
+ *
+ * @param s
+ * @param msg
+ * @return true se enviou o quadro inteiro
+ */
+bool serial_envia(serial_t *s, telemetria_msg_t *msg){
+    uint8_t quadro[TELEMETRIA_MAX_QUADRO];
+    size_t n = telemetria_quadro(msg, quadro);
+    return write(s->fd, quadro, n) == (ssize_t)n;
+}
+
+/**
+ * @brief Espera o proximo quadro valido. Quadros invalidos sao contados e ignorados
+ *
+ * @param s
+ * @param msg
+ * @param espera_ms tempo maximo sem receber nada (-1 = sem limite)
+ * @return int 1 se recebeu, 0 se passou o tempo, -1 no fim do arquivo ou em erro de leitura
+ */
+int serial_recebe(serial_t *s, telemetria_msg_t *msg, int espera_ms){
+    while(1){
+        if(s->pos == s->lidos){
+            struct pollfd p = { .fd = s->fd, .events = POLLIN };
+            int r = poll(&p, 1, espera_ms);
+            if(r == 0){
+                return 0;
+            }
+            ssize_t lidos = r < 0 ? -1 : read(s->fd, s->buf, sizeof(s->buf));
+            if(lidos <= 0){
+                return -1;
+            }
+            if(s->bruto){
+                fwrite(s->buf, 1, lidos, s->bruto);
+                fflush(s->bruto);
+            }
+            s->pos = 0;
+            s->lidos = lidos;
+        }
+
+        uint8_t c = s->buf[s->pos++];
+        if(c != 0){
+            if(s->n < sizeof(s->quadro)){
+                s->quadro[s->n++] = c;
+            }
+            else{
+                s->descarta = true;
+            }
+            continue;
+        }
+        size_t n = s->n;
+        bool descarta = s->descarta;
+        s->n = 0;
+        s->descarta = false;
+        if(n == 0){
+            continue;
+        }
+        if(!descarta && telemetria_le_quadro(s->quadro, n, msg)){
+            return 1;
+        }
+        s->invalidos++;
+    }
+}
+
+void serial_fecha(serial_t *s){
+    close(s->fd);
+}
@@ -0,0 +1,29 @@
+#ifndef SERIAL_HOST_H
+#define SERIAL_HOST_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "telemetria.h"
+
+/**
+ * @brief Serial (ou arquivo/fifo) com os quadros da telemetria, lida quadro a quadro
+ */
+typedef struct {
+    int fd;
+    bool tty;                                       //So a serial tem velocidade
+    uint8_t quadro[TELEMETRIA_MAX_QUADRO];          //Quadro sendo recebido
+    size_t n;
+    bool descarta;                                  //Quadro maior que o maximo: ignora ate o proximo delimitador
+    uint8_t buf[256];                               //Bytes lidos e ainda nao processados
+    size_t pos, lidos;
+    FILE *bruto;                                    //Copia dos bytes recebidos (pode ser NULL)
+    unsigned invalidos;                             //Quadros com erro de COBS, CRC ou tamanho
+} serial_t;
+
+bool serial_abre(serial_t *s, const char *caminho, int baud, bool escrita);
+bool serial_baud(serial_t *s, int baud);
+bool serial_envia(serial_t *s, telemetria_msg_t *msg);
+int serial_recebe(serial_t *s, telemetria_msg_t *msg, int espera_ms);
+void serial_fecha(serial_t *s);
+
+#endif
@@ -0,0 +1,145 @@
+#include <stddef.h>
+#include "simulacao.h"
+#include "perfis_solda.h"
+#include "telemetria.h"
+#include "tempo.h"
+
+/**
+ * @brief Prepara o forno, a HAL, o PID e o perfil para um ciclo
+ *
+ * @param sim
+ * @param param parametros do forno
+ * @param tabela segmentos do perfil (NULL = perfil_tabela_padrao)
+ * @param kp
+ * @param ki
+ * @param kd
+ */
+void simulacao_inicia(simulacao_t *sim, const planta_forno_param_t *param, const perfil_tabela_t *tabela,
+                      float kp, float ki, float kd){
+    planta_t planta;
+
+    planta_forno_inicia(&sim->forno, param);
+    planta_forno_planta(&sim->forno, &planta);
+    hal_host_inicia(&sim->host, &planta, &sim->hal);
+    pid_inicia(&sim->pid, kp, ki, kd, HAL_HOST_CONVERSAO_MS / 1000.0f);
+    registro_inicia(&sim->registro, HAL_HOST_CONVERSAO_MS);
+    perfil_inicia(&sim->perfil, tabela ? tabela : &perfil_tabela_padrao, &sim->registro);
+    filtro_inicia(&sim->filtro, HAL_HOST_CONVERSAO_MS / 1000.0f);
+
+    sim->reflow.hal = &sim->hal;
+    sim->reflow.pid = &sim->pid;
+    sim->reflow.perfil = &sim->perfil;
+    sim->reflow.filtro = &sim->filtro;
+    sim->reflow.latencia = NULL;
+    sim->reflow.adaptativo = NULL;
+    sim->reflow.escalonamento = NULL;
+    sim->reflow.estagio_cb = NULL;
+    sim->reflow.arg = NULL;
+    sim->reflow.t_ultima_us = 0;
+    sim->telemetria = NULL;
+    sim->telemetria_seq = 0;
+}
+
+/*Grava o quadro de uma mensagem, numerada como em telemetria_uart_envia*/
+static void envia(simulacao_t *sim, telemetria_msg_t *msg){
+    uint8_t quadro[TELEMETRIA_MAX_QUADRO];
+    msg->seq = sim->telemetria_seq++;
+    fwrite(quadro, 1, telemetria_quadro(msg, quadro), sim->telemetria);
+}
+
+static void envia_estagio(simulacao_t *sim, uint8_t tipo){
+    telemetria_msg_t msg = { .tipo = tipo };
+    msg.estagio.t_us = tempo_us();
+    msg.estagio.modo = sim->perfil.modo_operacao;
+    msg.estagio.setpoint = sim->perfil.trajetoria.inicio;
+    envia(sim, &msg);
+}
+
+static void envia_amostra(simulacao_t *sim, float temp){
+    telemetria_msg_t msg = { .tipo = TELEMETRIA_AMOSTRA };
+    msg.amostra.seq = sim->perfil.t_atual - 1;
+    msg.amostra.t_us = tempo_us();
+    msg.amostra.temp = temp;
+    msg.amostra.filtrada = sim->reflow.filtrada;
+    msg.amostra.setpoint = sim->perfil.setpoint;
+    msg.amostra.P = sim->pid.P;
+    msg.amostra.I = sim->pid.I;
+    msg.amostra.D = sim->pid.D;
+    msg.amostra.saida = sim->reflow.saida;
+    msg.amostra.modo = sim->perfil.modo_operacao;
+    msg.amostra.sat = sim->pid.sat;
+    envia(sim, &msg);
+}
+
+/**
+ * @brief Executa o perfil completo acumulando as metricas de cada amostra
+ *
+ * @param sim
+ * @param m metricas (pode ser NULL)
+ * @return true se o perfil terminou antes de SIM_MAX_S
+ */
+bool simulacao_executa(simulacao_t *sim, metricas_t *m){
+    if(m){
+        metricas_inicia(m, sim->perfil.tabela);
+    }
+    int64_t inicio = tempo_us();
+    int64_t t_ant = inicio;
+    while(!sim->perfil.terminado && tempo_decorrido_us(inicio) < (int64_t)SIM_MAX_S * 1000000){
+        int modo_anterior = sim->perfil.modo_operacao;
+        float temp = reflow_passo(&sim->reflow);
+        if(sim->telemetria){
+            //Mesma ordem do ESP32: segmento (verifica_tempo), depois a iteracao (control_pwm)
+            if(sim->perfil.modo_operacao != modo_anterior || sim->perfil.t_atual == 1){
+                envia_estagio(sim, TELEMETRIA_ESTAGIO);
+            }
+            envia_amostra(sim, temp);
+        }
+        int64_t t = tempo_us();
+        if(m){
+            metricas_amostra(m, t / 1e6, (t - t_ant) / 1e6, sim->perfil.modo_operacao, sim->perfil.setpoint, temp);
+        }
+        t_ant = t;
+    }
+    sim->hal.altera_duty(sim->hal.ctx, 0);
+    if(sim->telemetria && sim->perfil.terminado){
+        envia_estagio(sim, TELEMETRIA_FIM);
+    }
+    if(m){
+        metricas_fim(m, sim->perfil.terminado);
+    }
+    return sim->perfil.terminado;
+}
+
+/**
+ * @brief Perfil pelo nome ou de um arquivo, como na opcao -p das ferramentas do host
+ *
+ * @param tabela recebe o perfil
+ * @param nome padrao, sac305, sn63pb37, snbi (perfis_solda.h) ou um arquivo com a tabela em texto (ver
+ * perfil_tabela_le)
+ * @return true se leu; se nao, o erro ja foi impresso
+ */
+bool simulacao_perfil(perfil_tabela_t *tabela, const char *nome){
+    if(perfis_solda_busca(nome)){
+        *tabela = *perfis_solda_busca(nome);
+        return true;
+    }
+
+    static char texto[4096];
+    FILE *f = fopen(nome, "r");
+    if(!f){
+        perror(nome);
+        return false;
+    }
+    size_t n = fread(texto, 1, sizeof(texto) - 1, f);
+    fclose(f);
+    texto[n] = '\0';
+
+    int erro = perfil_tabela_le(tabela, texto);
+    if(erro > 0){
+        fprintf(stderr, "%s:%d: segmento invalido\n", nome, erro);
+    }
+    else if(erro < 0){
+        fprintf(stderr, "%s: o perfil nao termina (ver perfil_tabela_valida)\n", nome);
+    }
+    return erro == 0;
+}
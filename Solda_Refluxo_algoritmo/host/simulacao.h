@@ -0,0 +1,37 @@
+#ifndef SIMULACAO_H
+#define SIMULACAO_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "hal_host.h"
+#include "planta_forno.h"
+#include "reflow.h"
+#include "metricas.h"
+
+#define SIM_MAX_S 15000                             //Limite de tempo simulado para estagios que nao atingem a temperatura
+
+/**
+ * @brief Um ciclo de refluxo completo sobre o forno simulado. Cada simulacao e independente,
+ * entao varias podem rodar em paralelo.
+ */
+typedef struct {
+    planta_forno_t forno;
+    hal_host_t host;
+    reflow_hal_t hal;
+    pid_ctrl_t pid;
+    perfil_t perfil;
+    filtro_t filtro;
+    reflow_t reflow;
+    adaptativo_t adaptativo;                        //Usado se reflow.adaptativo apontar para ele
+    escalonamento_t escalonamento;                  //Usado se reflow.escalonamento ou adaptativo.escalonamento apontar para ele
+    registro_t registro;                            //Mesmo log do firmware
+    FILE *telemetria;                               //Quadros de telemetria como os da UART do ESP32 (pode ser NULL)
+    uint16_t telemetria_seq;
+} simulacao_t;
+
+void simulacao_inicia(simulacao_t *sim, const planta_forno_param_t *param, const perfil_tabela_t *tabela,
+                      float kp, float ki, float kd);
+bool simulacao_executa(simulacao_t *sim, metricas_t *m);
+bool simulacao_perfil(perfil_tabela_t *tabela, const char *nome);
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @file telemetria_captura.c
+ * @brief Captura a telemetria do ciclo (telemetria.h) da serial do ESP32 e grava em CSV, quadro a quadro.
+ *
+ * telemetria_captura [-b baud] [-o bruto.bin] [-c] /dev/ttyUSB0 > ciclo.csv
+ *   -b  velocidade da serial (padrao 115200, como TELEMETRIA_BAUD)
+ *   -o  grava tambem os bytes recebidos, sem decodificar, para ler de novo depois
+ *   -c  continua depois do fim do perfil (varios ciclos no mesmo arquivo)
+ *
+ * Tambem le um arquivo ou fifo gravado por reflow_host -T. Cada linha do CSV e gravada assim que o quadro chega,
+ * entao um reset do ESP32 no meio do ciclo so perde o quadro incompleto. Quadros com erro de CRC e saltos no
+ * numero de sequencia (mensagens perdidas) sao contados na saida de erro.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "serial_host.h"
+
+static void imprime(const telemetria_msg_t *msg){
+    if(msg->tipo == TELEMETRIA_AMOSTRA){
+        const telemetria_amostra_t *a = &msg->amostra;
+        printf("amostra,%u,%u,%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.1f,%u,%u\n", msg->seq, a->seq, a->t_us / 1e6,
+               a->temp, a->filtrada, a->setpoint, a->P, a->I, a->D, a->saida, a->modo, a->sat);
+    }
+    else{
+        const telemetria_estagio_t *e = &msg->estagio;
+        printf("%s,%u,,%.3f,,,%.2f,,,,,%u,\n", msg->tipo == TELEMETRIA_FIM ? "fim" : "estagio", msg->seq,
+               e->t_us / 1e6, e->setpoint, e->modo);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv){
+    int baud = 115200;
+    bool continuo = false;
+    FILE *bruto = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "b:o:c")) != -1){
+        switch(opt){
+        case 'b': baud = atoi(optarg); break;
+        case 'o':
+            bruto = fopen(optarg, "wb");
+            if(!bruto){
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'c': continuo = true; break;
+        default:
+            fprintf(stderr, "uso: %s [-b baud] [-o bruto.bin] [-c] dispositivo\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc){
+        fprintf(stderr, "uso: %s [-b baud] [-o bruto.bin] [-c] dispositivo\n", argv[0]);
+        return 1;
+    }
+
+    serial_t serial;
+    if(!serial_abre(&serial, argv[optind], baud, false)){
+        return 1;
+    }
+    serial.bruto = bruto;
+
+    bool primeiro = true;
+    uint16_t seq_esperado = 0;
+    unsigned quadros = 0, perdidas = 0, ciclos = 0;
+    bool fim = false;
+    telemetria_msg_t msg;
+
+    printf("tipo,seq,amostra,t_s,temp,filtrada,setpoint,P,I,D,saida,segmento,sat\n");
+    while(!fim && serial_recebe(&serial, &msg, -1) > 0){
+        //respostas da exportacao usam a mesma numeracao, mas nao sao telemetria do ciclo
+        if(msg.tipo == TELEMETRIA_COMANDO || msg.tipo == TELEMETRIA_PEDACO){
+            seq_esperado = msg.seq + 1;
+            continue;
+        }
+        if(!primeiro && msg.seq == 0){
+            fprintf(stderr, "seq reiniciado: o ESP32 reiniciou\n");
+        }
+        else if(!primeiro && msg.seq != seq_esperado){
+            perdidas += (uint16_t)(msg.seq - seq_esperado);
+            fprintf(stderr, "seq %u: %u mensagens perdidas\n", msg.seq, (uint16_t)(msg.seq - seq_esperado));
+        }
+        seq_esperado = msg.seq + 1;
+        quadros++;
+        imprime(&msg);
+        ciclos += msg.tipo == TELEMETRIA_FIM;
+        fim = msg.tipo == TELEMETRIA_FIM && !continuo;
+        //depois do fim, o proximo ciclo recomeca a sequencia
+        primeiro = msg.tipo == TELEMETRIA_FIM;
+    }
+
+    serial_fecha(&serial);
+    if(bruto){
+        fclose(bruto);
+    }
+    //o primeiro quadro invalido pode so ter comecado antes da captura
+    fprintf(stderr, "%u quadros, %u invalidos, %u mensagens perdidas, %u ciclo(s) completo(s)\n", quadros,
+            serial.invalidos, perdidas, ciclos);
+    return 0;
+}
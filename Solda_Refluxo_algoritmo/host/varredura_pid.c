@@ -0,0 +1,476 @@
+/**
+ * @file varredura_pid.c
+ * @brief Varre uma grade de ganhos kp/ki/kd sobre o perfil completo simulado, usando todos os nucleos,
+ * e ordena os pontos pelo desempenho.
+ *
+ * varredura_pid [-k ini:fim:n] [-i ini:fim:n] [-d ini:fim:n] [-j threads] [-t top] [-o criterio] [-c arquivo.csv] [-r ruido]
+ *               [-m modelo.txt] [-p perfil] [-s ganhos.txt] [-g kp,ki,kd] [-f largura]
+ *   -k/-i/-d  faixa de kp, ki e kd (n pontos igualmente espacados)
+ *   -j        numero de threads (padrao: todos os nucleos)
+ *   -t        quantos pontos imprimir (padrao 10)
+ *   -o        criterio de ordenacao: custo (padrao), sobressinal, acomodacao ou iae
+ *   -c        grava todos os pontos em CSV
+ *   -r        desvio padrao do ruido do termopar
+ *   -m        parametros do forno em texto, como os ajustados por identifica (padrao: planta_forno_param_padrao)
+ *   -p        perfil simulado: padrao, sac305, sn63pb37, snbi ou um arquivo, como em reflow_host -p
+ *   -s        monta e grava a tabela de escalonamento (escalonamento.h), para reflow_host -s ou a NVS do ESP32
+ *   -g        ganhos fora das faixas da tabela, os mesmos de reflow_host -g (padrao 3,24,4)
+ *   -f        largura maxima de uma faixa de temperatura em graus (padrao 50)
+ *
+ * custo = IAE/100 + 10 * (sobressinal na imersao + sobressinal no pico) + acomodacao/10, com os sobressinais
+ * negativos contados como zero e os alvos tirados do perfil (metricas.h: 150 e 240 graus no padrao). Pontos cujo
+ * perfil nao termina ficam no fim da lista.
+ *
+ * Com -s, cada estagio com setpoint ganha faixas de temperatura que cobrem o caminho do setpoint (do alvo do estagio
+ * anterior, ou da temperatura ambiente, ate o alvo) com ESCALONAMENTO_MARGEM_C de folga, divididas em partes de no
+ * maximo -f graus. As faixas sao sintonizadas em ordem: cada uma varre a grade com as faixas anteriores ja nos
+ * ganhos escolhidos e as seguintes nos ganhos de -g, e fica com o ponto de menor custo do ciclo (ou com os ganhos de
+ * -g, se nenhum ponto for melhor). Como a faixa so vale no seu estagio, os anteriores nao mudam e o custo nunca sobe
+ * de uma faixa para a seguinte. Se o ponto escolhido cair na borda da grade, a grade dobra de largura em volta dele
+ * (sem passar de 0 e GANHO_MAX) e e varrida de novo; depois e aproximada REFINAMENTOS vezes. A tabela pronta e
+ * validada com uma simulacao, a mesma de reflow_host -s, e o resultado vai para o comentario do arquivo. O
+ * resfriamento, com o rele desligado, fica de fora.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "simulacao.h"
+
+#define ESCALONAMENTO_MARGEM_C 15.0f                //Folga das faixas alem do caminho do setpoint
+#define MAX_ALARGAMENTOS 8                          //Alargamentos da grade por faixa antes de desistir
+#define GANHO_MAX 128.0f                            //Maior ganho que cabe no nucleo Q8.24 (pid_nucleo.h)
+#define CUSTO_TOLERANCIA 0.1f                       //Melhora minima do custo para trocar de ponto
+#define REFINAMENTOS 2                              //Aproximacoes da grade em volta do ponto escolhido
+
+typedef struct {
+    float ini, fim;
+    int n;
+} faixa_t;
+
+typedef struct {
+    float kp, ki, kd;
+    metricas_t m;
+    float custo;
+} ponto_t;
+
+typedef enum {
+    CRITERIO_CUSTO,
+    CRITERIO_SOBRESSINAL,
+    CRITERIO_ACOMODACAO,
+    CRITERIO_IAE,
+} criterio_t;
+
+static struct {
+    faixa_t kp, ki, kd;
+    planta_forno_param_t param;
+    perfil_tabela_t perfil;
+    const char *nome_perfil;
+    ponto_t *pontos;
+    int n_pontos;
+    atomic_int proximo;
+    int threads;
+    criterio_t criterio;
+    float padrao[3];                                //Ganhos fora das faixas do escalonamento
+    const escalonamento_tabela_t *tabela;           //Faixas ja escolhidas (NULL = sem escalonamento)
+    int faixa;                                      //Faixa da tabela com os ganhos do ponto (-1 = ganhos do PID)
+} varredura;
+
+static int le_faixa(const char *s, faixa_t *f){
+    if(sscanf(s, "%f:%f:%d", &f->ini, &f->fim, &f->n) != 3 || f->n < 1){
+        fprintf(stderr, "faixa invalida: %s (use ini:fim:n)\n", s);
+        return -1;
+    }
+    return 0;
+}
+
+static float valor(const faixa_t *f, int i){
+    return f->n == 1 ? f->ini : f->ini + (f->fim - f->ini) * i / (f->n - 1);
+}
+
+static float chave(const ponto_t *p){
+    if(!p->m.terminado){
+        return INFINITY;
+    }
+    switch(varredura.criterio){
+    case CRITERIO_SOBRESSINAL:
+        return fmaxf(metricas_sobressinal_imersao(&p->m), 0) + fmaxf(metricas_sobressinal_pico(&p->m), 0);
+    case CRITERIO_ACOMODACAO:
+        return metricas_acomodacao_total(&p->m);
+    case CRITERIO_IAE:
+        return metricas_iae_total(&p->m);
+    default:
+        return p->custo;
+    }
+}
+
+static int compara(const void *a, const void *b){
+    float ka = chave(a), kb = chave(b);
+    return (ka > kb) - (ka < kb);
+}
+
+/*Simula o perfil com os ganhos do ponto: no PID ou, com varredura.faixa >= 0, nessa faixa da tabela*/
+static void simula(simulacao_t *sim, ponto_t *p){
+    escalonamento_tabela_t tabela;
+    if(varredura.tabela){
+        tabela = *varredura.tabela;
+        simulacao_inicia(sim, &varredura.param, &varredura.perfil, varredura.padrao[0], varredura.padrao[1], varredura.padrao[2]);
+        if(varredura.faixa >= 0){
+            tabela.faixas[varredura.faixa].kp = p->kp;
+            tabela.faixas[varredura.faixa].ki = p->ki;
+            tabela.faixas[varredura.faixa].kd = p->kd;
+        }
+        escalonamento_inicia(&sim->escalonamento, &tabela, varredura.padrao[0], varredura.padrao[1],
+                             varredura.padrao[2]);
+        sim->reflow.escalonamento = &sim->escalonamento;
+    }else{
+        simulacao_inicia(sim, &varredura.param, &varredura.perfil, p->kp, p->ki, p->kd);
+    }
+    simulacao_executa(sim, &p->m);
+    p->custo = metricas_iae_total(&p->m) / 100
+             + 10 * (fmaxf(metricas_sobressinal_imersao(&p->m), 0) + fmaxf(metricas_sobressinal_pico(&p->m), 0))
+             + metricas_acomodacao_total(&p->m) / 10;
+}
+
+/*Cada thread pega o proximo ponto livre da grade ate acabar*/
+static void *trabalhador(void *arg){
+    simulacao_t *sim = malloc(sizeof(*sim));
+    int i;
+    while((i = atomic_fetch_add(&varredura.proximo, 1)) < varredura.n_pontos){
+        simula(sim, &varredura.pontos[i]);
+    }
+    free(sim);
+    return NULL;
+}
+
+/*Monta a grade de varredura.kp/ki/kd em varredura.pontos e simula todos os pontos em varredura.threads threads*/
+static void varre(void){
+    varredura.n_pontos = varredura.kp.n * varredura.ki.n * varredura.kd.n;
+    free(varredura.pontos);
+    varredura.pontos = calloc(varredura.n_pontos, sizeof(ponto_t));
+    int n = 0;
+    for(int a = 0; a < varredura.kp.n; a++){
+        for(int b = 0; b < varredura.ki.n; b++){
+            for(int c = 0; c < varredura.kd.n; c++){
+                varredura.pontos[n].kp = valor(&varredura.kp, a);
+                varredura.pontos[n].ki = valor(&varredura.ki, b);
+                varredura.pontos[n].kd = valor(&varredura.kd, c);
+                n++;
+            }
+        }
+    }
+
+    atomic_store(&varredura.proximo, 0);
+    pthread_t *t = malloc(varredura.threads * sizeof(pthread_t));
+    for(int i = 0; i < varredura.threads; i++){
+        pthread_create(&t[i], NULL, trabalhador, NULL);
+    }
+    for(int i = 0; i < varredura.threads; i++){
+        pthread_join(t[i], NULL);
+    }
+    free(t);
+}
+
+static void grava_csv(const char *arquivo){
+    FILE *f = fopen(arquivo, "w");
+    if(!f){
+        perror(arquivo);
+        return;
+    }
+    const perfil_tabela_t *perfil = &varredura.perfil;
+    fprintf(f, "kp,ki,kd,terminado,custo,sobressinal_imersao,sobressinal_pico,acomodacao_s,iae");
+    for(int e = 0; e < perfil->n; e++){
+        if(perfil->segmentos[e].tipo != PERFIL_RESFRIA){
+            fprintf(f, ",acomodacao_%d,iae_%d", e, e);
+        }
+    }
+    fprintf(f, "\n");
+    for(int i = 0; i < varredura.n_pontos; i++){
+        const ponto_t *p = &varredura.pontos[i];
+        fprintf(f, "%g,%g,%g,%d,%g,%g,%g,%g,%g", p->kp, p->ki, p->kd, p->m.terminado, p->custo,
+                metricas_sobressinal_imersao(&p->m), metricas_sobressinal_pico(&p->m),
+                metricas_acomodacao_total(&p->m), metricas_iae_total(&p->m));
+        for(int e = 0; e < perfil->n; e++){
+            if(perfil->segmentos[e].tipo != PERFIL_RESFRIA){
+                fprintf(f, ",%g,%g", p->m.acomodacao_s[e], p->m.iae[e]);
+            }
+        }
+        fprintf(f, "\n");
+    }
+    fclose(f);
+}
+
+static float custo(const ponto_t *p){
+    return p->m.terminado ? p->custo : INFINITY;
+}
+
+/*Se o valor esta na borda da faixa (0 e GANHO_MAX sao limites de verdade, nao da grade)*/
+static bool na_borda(const faixa_t *f, float v){
+    return f->n > 1 && ((v == f->fim && f->fim < GANHO_MAX) || (v == f->ini && f->ini > 0));
+}
+
+/*Centra a faixa no valor com a largura multiplicada por fator, dentro de 0 a GANHO_MAX*/
+static void centra(faixa_t *f, float v, float fator){
+    float largura = fminf((f->fim - f->ini) * fator, GANHO_MAX);
+    f->ini = fminf(fmaxf(v - largura / 2, 0), GANHO_MAX - largura);
+    f->fim = f->ini + largura;
+}
+
+/*Faixas de temperatura de cada estagio com setpoint, nos ganhos padrao; retorna quantas*/
+static int monta_faixas(escalonamento_tabela_t *tabela, const perfil_tabela_t *perfil, float largura){
+    tabela->n = 0;
+    float inicio = varredura.param.ambiente_c;
+    for(int e = 0; e < perfil->n; e++){
+        const perfil_segmento_t *seg = &perfil->segmentos[e];
+        if(seg->tipo == PERFIL_RESFRIA){
+            continue;
+        }
+        float min = fminf(inicio, seg->alvo) - ESCALONAMENTO_MARGEM_C;
+        float max = fmaxf(inicio, seg->alvo) + ESCALONAMENTO_MARGEM_C;
+        int partes = (int)ceilf((max - min) / largura);
+        for(int i = 0; i < partes && tabela->n < ESCALONAMENTO_MAX_FAIXAS; i++){
+            escalonamento_faixa_t *f = &tabela->faixas[tabela->n++];
+            f->modo = e;
+            f->temp_min = min + (max - min) * i / partes;
+            f->temp_max = min + (max - min) * (i + 1) / partes;
+            f->kp = varredura.padrao[0];
+            f->ki = varredura.padrao[1];
+            f->kd = varredura.padrao[2];
+        }
+        inicio = seg->alvo;
+    }
+    return tabela->n;
+}
+
+/*Sintoniza as faixas em ordem, cada uma sobre as escolhas das anteriores, valida a tabela e grava*/
+static void grava_escalonamento(const char *arquivo, float largura, int argc, char **argv){
+    const perfil_tabela_t *perfil = &varredura.perfil;
+    static escalonamento_tabela_t tabela;
+    monta_faixas(&tabela, perfil, largura);
+    const faixa_t grade[3] = { varredura.kp, varredura.ki, varredura.kd };
+    float custo_faixa[ESCALONAMENTO_MAX_FAIXAS];
+    const char *nota[ESCALONAMENTO_MAX_FAIXAS];
+
+    varredura.tabela = &tabela;
+    for(int k = 0; k < tabela.n; k++){
+        escalonamento_faixa_t *f = &tabela.faixas[k];
+        varredura.kp = grade[0];
+        varredura.ki = grade[1];
+        varredura.kd = grade[2];
+
+        //referencia: a faixa nos ganhos padrao, como ficou depois das anteriores
+        ponto_t melhor = { .kp = f->kp, .ki = f->ki, .kd = f->kd };
+        simulacao_t *sim = malloc(sizeof(*sim));
+        varredura.faixa = -1;
+        simula(sim, &melhor);
+        free(sim);
+        const ponto_t padrao = melhor;
+
+        //alarga a grade enquanto o melhor ponto dela estiver na borda; depois aproxima em volta dele
+        int alargamentos = 0, refinamentos = 0;
+        varredura.faixa = k;
+        nota[k] = "";
+        for(;;){
+            varre();
+            const ponto_t *melhor_grade = &varredura.pontos[0];
+            for(int i = 1; i < varredura.n_pontos; i++){
+                if(custo(&varredura.pontos[i]) < custo(melhor_grade)){
+                    melhor_grade = &varredura.pontos[i];
+                }
+            }
+            //num plato o custo quase nao muda e o ponto andaria sem rumo; so troca por uma melhora de verdade
+            bool melhorou = custo(melhor_grade) < custo(&melhor) - CUSTO_TOLERANCIA;
+            if(melhorou){
+                melhor = *melhor_grade;
+            }
+            bool kp = melhorou && na_borda(&varredura.kp, melhor.kp);
+            bool ki = melhorou && na_borda(&varredura.ki, melhor.ki);
+            bool kd = melhorou && na_borda(&varredura.kd, melhor.kd);
+            float fator;
+            if(kp || ki || kd){
+                if(alargamentos++ == MAX_ALARGAMENTOS){
+                    nota[k] = " (na borda da grade)";
+                    fprintf(stderr, "faixa %d: o melhor ponto continua na borda da grade depois de %d alargamentos\n",
+                            k, MAX_ALARGAMENTOS);
+                    break;
+                }
+                fator = 2;
+            }else if(custo(&melhor) < custo(&padrao) && refinamentos++ < REFINAMENTOS){
+                fator = 0.5f;
+            }else{
+                break;
+            }
+            centra(&varredura.kp, melhor.kp, kp || !(ki || kd) ? fator : 1);
+            centra(&varredura.ki, melhor.ki, ki || !(kp || kd) ? fator : 1);
+            centra(&varredura.kd, melhor.kd, kd || !(kp || ki) ? fator : 1);
+        }
+        if(melhor.kp == padrao.kp && melhor.ki == padrao.ki && melhor.kd == padrao.kd){
+            nota[k] = " (nenhum ponto da grade melhora os ganhos padrao)";
+        }
+        f->kp = melhor.kp;
+        f->ki = melhor.ki;
+        f->kd = melhor.kd;
+        custo_faixa[k] = custo(&melhor);
+        printf("faixa %d (%s, %.1f a %.1f graus): kp %g ki %g kd %g, custo %.1f (com os ganhos padrao %.1f)\n", k,
+               perfil_nome_estagio(perfil, f->modo), f->temp_min, f->temp_max, f->kp, f->ki, f->kd, custo_faixa[k],
+               custo(&padrao));
+    }
+
+    //validacao: a tabela inteira, como em reflow_host -s
+    ponto_t final = { 0 }, sem = { 0 };
+    simulacao_t *sim = malloc(sizeof(*sim));
+    varredura.faixa = -1;
+    simula(sim, &final);
+    varredura.tabela = NULL;
+    sem.kp = varredura.padrao[0];
+    sem.ki = varredura.padrao[1];
+    sem.kd = varredura.padrao[2];
+    simula(sim, &sem);
+    free(sim);
+    printf("tabela validada: IAE %.0f, acomodacao %.1f s, custo %.1f (so os ganhos padrao: IAE %.0f, custo %.1f)\n",
+           metricas_iae_total(&final.m), metricas_acomodacao_total(&final.m), final.custo, metricas_iae_total(&sem.m),
+           sem.custo);
+
+    FILE *f = fopen(arquivo, "w");
+    if(!f){
+        perror(arquivo);
+        return;
+    }
+    //escalonamento_tabela_le nao aceita linhas de 96 caracteres ou mais
+    fprintf(f, "# Escalonamento dos ganhos do PID no perfil %s, gravado por\n# varredura_pid", varredura.nome_perfil);
+    int coluna = 15;
+    for(int i = 1; i < argc; i++){
+        if(coluna + 1 + strlen(argv[i]) > 80){
+            fprintf(f, "\n#  ");
+            coluna = 3;
+        }
+        coluna += fprintf(f, " %s", argv[i]);
+    }
+    fprintf(f, "\n# Faixas sintonizadas em ordem, cada uma sobre as anteriores (ver varredura_pid.c).\n");
+    fprintf(f, "# Validada com uma simulacao: IAE %.0f, acomodacao %.1f s, custo %.1f.\n",
+            metricas_iae_total(&final.m), metricas_acomodacao_total(&final.m), final.custo);
+    fprintf(f, "# So com os ganhos padrao %g,%g,%g: IAE %.0f, acomodacao %.1f s, custo %.1f.\n", varredura.padrao[0],
+            varredura.padrao[1], varredura.padrao[2], metricas_iae_total(&sem.m), metricas_acomodacao_total(&sem.m),
+            sem.custo);
+    if(!final.m.terminado){
+        fprintf(f, "# ATENCAO: o perfil nao terminou com a tabela\n");
+    }
+    fprintf(f, "# Carregado com reflow_host -s ou gravado na NVS (ver README).\n#\n");
+    fprintf(f, "# estagio  temp_min  temp_max  kp  ki  kd\n");
+    for(int k = 0; k < tabela.n; k++){
+        const escalonamento_faixa_t *fx = &tabela.faixas[k];
+        fprintf(f, "# %s: custo do ciclo %.1f%s\n%d %g %g %g %g %g\n", perfil_nome_estagio(perfil, fx->modo),
+                custo_faixa[k], nota[k], fx->modo, fx->temp_min, fx->temp_max, fx->kp,
+                fx->ki, fx->kd);
+    }
+    fclose(f);
+}
+
+int main(int argc, char **argv){
+    varredura.kp = (faixa_t){ 1, 10, 10 };
+    varredura.ki = (faixa_t){ 0, 40, 9 };
+    varredura.kd = (faixa_t){ 0, 10, 11 };
+    varredura.criterio = CRITERIO_CUSTO;
+    planta_forno_param_padrao(&varredura.param);
+    varredura.perfil = perfil_tabela_padrao;
+    varredura.nome_perfil = "padrao";
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int top = 10;
+    const char *csv = NULL;
+    const char *escalonamento = NULL;
+    float largura = 50;
+    varredura.padrao[0] = 3;
+    varredura.padrao[1] = 24;
+    varredura.padrao[2] = 4;
+
+    int opt;
+    while((opt = getopt(argc, argv, "k:i:d:j:t:o:c:r:m:p:s:g:f:")) != -1){
+        switch(opt){
+        case 'k': if(le_faixa(optarg, &varredura.kp)) return 1; break;
+        case 'i': if(le_faixa(optarg, &varredura.ki)) return 1; break;
+        case 'd': if(le_faixa(optarg, &varredura.kd)) return 1; break;
+        case 'j': threads = atoi(optarg); break;
+        case 't': top = atoi(optarg); break;
+        case 'c': csv = optarg; break;
+        case 's': escalonamento = optarg; break;
+        case 'f': largura = atof(optarg); break;
+        case 'g':
+            if(sscanf(optarg, "%f,%f,%f", &varredura.padrao[0], &varredura.padrao[1], &varredura.padrao[2]) != 3){
+                fprintf(stderr, "ganhos invalidos: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'r': varredura.param.ruido_c = atof(optarg); break;
+        case 'm':
+            if(!planta_forno_param_carrega(&varredura.param, optarg)){
+                return 1;
+            }
+            break;
+        case 'p':
+            if(!simulacao_perfil(&varredura.perfil, optarg)){
+                return 1;
+            }
+            varredura.nome_perfil = optarg;
+            break;
+        case 'o':
+            if(!strcmp(optarg, "custo")) varredura.criterio = CRITERIO_CUSTO;
+            else if(!strcmp(optarg, "sobressinal")) varredura.criterio = CRITERIO_SOBRESSINAL;
+            else if(!strcmp(optarg, "acomodacao")) varredura.criterio = CRITERIO_ACOMODACAO;
+            else if(!strcmp(optarg, "iae")) varredura.criterio = CRITERIO_IAE;
+            else {
+                fprintf(stderr, "criterio invalido: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-k ini:fim:n] [-i ini:fim:n] [-d ini:fim:n] [-j threads] [-t top] "
+                            "[-o custo|sobressinal|acomodacao|iae] [-c arquivo.csv] [-r ruido] [-m modelo.txt] [-p perfil] "
+                            "[-s ganhos.txt] [-g kp,ki,kd] [-f largura]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(threads < 1){
+        threads = 1;
+    }
+    if(largura <= 0){
+        fprintf(stderr, "largura invalida: %g\n", largura);
+        return 1;
+    }
+    varredura.threads = threads;
+    varredura.faixa = -1;
+
+    struct timespec inicio, fim;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    varre();
+    clock_gettime(CLOCK_MONOTONIC, &fim);
+    double s = (fim.tv_sec - inicio.tv_sec) + (fim.tv_nsec - inicio.tv_nsec) / 1e9;
+
+    if(csv){
+        grava_csv(csv);
+    }
+    qsort(varredura.pontos, varredura.n_pontos, sizeof(ponto_t), compara);
+
+    printf("%d pontos em %d threads: %.2f s\n\n", varredura.n_pontos, threads, s);
+    printf("%8s %8s %8s %10s %9s %9s %12s %10s\n", "kp", "ki", "kd", "custo", "sob imer", "sob pico", "acomodacao s", "IAE");
+    for(int i = 0; i < top && i < varredura.n_pontos; i++){
+        const ponto_t *p = &varredura.pontos[i];
+        if(!p->m.terminado){
+            printf("%8.3f %8.3f %8.3f   (perfil nao terminou)\n", p->kp, p->ki, p->kd);
+            continue;
+        }
+        printf("%8.3f %8.3f %8.3f %10.1f %9.1f %9.1f %12.1f %10.0f\n", p->kp, p->ki, p->kd, p->custo,
+               metricas_sobressinal_imersao(&p->m), metricas_sobressinal_pico(&p->m),
+               metricas_acomodacao_total(&p->m), metricas_iae_total(&p->m));
+    }
+    if(escalonamento){
+        printf("\n");
+        grava_escalonamento(escalonamento, largura, argc, argv);
+    }
+    free(varredura.pontos);
+    return 0;
+}
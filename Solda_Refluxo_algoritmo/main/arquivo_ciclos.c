@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_spiffs.h"
+#include "esp_log.h"
+#include "arquivo_ciclos.h"
+
+#define INDICE ARQUIVO_BASE "/indice"
+
+static const char *TAG = "ARQUIVO";
+
+static const registro_t *reg;
+static TaskHandle_t tarefa;
+static SemaphoreHandle_t trava;                     //Indice e arquivos, entre arquivo_task e arquivo_le
+static bool terminado;                              //Pedido de fim do ciclo (arquivo_fim)
+static uint8_t estado_fim;                          //Estado do ciclo pedido em arquivo_fim
+static bool aberto;                                 //Ha um ciclo sendo gravado
+static bool pedido_novo;                            //Pedido de um novo ciclo (arquivo_novo)
+static const perfil_tabela_t *tabela_novo;
+static uint16_t periodo_novo;
+static uint8_t tipo_novo, sinal_novo;
+static ciclo_indice_t atual;                        //Entrada do ciclo sendo gravado
+static FILE *f;                                     //Arquivo do ciclo sendo gravado
+static uint32_t prox_bloco;                         //Proximo bloco do log (desde o inicio) a gravar
+static uint32_t ultimo_id;
+static FILE *leitura;                               //Ultimo arquivo lido por arquivo_le
+static uint32_t id_leitura;
+
+static void nome_ciclo(uint32_t id, char *nome, size_t tam)
+{
+    snprintf(nome, tam, ARQUIVO_BASE "/c%u.bin", id);
+}
+
+static bool le_indice(uint32_t posicao, ciclo_indice_t *e)
+{
+    FILE *fi = fopen(INDICE, "rb");
+    bool ok = fi && fseek(fi, posicao * sizeof(*e), SEEK_SET) == 0 && fread(e, sizeof(*e), 1, fi) == 1;
+    if(fi){
+        fclose(fi);
+    }
+    return ok;
+}
+
+/*Regrava so a posicao da entrada*/
+static bool grava_indice(const ciclo_indice_t *e)
+{
+    FILE *fi = fopen(INDICE, "r+b");
+    bool ok = fi && fseek(fi, (e->id % CICLO_MAX_ARQUIVADOS) * sizeof(*e), SEEK_SET) == 0 &&
+              fwrite(e, sizeof(*e), 1, fi) == 1;
+    if(fi){
+        fclose(fi);
+    }
+    if(!ok){
+        ESP_LOGE(TAG, "Erro gravando o indice do ciclo %u", e->id);
+    }
+    return ok;
+}
+
+/*Cria o indice vazio na primeira vez; fecha os ciclos que um reset interrompeu e acha o ultimo id*/
+static bool recupera_indice(void)
+{
+    struct stat st;
+    if(stat(INDICE, &st) != 0 || st.st_size != CICLO_MAX_ARQUIVADOS * sizeof(ciclo_indice_t)){
+        ciclo_indice_t vazio[CICLO_MAX_ARQUIVADOS];
+        memset(vazio, 0, sizeof(vazio));
+        FILE *fi = fopen(INDICE, "wb");
+        bool ok = fi && fwrite(vazio, sizeof(vazio), 1, fi) == 1;
+        if(fi){
+            fclose(fi);
+        }
+        return ok;
+    }
+
+    for(uint32_t i = 0; i < CICLO_MAX_ARQUIVADOS; i++){
+        ciclo_indice_t e;
+        if(!le_indice(i, &e) || e.id == 0){
+            continue;
+        }
+        if(e.id > ultimo_id){
+            ultimo_id = e.id;
+        }
+        if(e.estado == CICLO_EM_ANDAMENTO){
+            //os blocos gravados ate o reset continuam no arquivo; um bloco pela metade e ignorado
+            char nome[32];
+            nome_ciclo(e.id, nome, sizeof(nome));
+            e.n_blocos = stat(nome, &st) == 0 && st.st_size > (off_t)sizeof(ciclo_cabecalho_t) ?
+                         (st.st_size - sizeof(ciclo_cabecalho_t)) / sizeof(registro_bloco_t) : 0;
+            e.estado = CICLO_INTERROMPIDO;
+            grava_indice(&e);
+            ESP_LOGW(TAG, "Ciclo %u interrompido com %u blocos", e.id, e.n_blocos);
+        }
+    }
+    return true;
+}
+
+/*Abre o arquivo do novo ciclo, apagando o mais antigo que estava na mesma posicao do indice*/
+static bool novo_ciclo(const perfil_tabela_t *tabela, uint16_t periodo_ms, uint8_t tipo, uint8_t sinal)
+{
+    char nome[32];
+    ciclo_indice_t antigo;
+    uint32_t id = ultimo_id + 1;
+    if(le_indice(id % CICLO_MAX_ARQUIVADOS, &antigo) && antigo.id){
+        nome_ciclo(antigo.id, nome, sizeof(nome));
+        remove(nome);
+    }
+
+    ciclo_cabecalho_t cab = {
+        .magico = CICLO_MAGICO,
+        .versao = CICLO_VERSAO,
+        .periodo_ms = periodo_ms,
+        .id = id,
+        .tam_bloco = sizeof(registro_bloco_t),
+        .tipo = tipo,
+        .sinal = sinal,
+        .tabela = *tabela,
+    };
+    nome_ciclo(id, nome, sizeof(nome));
+    f = fopen(nome, "wb");
+    if(!f || fwrite(&cab, sizeof(cab), 1, f) != 1 || fflush(f) != 0){
+        ESP_LOGE(TAG, "Erro criando %s", nome);
+        return false;
+    }
+
+    memset(&atual, 0, sizeof(atual));
+    atual.id = id;
+    atual.estado = CICLO_EM_ANDAMENTO;
+    ultimo_id = id;
+    return grava_indice(&atual);
+}
+
+/*Grava os blocos completos em lotes de ARQUIVO_LOTE_BLOCOS; no fim grava tambem o resto e o bloco atual*/
+static void grava_blocos(bool fim)
+{
+    uint32_t completos = fim ? registro_blocos_abertos(reg) : registro_blocos_completos(reg);
+    while(completos - prox_bloco >= ARQUIVO_LOTE_BLOCOS || (fim && prox_bloco < completos)){
+        registro_bloco_t lote[ARQUIVO_LOTE_BLOCOS];
+        size_t n = 0;
+        while(n < ARQUIVO_LOTE_BLOCOS && prox_bloco < completos){
+            //um bloco que saiu do anel antes de ser gravado fica de fora
+            if(registro_copia_bloco(reg, prox_bloco, &lote[n])){
+                n++;
+            }
+            else{
+                atual.perdidos++;
+            }
+            prox_bloco++;
+        }
+        xSemaphoreTake(trava, portMAX_DELAY);
+        size_t gravados = fwrite(lote, sizeof(lote[0]), n, f);
+        fflush(f);
+        xSemaphoreGive(trava);
+        atual.n_blocos += gravados;
+        if(gravados != n){
+            ESP_LOGE(TAG, "Erro gravando o ciclo %u (flash cheia?)", atual.id);
+        }
+    }
+}
+
+/**
+ * @brief Grava os blocos do log na flash. Acorda depois de cada iteracao do controle (arquivo_avisa), entao a
+ * escrita, que para o cache da flash, cai na folga ate a proxima amostra, e so escreve com um lote completo.
+ * Depois do fim de um ciclo a tarefa continua viva, sem ciclo aberto, esperando o proximo (arquivo_novo)
+ *
+ * @param pvParameters
+ */
+static void arquivo_task(void *pvParameters)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bool fim = __atomic_load_n(&terminado, __ATOMIC_ACQUIRE);
+        if(f){
+            grava_blocos(fim);
+        }
+        if(fim){
+            if(f){
+                xSemaphoreTake(trava, portMAX_DELAY);
+                fclose(f);
+                f = NULL;
+                atual.estado = estado_fim;
+                grava_indice(&atual);
+                xSemaphoreGive(trava);
+                ESP_LOGI(TAG, "Ciclo %u gravado (%s): %u blocos, %u perdidos", atual.id,
+                         atual.estado == CICLO_COMPLETO ? "completo" : "interrompido", atual.n_blocos, atual.perdidos);
+            }
+            __atomic_store_n(&terminado, false, __ATOMIC_RELAXED);
+            __atomic_store_n(&aberto, false, __ATOMIC_RELEASE);
+        }
+        if(!f && __atomic_load_n(&pedido_novo, __ATOMIC_ACQUIRE)){
+            xSemaphoreTake(trava, portMAX_DELAY);
+            bool ok = novo_ciclo(tabela_novo, periodo_novo, tipo_novo, sinal_novo);
+            xSemaphoreGive(trava);
+            prox_bloco = 0;
+            __atomic_store_n(&pedido_novo, false, __ATOMIC_RELAXED);
+            if(ok){
+                __atomic_store_n(&aberto, true, __ATOMIC_RELEASE);
+                ESP_LOGI(TAG, "Gravando o ciclo %u", atual.id);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Monta a particao, fecha os ciclos interrompidos, abre o arquivo do novo ciclo e cria a tarefa de gravacao
+ *
+ * @param prioridade prioridade da tarefa, abaixo das tarefas de controle
+ * @param registro log do ciclo
+ * @param tabela perfil do ciclo, gravado no cabecalho
+ * @param periodo_ms periodo das amostras
+ * @return esp_err_t
+ */
+esp_err_t arquivo_inicia(UBaseType_t prioridade, const registro_t *registro, const perfil_tabela_t *tabela,
+                         uint16_t periodo_ms)
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = ARQUIVO_BASE,
+        .partition_label = ARQUIVO_PARTICAO,
+        .max_files = 4,
+        .format_if_mount_failed = true,
+    };
+    esp_err_t ret = esp_vfs_spiffs_register(&conf);
+    if(ret != ESP_OK){
+        ESP_LOGE(TAG, "SPIFFS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    reg = registro;
+    trava = xSemaphoreCreateMutex();
+    if(!trava || !recupera_indice() || !novo_ciclo(tabela, periodo_ms, CICLO_PERFIL, 0)){
+        return ESP_FAIL;
+    }
+    aberto = true;
+    if(xTaskCreate(arquivo_task, "arquivo_task", configMINIMAL_STACK_SIZE * 4, NULL, prioridade, &tarefa) != pdPASS){
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Gravando o ciclo %u", atual.id);
+    return ESP_OK;
+}
+
+/**
+ * @brief Chamada depois de cada iteracao do controle; so acorda a tarefa de gravacao
+ */
+void arquivo_avisa(void)
+{
+    if(tarefa){
+        xTaskNotifyGive(tarefa);
+    }
+}
+
+/**
+ * @brief Fim do perfil (ou da excitacao): grava o resto do log e fecha o ciclo com o estado dado. O log nao deve
+ * ser reiniciado antes de arquivo_fechado
+ *
+ * @param estado CICLO_COMPLETO, ou CICLO_INTERROMPIDO se o ciclo parou antes do fim (um experimento pedido no meio
+ * do perfil, uma excitacao fora da banda)
+ */
+void arquivo_fim(uint8_t estado)
+{
+    estado_fim = estado;
+    __atomic_store_n(&terminado, true, __ATOMIC_RELEASE);
+    arquivo_avisa();
+}
+
+/**
+ * @brief Indica se o ultimo ciclo ja foi fechado (ou se o arquivo esta desligado): a partir dai o log pode ser
+ * reiniciado para o proximo ciclo
+ *
+ * @return true sem ciclo aberto
+ */
+bool arquivo_fechado(void)
+{
+    return !tarefa || !__atomic_load_n(&aberto, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Abre um novo ciclo, gravado a partir do primeiro bloco do log. Deve ser chamada depois de arquivo_fechado,
+ * com o log ja reiniciado (registro_inicia); a tarefa de gravacao abre o arquivo no proximo aviso
+ *
+ * @param tabela perfil gravado no cabecalho
+ * @param periodo_ms periodo das amostras
+ * @param tipo CICLO_PERFIL ou CICLO_EXCITACAO
+ * @param sinal sinal da excitacao
+ */
+void arquivo_novo(const perfil_tabela_t *tabela, uint16_t periodo_ms, uint8_t tipo, uint8_t sinal)
+{
+    if(!tarefa){
+        return;
+    }
+    tabela_novo = tabela;
+    periodo_novo = periodo_ms;
+    tipo_novo = tipo;
+    sinal_novo = sinal;
+    __atomic_store_n(&aberto, true, __ATOMIC_RELAXED);
+    __atomic_store_n(&pedido_novo, true, __ATOMIC_RELEASE);
+    arquivo_avisa();
+}
+
+/**
+ * @brief Le um ciclo guardado para exportar, com o cabecalho (ver ciclo_arquivo.h)
+ *
+ * @param k 1 para o ciclo mais recente (o atual, enquanto roda), 2 para o anterior...
+ * @param deslocamento
+ * @param dados
+ * @param max
+ * @param total tamanho do arquivo (0 se o ciclo nao existe mais)
+ * @return uint32_t bytes copiados
+ */
+uint32_t arquivo_le(uint8_t k, uint32_t deslocamento, uint8_t *dados, uint32_t max, uint32_t *total)
+{
+    *total = 0;
+    if(!trava || k == 0 || k > ultimo_id){
+        return 0;
+    }
+    uint32_t id = ultimo_id - (k - 1);
+    ciclo_indice_t e;
+    uint32_t n = 0;
+    xSemaphoreTake(trava, portMAX_DELAY);
+    if(le_indice(id % CICLO_MAX_ARQUIVADOS, &e) && e.id == id){
+        if(!leitura || id_leitura != id){
+            char nome[32];
+            nome_ciclo(id, nome, sizeof(nome));
+            if(leitura){
+                fclose(leitura);
+            }
+            leitura = fopen(nome, "rb");
+            id_leitura = id;
+        }
+        if(leitura && fseek(leitura, 0, SEEK_END) == 0){
+            *total = ftell(leitura);
+            if(deslocamento < *total && fseek(leitura, deslocamento, SEEK_SET) == 0){
+                n = fread(dados, 1, max, leitura);
+            }
+        }
+    }
+    xSemaphoreGive(trava);
+    return n;
+}
+
+/**
+ * @brief Printa os ciclos guardados, do mais recente para o mais antigo
+ */
+void arquivo_lista(void)
+{
+    static const char *estados[] = { "vazio", "em andamento", "completo", "interrompido" };
+    size_t usado = 0, tam = 0;
+    esp_spiffs_info(ARQUIVO_PARTICAO, &tam, &usado);
+    printf("ciclos guardados (%u de %u bytes usados)\n", (unsigned)usado, (unsigned)tam);
+    if(!trava){
+        return;
+    }
+    xSemaphoreTake(trava, portMAX_DELAY);
+    for(uint32_t k = 1; k <= CICLO_MAX_ARQUIVADOS && k <= ultimo_id; k++){
+        ciclo_indice_t e;
+        uint32_t id = ultimo_id - (k - 1);
+        if(id == atual.id){
+            e = atual;
+        }
+        else if(!le_indice(id % CICLO_MAX_ARQUIVADOS, &e) || e.id != id){
+            continue;
+        }
+        printf("%3u  ciclo %5u  %-13s %5u blocos  %u perdidos\n", k, e.id, e.estado < 4 ? estados[e.estado] : "?",
+               e.n_blocos, e.perdidos);
+    }
+    xSemaphoreGive(trava);
+}
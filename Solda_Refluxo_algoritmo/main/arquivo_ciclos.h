@@ -0,0 +1,24 @@
+#ifndef ARQUIVO_CICLOS_H
+#define ARQUIVO_CICLOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "registro.h"
+#include "ciclo_arquivo.h"
+
+#define ARQUIVO_BASE "/ciclos"
+#define ARQUIVO_PARTICAO "ciclos"                   //Particao SPIFFS de partitions.csv
+#define ARQUIVO_LOTE_BLOCOS 4                       //256 bytes por escrita, uma pagina do SPIFFS
+
+esp_err_t arquivo_inicia(UBaseType_t prioridade, const registro_t *registro, const perfil_tabela_t *tabela,
+                         uint16_t periodo_ms);
+void arquivo_avisa(void);
+void arquivo_fim(uint8_t estado);
+bool arquivo_fechado(void);
+void arquivo_novo(const perfil_tabela_t *tabela, uint16_t periodo_ms, uint8_t tipo, uint8_t sinal);
+uint32_t arquivo_le(uint8_t k, uint32_t deslocamento, uint8_t *dados, uint32_t max, uint32_t *total);
+void arquivo_lista(void);
+
+#endif
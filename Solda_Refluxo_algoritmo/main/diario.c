@@ -0,0 +1,127 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "diario.h"
+
+#define MASCARA (DIARIO_PROFUNDIDADE - 1)
+
+static const char *TAG = "DIARIO";
+
+/**
+ * @brief Fila de um produtor: so o produtor escreve em escrita e descartados, so a tarefa do diario escreve em
+ * leitura. Cada indice e publicado com barreira (release) depois do acesso ao registro, entao nao ha trava
+ */
+typedef struct {
+    diario_registro_t registros[DIARIO_PROFUNDIDADE];
+    uint32_t escrita;                               //Proximo registro a escrever
+    uint32_t leitura;                               //Proximo registro a formatar
+    uint32_t descartados;                           //Registros perdidos com a fila cheia
+} diario_fila_t;
+
+static diario_fila_t filas[DIARIO_MAX_PRODUTORES];
+static int n_produtores;
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+static diario_formata_t formata;
+
+/*Formata os registros de todas as filas; sem registros, dorme. Avisa quando algum produtor perdeu registros*/
+static void diario_task(void *pvParameters)
+{
+    uint32_t avisados = 0;
+    while(1){
+        bool vazio = true;
+        for(int i = 0; i < n_produtores; i++){
+            diario_fila_t *f = &filas[i];
+            uint32_t leitura = f->leitura;
+            if(leitura != __atomic_load_n(&f->escrita, __ATOMIC_ACQUIRE)){
+                diario_registro_t r = f->registros[leitura & MASCARA];
+                //libera a posicao antes de formatar, que e a parte lenta
+                __atomic_store_n(&f->leitura, leitura + 1, __ATOMIC_RELEASE);
+                formata(&r);
+                vazio = false;
+            }
+        }
+
+        uint32_t descartados = diario_descartados();
+        if(descartados != avisados){
+            ESP_LOGW(TAG, "%u registros descartados com a fila cheia", descartados);
+            avisados = descartados;
+        }
+        if(vazio){
+            vTaskDelay(pdMS_TO_TICKS(DIARIO_ESPERA_MS));
+        }
+    }
+}
+
+/**
+ * @brief Cria a tarefa do diario no nucleo DIARIO_NUCLEO
+ *
+ * @param prioridade
+ * @param f formatacao dos registros
+ * @return esp_err_t
+ */
+esp_err_t diario_inicia(UBaseType_t prioridade, diario_formata_t f)
+{
+    formata = f;
+    if(xTaskCreatePinnedToCore(diario_task, "diario_task", configMINIMAL_STACK_SIZE * 3, NULL, prioridade, NULL,
+                               DIARIO_NUCLEO) != pdPASS){
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Cria a fila de um produtor. Cada tarefa que escreve no diario precisa da sua
+ *
+ * @return int id do produtor, ou -1 se nao houver espaco
+ */
+int diario_inscreve(void)
+{
+    int id = -1;
+    portENTER_CRITICAL(&mux);
+    if(n_produtores < DIARIO_MAX_PRODUTORES){
+        id = n_produtores;
+        memset(&filas[id], 0, sizeof(filas[id]));
+        n_produtores++;
+    }
+    portEXIT_CRITICAL(&mux);
+    return id;
+}
+
+/**
+ * @brief Copia o registro para a fila do produtor, sem esperar e sem trava. So a tarefa inscrita com esse id
+ * pode chamar
+ *
+ * @param id id retornado por diario_inscreve
+ * @param r
+ * @return true se coube na fila; senao o registro e descartado e contado
+ */
+bool diario_escreve(int id, const diario_registro_t *r)
+{
+    if(id < 0){
+        return false;
+    }
+    diario_fila_t *f = &filas[id];
+    uint32_t escrita = f->escrita;
+    if(escrita - __atomic_load_n(&f->leitura, __ATOMIC_ACQUIRE) == DIARIO_PROFUNDIDADE){
+        __atomic_store_n(&f->descartados, f->descartados + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    f->registros[escrita & MASCARA] = *r;
+    __atomic_store_n(&f->escrita, escrita + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief Registros descartados por todos os produtores
+ *
+ * @return uint32_t
+ */
+uint32_t diario_descartados(void)
+{
+    uint32_t total = 0;
+    for(int i = 0; i < n_produtores; i++){
+        total += __atomic_load_n(&filas[i].descartados, __ATOMIC_RELAXED);
+    }
+    return total;
+}
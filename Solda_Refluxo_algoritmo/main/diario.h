@@ -0,0 +1,37 @@
+#ifndef DIARIO_H
+#define DIARIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#define DIARIO_MAX_PRODUTORES 4
+#define DIARIO_PROFUNDIDADE 16                      //Registros esperando a formatacao, por produtor (potencia de 2)
+#define DIARIO_ESPERA_MS 50                         //Intervalo da tarefa do diario quando as filas estao vazias
+#ifndef DIARIO_NUCLEO
+#define DIARIO_NUCLEO 1                             //Nucleo da tarefa do diario; o controle fica no outro
+#endif
+
+/**
+ * @brief Registro do diario: so valores, sem texto. Quem formata (diario_formata_t) decide o texto pelo tipo
+ */
+typedef struct {
+    int64_t t_us;                                   //Instante do evento
+    uint32_t seq;                                   //Numero da amostra
+    uint8_t tipo;                                   //Definido pela aplicacao
+    uint8_t modo;                                   //Segmento do perfil
+    float v[2];                                     //Valores (temperatura, saida do PID...)
+} diario_registro_t;
+
+/**
+ * @brief Formata um registro (na tarefa do diario, que pode usar printf e ESP_LOG)
+ */
+typedef void (*diario_formata_t)(const diario_registro_t *r);
+
+esp_err_t diario_inicia(UBaseType_t prioridade, diario_formata_t formata);
+int diario_inscreve(void);
+bool diario_escreve(int id, const diario_registro_t *r);
+uint32_t diario_descartados(void);
+
+#endif
@@ -0,0 +1,106 @@
+#include <string.h>
+#include "difusao.h"
+
+#define MASCARA (DIFUSAO_PROFUNDIDADE - 1)
+
+/**
+ * @brief Inicia o canal vazio
+ *
+ * @param d
+ */
+void difusao_inicia(difusao_t *d){
+    memset(d, 0, sizeof(*d));
+    portMUX_INITIALIZE(&d->mux);
+}
+
+/**
+ * @brief Inscreve a tarefa que chama como consumidora. Ela recebe as amostras publicadas a partir de agora.
+ *
+ * @param d
+ * @return int id do consumidor, ou -1 se nao houver espaco
+ */
+int difusao_inscreve(difusao_t *d){
+    int id = -1;
+    portENTER_CRITICAL(&d->mux);
+    if(d->n_consumidores < DIFUSAO_MAX_CONSUMIDORES){
+        id = d->n_consumidores;
+        d->consumidores[id].tarefa = xTaskGetCurrentTaskHandle();
+        d->consumidores[id].lidas = d->publicadas;
+        d->consumidores[id].perdidas = 0;
+        d->n_consumidores++;
+    }
+    portEXIT_CRITICAL(&d->mux);
+    return id;
+}
+
+/**
+ * @brief Publica uma amostra e acorda todos os consumidores. Chamada na interrupcao do SPI (sem float).
+ *
+ * @param d
+ * @param leitura amostra decodificada do MAX6675
+ */
+void IRAM_ATTR difusao_publica_isr(difusao_t *d, const max6675_amostra_t *leitura){
+    BaseType_t acordou = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&d->mux);
+    difusao_amostra_t *a = &d->buf[d->publicadas & MASCARA];
+    a->seq = d->publicadas;
+    a->leitura = *leitura;
+    d->publicadas++;
+    int n = d->n_consumidores;
+    portEXIT_CRITICAL_ISR(&d->mux);
+
+    for(int i = 0; i < n; i++){
+        vTaskNotifyGiveFromISR(d->consumidores[i].tarefa, &acordou);
+    }
+    if(acordou){
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * @brief Recebe a proxima amostra ainda nao lida por este consumidor
+ *
+ * @param d
+ * @param id id retornado por difusao_inscreve
+ * @param amostra onde a amostra e copiada
+ * @param espera tempo maximo de espera (portMAX_DELAY para esperar sempre)
+ * @return true se recebeu uma amostra
+ */
+bool difusao_recebe(difusao_t *d, int id, difusao_amostra_t *amostra, TickType_t espera){
+    while(1){
+        portENTER_CRITICAL(&d->mux);
+        uint32_t atraso = d->publicadas - d->consumidores[id].lidas;
+        if(atraso > 0){
+            /*As amostras mais antigas que a profundidade ja foram sobrescritas*/
+            if(atraso > DIFUSAO_PROFUNDIDADE){
+                d->consumidores[id].perdidas += atraso - DIFUSAO_PROFUNDIDADE;
+                d->consumidores[id].lidas = d->publicadas - DIFUSAO_PROFUNDIDADE;
+            }
+            *amostra = d->buf[d->consumidores[id].lidas & MASCARA];
+            d->consumidores[id].lidas++;
+            portEXIT_CRITICAL(&d->mux);
+            return true;
+        }
+        portEXIT_CRITICAL(&d->mux);
+
+        /*A notificacao so acorda a tarefa; o que vale e o indice de leitura, entao zerar o contador nao perde amostras*/
+        if(ulTaskNotifyTake(pdTRUE, espera) == 0){
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Numero de amostras que o consumidor perdeu por atraso
+ *
+ * @param d
+ * @param id
+ * @return uint32_t
+ */
+uint32_t difusao_perdidas(difusao_t *d, int id){
+    portENTER_CRITICAL(&d->mux);
+    uint32_t perdidas = d->consumidores[id].perdidas;
+    portEXIT_CRITICAL(&d->mux);
+    return perdidas;
+}
@@ -0,0 +1,45 @@
+#ifndef DIFUSAO_H
+#define DIFUSAO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "max6675_amostra.h"
+
+#define DIFUSAO_MAX_CONSUMIDORES 4
+#define DIFUSAO_PROFUNDIDADE 8                      //Amostras guardadas para consumidores atrasados (potencia de 2)
+
+/**
+ * @brief Amostra distribuida para os consumidores
+ */
+typedef struct {
+    uint32_t seq;                                   //Numero de sequencia (0, 1, 2...)
+    max6675_amostra_t leitura;                      //Leitura completa do MAX6675, com o instante
+} difusao_amostra_t;
+
+/**
+ * @brief Canal de difusao de amostras: um produtor e ate DIFUSAO_MAX_CONSUMIDORES consumidores.
+ * Cada consumidor tem seu proprio indice de leitura e e acordado por notificacao direta da tarefa,
+ * entao recebe cada amostra exatamente uma vez. Se atrasar mais que DIFUSAO_PROFUNDIDADE amostras,
+ * as mais antigas sao perdidas e contadas.
+ */
+typedef struct {
+    difusao_amostra_t buf[DIFUSAO_PROFUNDIDADE];
+    uint32_t publicadas;                            //Proximo numero de sequencia
+    struct {
+        TaskHandle_t tarefa;
+        uint32_t lidas;                             //Proximo numero de sequencia a ler
+        uint32_t perdidas;                          //Amostras sobrescritas antes de serem lidas
+    } consumidores[DIFUSAO_MAX_CONSUMIDORES];
+    int n_consumidores;
+    portMUX_TYPE mux;
+} difusao_t;
+
+void difusao_inicia(difusao_t *d);
+int difusao_inscreve(difusao_t *d);
+void difusao_publica_isr(difusao_t *d, const max6675_amostra_t *leitura);
+bool difusao_recebe(difusao_t *d, int id, difusao_amostra_t *amostra, TickType_t espera);
+uint32_t difusao_perdidas(difusao_t *d, int id);
+
+#endif
@@ -0,0 +1,43 @@
+#include <stdlib.h>
+#include "nvs.h"
+#include "esp_log.h"
+#include "escalonamento_nvs.h"
+
+static const char *TAG = "ESCALONAMENTO";
+
+/**
+ * @brief Le a tabela de escalonamento dos ganhos gravada em texto na NVS (formato de escalonamento_tabela_le). A NVS
+ * deve ter sido iniciada com nvs_flash_init. Se nao houver tabela ou ela for invalida, a tabela passada nao e alterada.
+ *
+ * @param tabela
+ * @return esp_err_t ESP_ERR_NVS_NOT_FOUND sem tabela gravada, ESP_ERR_INVALID_ARG com o texto invalido
+ */
+esp_err_t escalonamento_nvs_carrega(escalonamento_tabela_t *tabela){
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(ESCALONAMENTO_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if(ret != ESP_OK){
+        return ret;
+    }
+
+    size_t tam = 0;
+    ret = nvs_get_str(nvs, ESCALONAMENTO_NVS_CHAVE, NULL, &tam);
+    if(ret == ESP_OK && tam > ESCALONAMENTO_NVS_TAM_MAX){
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    char *texto = NULL;
+    if(ret == ESP_OK){
+        texto = malloc(tam);
+        ret = texto ? nvs_get_str(nvs, ESCALONAMENTO_NVS_CHAVE, texto, &tam) : ESP_ERR_NO_MEM;
+    }
+    nvs_close(nvs);
+
+    if(ret == ESP_OK){
+        int erro = escalonamento_tabela_le(tabela, texto);
+        if(erro > 0){
+            ESP_LOGE(TAG, "faixa invalida na linha %d", erro);
+            ret = ESP_ERR_INVALID_ARG;
+        }
+    }
+    free(texto);
+    return ret;
+}
@@ -0,0 +1,13 @@
+#ifndef ESCALONAMENTO_NVS_H
+#define ESCALONAMENTO_NVS_H
+
+#include "esp_err.h"
+#include "escalonamento.h"
+
+#define ESCALONAMENTO_NVS_NAMESPACE "escalonamento"
+#define ESCALONAMENTO_NVS_CHAVE "tabela"
+#define ESCALONAMENTO_NVS_TAM_MAX 2048              //Tamanho maximo do texto da tabela
+
+esp_err_t escalonamento_nvs_carrega(escalonamento_tabela_t *tabela);
+
+#endif
@@ -0,0 +1,49 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/spi_master.h"
+#include "esp_timer.h"
+#include "rele.h"
+#include "max6675.h"
+#include "hal_esp32.h"
+#include "tempo.h"
+
+/*Sensor - MAX6675 no barramento HSPI (a leitura ja espera 500ms pela conversao)*/
+static void le_sensor(void *ctx, max6675_amostra_t *amostra){
+    max6675_le(spi, amostra);
+}
+
+/*Atuador - rele no PWM do LEDC*/
+static void altera_duty(void *ctx, float d){
+    rele_d_altera(d);
+}
+
+/**
+ * @brief Relogio do controle (ver tempo.h): o esp_timer, o mesmo que marca as leituras do MAX6675
+ *
+ * @return int64_t
+ */
+int64_t tempo_us(void){
+    return esp_timer_get_time();
+}
+
+static int64_t agora_us(void *ctx){
+    return tempo_us();
+}
+
+static void espera_ms(void *ctx, uint32_t ms){
+    vTaskDelay(ms / portTICK_PERIOD_MS);
+}
+
+/**
+ * @brief Preenche a HAL com o MAX6675, o rele e o esp_timer. O sensor e o PWM devem ser configurados antes
+ * com max6675_set e rele_pwm_set.
+ *
+ * @param hal
+ */
+void hal_esp32_inicia(reflow_hal_t *hal){
+    hal->ctx = NULL;
+    hal->le_sensor = le_sensor;
+    hal->altera_duty = altera_duty;
+    hal->agora_us = agora_us;
+    hal->espera_ms = espera_ms;
+}
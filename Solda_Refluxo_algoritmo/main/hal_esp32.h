@@ -0,0 +1,8 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+#include "reflow_hal.h"
+
+void hal_esp32_inicia(reflow_hal_t *hal);
+
+#endif
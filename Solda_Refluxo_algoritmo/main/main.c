@@ -1,23 +1,46 @@
 /**
  * @file main.c
  * @author Giovani (giovani.hiroshi@uel)
- * @brief O algoritmo controla a temperatura do ferro. Funciona atraves de 3 tarefas e mais uma para printar os valores de temperatura
+ * @brief O algoritmo controla a temperatura do ferro. Funciona atraves de 3 tarefas, uma de log e mais uma para printar os valores de temperatura
  * 
- * task_read_temp - le a temperatura a cada 0,5s (tempo de delay da propria funcao de leitura) e permite a execucao da tarefas: verifica_tempo e 
- * control_pwm. O bit que realiza essa permicao e limpo pelas tarefas que a esperam. 
+ * A leitura do MAX6675 nao tem tarefa: um esp_timer enfileira a transacao do SPI a cada 0,5s e a interrupcao de fim da transacao publica
+ * a amostra completa (contagem de 0,25 grau, termopar aberto, ID e instante da leitura), com numero de sequencia, no canal de difusao. As tarefas verifica_tempo e control_pwm recebem
+ * cada amostra exatamente uma vez.
  * 
  * control_pwm - Realiza calculo do PID. Esse calculo depende da temperatura atual e do setpoint (Temperatura desejada). Configura o pwm de acordo 
  * com a saida do PID.
  * 
- * verifica_tempo - Atualizado a cada 1s. Altera o setpoint dependendo do estagio do perfil de temperatura. Armazena a temperatura durante todo o
- * processo. Inicia em pelo pre aquecimento que aumenta a temp do ferro ate 150 graus. Chegando em 150, passa para o estagio de imersao termica.
- * Imersao termica mantem essa temp por 120s. Depois passa para o proximo estagio, refluxo. Refluxo é dividido em duas partes. Parte 1, aumenta a temp
- * do ferro ate 240 graus e dps passa para parte 2. Parte 2, mantem essa temp por 30s e dps passa para o resfriamento. No resfriamento, o ferro fica 
- * desligado por 60s e dps permite a execucao da proxima tarefa. Essa tarefa é deletada no fim, pois nao vai ser utilizada mais e para parar de armazenar
- * os valores de temp
+ * verifica_tempo - Atualizado a cada amostra. Altera o setpoint dependendo do segmento do perfil de temperatura. Armazena a temperatura durante todo o
+ * processo. O perfil e uma tabela de segmentos (rampa, patamar e resfriamento, cada um com sua condicao de saida) lida da NVS na partida; sem tabela
+ * gravada usa o perfil padrao: aquece ate 100 graus por 3 min, pre aquecimento ate 150 graus, imersao termica em 150 por 120s, refluxo em 195 por 60s,
+ * aumenta ate 240 e mantem por 30s e resfriamento por 120s. No fim permite a execucao da proxima tarefa. Essa tarefa é deletada no fim, pois nao vai
+ * ser utilizada mais e para parar de armazenar os valores de temp
  * 
- * printar_task - Ocorre apos o fim do processo da solda por refluxo. Printa a temperatura ideal que o ferro deveria seguir e a temperatura real que
- * o ferro seguiu
+ * diario_task - Printa a temperatura e a saida do PID de cada amostra, as mudancas de segmento e as amostras perdidas por cada tarefa. As tarefas
+ * de controle nao usam printf nem ESP_LOG: colocam registros binarios de tamanho fixo numa fila sem trava (um produtor, um consumidor) e a
+ * diario_task, de menor prioridade e no outro nucleo, formata e printa. Com a fila cheia o registro e descartado e contado (ver diario.h)
+ * 
+ * console_task - Le comandos do console: 'l' printa os histogramas de latencia de cada fase do control_pwm e os prazos perdidos,
+ * 'z' zera os histogramas, 'd' printa o log do ciclo em texto depois do fim do perfil, 'a' lista os ciclos guardados na flash, 't' para o perfil
+ * e sintoniza o PID pelo experimento do rele em AUTOTUNE_SETPOINT (ver autotune.h); os ganhos vao para a NVS e sao usados a partir da proxima partida.
+ * 'e' (PRBS) e 'E' (chirp) param o perfil e excitam o forno em malha aberta em volta de EXCITACAO_TEMPERATURA para identificacao (ver excitacao.h);
+ * a saida e a temperatura de cada amostra vao para o log do ciclo, e host/resposta_frequencia calcula a resposta em frequencia.
+ * 'm' liga e desliga o controle auto-ajustavel (ver adaptativo.h) e printa o modelo estimado. Com uma tabela de escalonamento na
+ * NVS, os ganhos fixos mudam com o estagio e a temperatura (ver escalonamento.h)
+ * 
+ * telemetria_task - Envia pela UART da telemetria, em quadros binarios (ver telemetria.h), cada iteracao do controle (temperatura, setpoint,
+ * termos do PID e saida) e cada mudanca de segmento, enquanto o ciclo roda. As tarefas de controle so colocam as mensagens numa fila, sem esperar;
+ * host/telemetria_captura grava os quadros em disco. Pela mesma UART, comandos_task atende os pedidos de host/registro_exporta, que le o log
+ * do ciclo em binario, em pedacos com CRC, numa velocidade maior
+ * 
+ * arquivo_task - Grava os blocos completos do log na particao SPIFFS "ciclos" durante o ciclo, em lotes de uma pagina, depois de cada iteracao
+ * do controle. Guarda os ultimos CICLO_MAX_ARQUIVADOS ciclos, com um indice (ver ciclo_arquivo.h)
+ * 
+ * printar_task - Ocorre apos o fim do processo da solda por refluxo. Avisa o tamanho do log, que pode ser exportado em binario (registro_exporta) ou
+ * printado em texto com 'd' no console: a temperatura ideal que o ferro deveria seguir e a temperatura real que o ferro seguiu
+ * 
+ * A logica de controle (PID e perfil) fica no componente controle e acessa o hardware pela HAL (hal_esp32), para poder ser
+ * compilada e simulada tambem no host (ver host/).
  * 
  * @version 0.1
  * @date 2023-06-02
@@ -31,6 +54,7 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_system.h"
 #include "driver/spi_master.h"
 #include "soc/gpio_struct.h"
@@ -39,28 +63,96 @@
 #include "esp_log.h"
 #include "rele.h"
 #include "max6675.h"
-#include "sys/time.h"
-#include <time.h>
+#include "hal_esp32.h"
+#include "pid.h"
+#include "perfil.h"
+#include "filtro.h"
+#include "difusao.h"
+#include "latencia.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "perfil_nvs.h"
+#include "pid_nvs.h"
+#include "autotune.h"
+#include "excitacao.h"
+#include "adaptativo.h"
+#include "escalonamento_nvs.h"
+#include "perfis_solda.h"
+#include "registro.h"
+#include "tempo.h"
+#include "telemetria_uart.h"
+#include "arquivo_ciclos.h"
+#include "diario.h"
+#ifdef PID_BENCH
+#include "pid_bench.h"
+#endif
+#ifdef FILTRO_BENCH
+#include "filtro_bench.h"
+#endif
+#if defined(PID_BENCH) || defined(FILTRO_BENCH)
+#include "hal/cpu_hal.h"
+#endif
 
-#define TEMP_BIT BIT0
 #define PRINTAR_BIT BIT1
-#define CONTROL_BIT BIT2
+
+
+// perfil usado sem tabela na NVS: idf.py build -DPERFIL_SOLDA=perfil_sac305 (ou perfil_sn63pb37, perfil_snbi)
+#ifndef PERFIL_SOLDA
+#define PERFIL_SOLDA perfil_tabela_padrao
+#endif
+
+// controle auto-ajustavel ligado na partida: idf.py build -DCONTROLE_ADAPTATIVO=1 ('m' no console liga e desliga)
+#ifndef CONTROLE_ADAPTATIVO
+#define CONTROLE_ADAPTATIVO 0
+#endif
 
 // handle do dispositivo SPI
 spi_device_handle_t spi;
 
+// acesso ao sensor, rele e relogio
+reflow_hal_t hal;
+
+// canal de difusao das amostras de temperatura
+difusao_t difusao;
+enum { CONSUMIDOR_PERFIL, CONSUMIDOR_PID, N_CONSUMIDORES };
+int consumidor[N_CONSUMIDORES];
+
 // variáveis de controle
-int i,temp = 0;
 float T = 0.5; //periodo em s 
-int setpoint = 0;
-float current_time, erro , erro_ant = 0;
 float kp = 3;
 float ki = 24;
 float kd = 4;
-float PID_P,PID_I, PID_D , PID_Output,PID_Output_ant = 0;
-
-int temperatura_ideal[3000] = {0};
-int temperatura_real[3000] = {0};
+pid_ctrl_t pid;
+adaptativo_t adaptativo;
+escalonamento_tabela_t tabela_escalonamento;
+escalonamento_t escalonamento;
+perfil_t perfil;
+const perfil_tabela_t *tabela_perfil = &PERFIL_SOLDA;
+filtro_t filtro;
+latencia_t latencia;
+
+// experimentos pedidos pelo console, que param o perfil: autotune pelo rele ('t') e excitacao para identificacao ('e', 'E')
+enum { EXPERIMENTO_PARADO, EXPERIMENTO_PEDIDO, EXPERIMENTO_RODANDO, EXPERIMENTO_TERMINADO, EXPERIMENTO_CONCLUIDO };
+enum { EXPERIMENTO_AUTOTUNE, EXPERIMENTO_EXCITACAO };
+volatile int experimento = EXPERIMENTO_PARADO;
+int tipo_experimento;
+autotune_t autotune;
+excitacao_t excitacao;
+int sinal_excitacao;
+
+// registros do diario, formatados pela diario_task
+enum { DIARIO_AMOSTRA, DIARIO_ABERTO, DIARIO_ESTAGIO };
+
+// log do ciclo (anel de blocos com as diferencas entre amostras)
+registro_t registro;
+
+// saida do PID de cada amostra do perfil, de control_pwm para verifica_tempo, que escreve no log. control_pwm tem
+// prioridade maior no mesmo nucleo e termina a amostra antes; uma saida de outra amostra nao e gravada
+typedef struct {
+    uint32_t seq;
+    float saida;
+} saida_amostra_t;
+QueueHandle_t fila_saida;
 
 static const char *TAG = "MAIN";
 
@@ -68,19 +160,41 @@ static const char *TAG = "MAIN";
 EventGroupHandle_t LD_event_group;
 
 
-void obterHoraLocal() {
-    time_t now;
-    struct tm timeinfo;
-
-    time(&now);
-    localtime_r(&now, &timeinfo);
+static void printa_ideal(void *arg, const registro_evento_t *ev)
+{
+    if(ev->tipo == REGISTRO_AMOSTRA){
+        printf("%.2f ", perfil_ideal(arg, ev));
+    }
+}
 
-    ESP_LOGI(TAG, "s: %d ", timeinfo.tm_sec);
+static void printa_real(void *arg, const registro_evento_t *ev)
+{
+    if(ev->tipo == REGISTRO_AMOSTRA){
+        printf("%.2f ", ev->real);
+    }
 }
 
+/**
+ * @brief Printa o log em texto: a temperatura ideal e a real de cada amostra. Lento (milhares de numeros na
+ * velocidade do console); registro_exporta le o mesmo log em binario pela UART da telemetria
+ */
+static void printa_registro(void)
+{
+    //Logica para printar as temperaturas (se o log encheu, as amostras mais antigas foram descartadas)
+    if(registro.perdidos){
+        ESP_LOGW(TAG, "%u blocos do inicio do log foram descartados", registro.perdidos);
+    }
+    //O log so guarda o inicio de cada segmento; o setpoint e refeito pela tabela do perfil
+    perfil_ideal_t ideal;
+    perfil_ideal_inicia(&ideal, tabela_perfil);
+    printf("Temperatura ideal: ");
+    registro_percorre(&registro, printa_ideal, &ideal);
+    printf("Temperatura real: ");
+    registro_percorre(&registro, printa_real, NULL);
+}
 
 /**
- * @brief Esperar acabar o processo de solda por refluxo e printa as temperaturas desse o processo
+ * @brief Esperar acabar o processo de solda por refluxo e avisa que o log pode ser exportado
  * 
  * @param pvParameters 
  */
@@ -98,218 +212,390 @@ void printar_task(void *pvParameters)
             portMAX_DELAY           // tempo máximo para esperar os bits
         );
         
-        int i;
-        //Logica para printar as temperaturas
-        printf("Temperatura ideal: ");
-        for (i = 0; i < 3000; i++) {
-            printf("%d ", temperatura_ideal[i]);
-        }
-        printf("Temperatura real: ");
-        for (i = 0; i < 3000; i++) {
-            printf("%d ", temperatura_real[i]);
-        }
-        
+        ESP_LOGI(TAG, "Ciclo concluido: log com %u blocos de %u bytes (%u descartados). Exporte com registro_exporta "
+                 "ou digite 'd' para printar", registro_n_blocos(&registro), (unsigned)sizeof(registro_bloco_t),
+                 registro.perdidos);
     }
 }
 
 /**
- * @brief Verifica em qual estagio esta o perfil de temperatura. Altera o setpoint de acordo com o estagio.
- * Ocorre a cada 1s(0,5s de delay da propria task e 0,5s do delay da leitura)
+ * @brief Arquivos que o host pode exportar pela telemetria. O arquivo 0 e o log do ciclo, bloco atras de bloco
+ * do mais antigo para o mais novo (o formato de reflow_host -w). So e exportado depois do fim do perfil (ou do
+ * experimento, que reinicia o log), quando o log nao muda mais e os deslocamentos de uma exportacao retomada continuam valendo. Os arquivos 1, 2... sao
+ * os ciclos guardados na flash (arquivo_le), com o cabecalho de ciclo_arquivo.h.
+ */
+static uint32_t exporta_registro(void *arg, uint8_t arquivo, uint32_t deslocamento, uint8_t *dados, uint32_t max,
+                                 uint32_t *total)
+{
+    // 1, 2... sao os ciclos guardados na flash, do mais recente para o mais antigo
+    if(arquivo != 0){
+        return arquivo_le(arquivo, deslocamento, dados, max, total);
+    }
+    if(experimento == EXPERIMENTO_PARADO ? !perfil.terminado : experimento != EXPERIMENTO_CONCLUIDO){
+        *total = 0;
+        return 0;
+    }
+    *total = registro_n_blocos(&registro) * sizeof(registro_bloco_t);
+    if(deslocamento >= *total){
+        return 0;
+    }
+    uint32_t dentro = deslocamento % sizeof(registro_bloco_t);
+    uint32_t n = sizeof(registro_bloco_t) - dentro;
+    if(n > max){
+        n = max;
+    }
+    memcpy(dados, (const uint8_t *)registro_bloco(&registro, deslocamento / sizeof(registro_bloco_t)) + dentro, n);
+    return n;
+}
+
+/**
+ * @brief Envia o inicio de um segmento (ou o fim do perfil) para a telemetria
+ * 
+ * @param tipo TELEMETRIA_ESTAGIO ou TELEMETRIA_FIM
+ * @param t_us instante da amostra
+ */
+static void envia_estagio(uint8_t tipo, int64_t t_us)
+{
+    telemetria_msg_t msg = { .tipo = tipo };
+    msg.estagio.t_us = t_us;
+    msg.estagio.modo = perfil.modo_operacao;
+    msg.estagio.setpoint = perfil.trajetoria.inicio;
+    telemetria_uart_envia(&msg);
+}
+
+/**
+ * @brief Verifica em qual segmento esta o perfil de temperatura. Altera o setpoint de acordo com o segmento (ver perfil_passo).
+ * Ocorre a cada amostra; o setpoint e a duracao dos segmentos vem do instante das amostras
  * 
  * @param pvParameters 
  */
 void verifica_tempo(void *pvParameters)
 {
-    int modo_operacao = 0;
-    int t_atual = 0;
-    int t_anterior = 0;
+    difusao_amostra_t amostra;
+    consumidor[CONSUMIDOR_PERFIL] = difusao_inscreve(&difusao);
+    int diario = diario_inscreve();
     while (1)
     {
-        // espera pelo bit de controle
-        xEventGroupWaitBits(
-            LD_event_group,         // grupo de eventos a ser esperado
-            CONTROL_BIT,            // bit que está sendo esperado
-            pdFALSE,                // não limpa os bits após a leitura
-            pdFALSE,                // espera por um dos bits
-            portMAX_DELAY           // tempo máximo para esperar os bits
-        );
+        // espera pela proxima amostra
+        difusao_recebe(&difusao, consumidor[CONSUMIDOR_PERFIL], &amostra, portMAX_DELAY);
 
+        // com o termopar aberto a amostra nao vale; durante os experimentos o perfil fica parado (e o log e da
+        // excitacao, escrito por control_pwm)
+        if(amostra.leitura.aberto || experimento != EXPERIMENTO_PARADO){
+            continue;
+        }
 
-        switch (modo_operacao)
-        {
-        //Aquece ate 100 graus e espera por 2 min    
-        case 0: 
-            /*temperatura_ideal armazena a temperatura que o perfil de temperatura deveria seguir*/
-            temperatura_ideal[t_atual] = 100;
-            temperatura_real[t_atual] = temp;
-            t_atual++;
-            setpoint = 100;        
-            if(t_atual>360){
-                ESP_LOGI(TAG, "Pre aquecimento");
-                modo_operacao = 1;
-            }
-            break;
-        //pre aquecimento - Aumenta do temperatura do ferro ate 150 graus    
-        case 1:
-            /*temperatura_ideal armazena a temperatura que o perfil de temperatura deveria seguir*/
-            temperatura_ideal[t_atual] = 150;
-                        
-            /*temperatura_real armazena os valores de temperatura da leitura do MAX6675*/
-            temperatura_real[t_atual] = temp;
-            /*Incrementa t_atual a cada 0.5s*/
-            t_atual++;
-            /*setpoint é a temperatura que o perfil deve atingir*/
-            setpoint = 150;
-            /*Se a temperatura do ferro passar de 150, passa para o proximo estagio*/
-            if(temp > (150 - 20)){
-                ESP_LOGI(TAG, "Imersao termica");
-                modo_operacao = 2;
-                //armazena tempo que mudou de estagio
-                t_anterior = t_atual;
-            }         
-            break;
-        //Imersao termica - Manter a temperatura em 150 graus
-        case 2:
-            //Estagio p manter a temperatura do ferro em 150 graus
-            setpoint = 150;  
-            //temperatura_ideal armazena a temperatura que o perfil de temperatura deveria seguir
-            temperatura_ideal[t_atual] = 150;
-            //temperatura_real armazena os valores de temperatura da leitura do MAX6675
-            temperatura_real[t_atual] = temp;            
-            t_atual++;
-
-            //O estagio dura 120s e passa para o proximo estagio    
-            if((t_atual - t_anterior)>240){
-                ESP_LOGI(TAG, "Refluxo parte 1");
-                modo_operacao = 3;
-                t_anterior = t_atual;
+        // a saida calculada com esta amostra vai para o log antes dela, como na excitacao
+        saida_amostra_t s;
+        if(xQueuePeek(fila_saida, &s, 0) == pdTRUE && s.seq == amostra.seq){
+            registro_saida(&registro, s.saida);
+        }
+        int modo_anterior = perfil.modo_operacao;
+        perfil_passo(&perfil, max6675_graus(&amostra.leitura), amostra.leitura.t_us);
+        if(perfil.modo_operacao != modo_anterior){
+            diario_registro_t r = { .t_us = amostra.leitura.t_us, .seq = amostra.seq, .tipo = DIARIO_ESTAGIO,
+                                    .modo = perfil.modo_operacao };
+            diario_escreve(diario, &r);
+        }
+        // o primeiro segmento comeca na primeira amostra
+        if(perfil.modo_operacao != modo_anterior || perfil.t_atual == 1){
+            envia_estagio(TELEMETRIA_ESTAGIO, amostra.leitura.t_us);
+        }
+        if(perfil.terminado){
+            envia_estagio(TELEMETRIA_FIM, amostra.leitura.t_us);
+            arquivo_fim(CICLO_COMPLETO);
+            //permite a execucao da tarefa printar_task
+            xEventGroupSetBits(LD_event_group, PRINTAR_BIT);
+            //Apaga esta tarefa (verifica_tempo)
+            vTaskDelete(NULL);
+        }
+    }
+}
+
+/**
+ * @brief Formata os registros do diario, na diario_task, fora das tarefas de controle
+ * 
+ * @param r 
+ */
+static void formata_diario(const diario_registro_t *r)
+{
+    switch(r->tipo){
+    case DIARIO_AMOSTRA:
+        printf("[%.1f s] Temperatura: %.2f PID: %f \n", r->t_us / 1e6, r->v[0], r->v[1]);
+        // a cada 100 amostras, mostra quantas cada tarefa perdeu
+        if(r->seq % 100 == 0){
+            ESP_LOGI(TAG, "amostra %u perdidas: perfil %u pid %u telemetria %u diario %u", r->seq,
+                     difusao_perdidas(&difusao, consumidor[CONSUMIDOR_PERFIL]),
+                     difusao_perdidas(&difusao, consumidor[CONSUMIDOR_PID]),
+                     telemetria_uart_perdidas(), diario_descartados());
+        }
+        break;
+    case DIARIO_ABERTO:
+        ESP_LOGE(TAG, "[%.1f s] Termopar aberto", r->t_us / 1e6);
+        break;
+    case DIARIO_ESTAGIO:
+        ESP_LOGI(TAG, "[%.1f s] %s", r->t_us / 1e6, perfil_nome_estagio(perfil.tabela, r->modo));
+        break;
+    }
+}
+
+/**
+ * @brief Cacula a saida do PID e altera a largura do pulso do PWM.
+ * O periodo vem do esp_timer da aquisicao (periodico, sem deriva); o PID usa o intervalo medido entre as
+ * amostras, que inclui o atraso do SPI e as amostras descartadas com o termopar aberto.
+ * 
+ * @param pvParameters 
+ */
+void control_pwm(void *pvParameters)
+{
+    difusao_amostra_t amostra;
+    int64_t t_ultima_us = 0;
+    bool fechando = false;
+    consumidor[CONSUMIDOR_PID] = difusao_inscreve(&difusao);
+    int diario = diario_inscreve();
+    while (1)
+    {
+        // espera pela proxima amostra
+        difusao_recebe(&difusao, consumidor[CONSUMIDOR_PID], &amostra, portMAX_DELAY);
+
+        // com o termopar aberto desliga o rele
+        if(amostra.leitura.aberto){
+            hal.altera_duty(hal.ctx, 0);
+            diario_registro_t r = { .t_us = amostra.leitura.t_us, .seq = amostra.seq, .tipo = DIARIO_ABERTO };
+            diario_escreve(diario, &r);
+            continue;
+        }
+        // o experimento grava num ciclo novo do arquivo: antes fecha o do perfil, com o rele desligado ate a tarefa
+        // do arquivo terminar (so na folga entre as amostras)
+        if(experimento == EXPERIMENTO_PEDIDO && !arquivo_fechado()){
+            if(!fechando){
+                //o perfil parou no meio: o ciclo fica marcado como interrompido (ou ja terminou e esta completo)
+                arquivo_fim(perfil.terminado ? CICLO_COMPLETO : CICLO_INTERROMPIDO);
+                fechando = true;
             }
-            break;
-        //pre aquecimento do refluxo
-        case 3:
-            //temperatura_ideal armazena a temperatura que o perfil de temperatura deveria seguir
-            temperatura_ideal[t_atual] = 195;
-            temperatura_real[t_atual] = temp;
-            t_atual++;
-            //Manter a temp em 195
-            setpoint = 195;   
-            if((t_atual - t_anterior)>120){
-                ESP_LOGI(TAG, "Refluxo parte 2");
-                modo_operacao = 4;
-                t_anterior = t_atual;
+            hal.altera_duty(hal.ctx, 0);
+            arquivo_avisa();
+            continue;
+        }
+        // a aquisicao vai do fim da transacao do SPI ate a amostra chegar nesta tarefa
+        latencia_inicio(&latencia, amostra.leitura.t_us, amostra.leitura.t_us);
+        latencia_marca(&latencia, LATENCIA_AQUISICAO);
+
+        //Filtra a temperatura e calcula o PID
+        float lida = max6675_graus(&amostra.leitura);
+        float temp = filtro_aplica(&filtro, lida);
+        latencia_marca(&latencia, LATENCIA_FILTRO);
+        float dt = t_ultima_us ? (float)(amostra.leitura.t_us - t_ultima_us) / 1e6f : T;
+        t_ultima_us = amostra.leitura.t_us;
+        float setpoint = perfil.setpoint;
+        float saida;
+        if(experimento == EXPERIMENTO_PEDIDO){
+            if(tipo_experimento == EXPERIMENTO_AUTOTUNE){
+                autotune_inicia(&autotune, AUTOTUNE_SETPOINT, AUTOTUNE_HISTERESE, PID_SAIDA_MAX);
             }
-            break;
-        //Refluxo parte 2 - Aumentar a temperatura ate 240 
-        case 4:
-            //temperatura_ideal armazena a temperatura que o perfil de temperatura deveria seguir
-            temperatura_ideal[t_atual] = 240;
-
-            //temperatura_real armazena os valores de temperatura da leitura do MAX6675
-            temperatura_real[t_atual] = temp;            
-            t_atual++;
-            //Temperatura alvo e 240 graus
-            setpoint = 240;
-            //Quando a temperatura atingir 240, passa p o proximo estagio
-            if((temp)>(240-20)){
-                ESP_LOGI(TAG, "Resfriamento");
-                modo_operacao = 5;
-                t_anterior=t_atual;
+            else{
+                // verifica_tempo ja parou de escrever no log e o ciclo do perfil esta fechado: a excitacao comeca
+                // com o log vazio, no proprio ciclo do arquivo
+                excitacao_config_t cfg;
+                excitacao_config_padrao(&cfg, sinal_excitacao);
+                registro_inicia(&registro, T * 1000);
+                arquivo_novo(tabela_perfil, T * 1000, CICLO_EXCITACAO, sinal_excitacao);
+                excitacao_inicia(&excitacao, &cfg, PID_SAIDA_MAX, &registro);
             }
-            break;
-        //Refluxo parte 3 - Manter a temperatura em 240  
-        case 5:
-            //Manter a temperatura em 240   
-            setpoint = 240;
-            //temperatura_ideal armazena a temperatura que o perfil de temperatura deveria seguir
-            temperatura_ideal[t_atual] = 240;
-            //temperatura_real armazena os valores de temperatura da leitura do MAX6675
-            temperatura_real[t_atual] = temp;         
-            t_atual++;
-            //A duracao do estagio deve ser 30s. Se passa disso, vai para proximo estagio
-            if(t_atual - t_anterior>60){
-                ESP_LOGI(TAG, "Resfriamento");
-                modo_operacao = 6;
-                t_anterior = t_atual;
+            experimento = EXPERIMENTO_RODANDO;
+        }
+        if(experimento == EXPERIMENTO_PARADO){
+            //O modelo e estimado sempre; com o modo desligado ou o modelo invalido a saida e a do PID fixo
+            saida = adaptativo_atualiza(&adaptativo, &pid, perfil.modo_operacao, setpoint, perfil.derivada, temp, dt);
+        }
+        else if(tipo_experimento == EXPERIMENTO_AUTOTUNE){
+            //O rele do autotune substitui o PID; depois do fim fica desligado ate a proxima partida
+            setpoint = autotune.setpoint;
+            saida = autotune_passo(&autotune, temp, amostra.leitura.t_us);
+            if(experimento == EXPERIMENTO_RODANDO && autotune.estado != AUTOTUNE_RODANDO){
+                experimento = EXPERIMENTO_TERMINADO;
             }
-            break;
-        //Resfriamento - deixar ferro desligado
-        case 6: 
-            //Temperatura alvo
-            setpoint = 0;
-            //temperatura_ideal armazena a temperatura que o perfil de temperatura deveria seguir
-            temperatura_ideal[t_atual] = temperatura_ideal[t_atual -1] - 2;
-            //temperatura_real armazena os valores de temperatura da leitura do MAX6675
-            temperatura_real[t_atual] = temp;
-            t_atual++; 
-            //A duracao do estagio deve ser ate esfriar, mas para espera somente 60s para fins praticos
-            if(t_atual - t_anterior>240){
-                //permite a execucao da tarefa printar_task
-                xEventGroupSetBits(LD_event_group, PRINTAR_BIT);
-                //Apaga esta tarefa (verifica_tempo)
-                vTaskDelete(NULL);
+        }
+        else{
+            //A excitacao tambem substitui o PID e grava a saida e a temperatura lida de cada amostra no log
+            setpoint = excitacao.cfg.temperatura;
+            saida = excitacao_passo(&excitacao, lida, temp, amostra.leitura.t_us);
+            if(experimento == EXPERIMENTO_RODANDO && excitacao.estado != EXCITACAO_RODANDO){
+                experimento = EXPERIMENTO_TERMINADO;
             }
-            
+        }
+        latencia_marca(&latencia, LATENCIA_PID);
+        //Controla o PWM do relé com o valor de saido do PID
+        hal.altera_duty(hal.ctx, saida);
+        latencia_marca(&latencia, LATENCIA_ATUACAO);
+        latencia_fim(&latencia);
+        if(experimento == EXPERIMENTO_PARADO){
+            saida_amostra_t s = { .seq = amostra.seq, .saida = saida };
+            xQueueOverwrite(fila_saida, &s);
         }
 
-        printf("Temperatura: %d \n", temp);
-        printf("PID: %f \n", PID_Output);
-        // espera por 0,5 segundo
-        obterHoraLocal();
-        
+        //Envia a iteracao para a telemetria, fora do tempo de resposta (so entra na fila)
+        telemetria_msg_t msg = { .tipo = TELEMETRIA_AMOSTRA };
+        msg.amostra.seq = amostra.seq;
+        msg.amostra.t_us = amostra.leitura.t_us;
+        msg.amostra.temp = lida;
+        msg.amostra.filtrada = temp;
+        msg.amostra.setpoint = setpoint;
+        msg.amostra.P = pid.P;
+        msg.amostra.I = pid.I;
+        msg.amostra.D = pid.D;
+        msg.amostra.saida = saida;
+        msg.amostra.modo = perfil.modo_operacao;
+        msg.amostra.sat = pid.sat;
+        telemetria_uart_envia(&msg);
+
+        //A temperatura e a saida sao printadas pela diario_task, ate o fim do perfil
+        if(!perfil.terminado){
+            diario_registro_t r = { .t_us = amostra.leitura.t_us, .seq = amostra.seq, .tipo = DIARIO_AMOSTRA,
+                                    .modo = perfil.modo_operacao, .v = { lida, saida } };
+            diario_escreve(diario, &r);
+        }
+
+        //Grava os blocos completos do log na flash na folga ate a proxima amostra
+        arquivo_avisa();
+    }
+}
+/**
+ * @brief Fim do autotune: grava os ganhos na NVS, fora das tarefas de controle
+ */
+static void conclui_autotune(void)
+{
+    pid_ganhos_t ganhos;
+    if(!autotune_ganhos(&autotune, AUTOTUNE_REGRA, &ganhos.kp, &ganhos.ki, &ganhos.kd)){
+        ESP_LOGE(TAG, "Autotune falhou: %s", autotune_nome_estado(autotune.estado));
+        return;
+    }
+    ESP_LOGI(TAG, "Autotune: Ku %.1f Pu %.1f s amplitude %.2f graus -> kp %.3f ki %.4f kd %.2f", autotune.ku,
+             autotune.pu_s, autotune.amplitude, ganhos.kp, ganhos.ki, ganhos.kd);
+    if(pid_nvs_grava(&ganhos) != ESP_OK){
+        ESP_LOGE(TAG, "Nao foi possivel gravar os ganhos na NVS");
+        return;
     }
+    ESP_LOGI(TAG, "Ganhos gravados; reinicie para um ciclo com eles");
 }
 
+/**
+ * @brief Fim da excitacao: fecha o ciclo no arquivo da flash, fora das tarefas de controle
+ */
+static void conclui_excitacao(void)
+{
+    arquivo_fim(excitacao.estado == EXCITACAO_PRONTO ? CICLO_COMPLETO : CICLO_INTERROMPIDO);
+    ESP_LOGI(TAG, "Excitacao %s: %s; duty de equilibrio %.1f amplitude %.1f; log com %u blocos (%u descartados). "
+             "Exporte o ciclo da excitacao com registro_exporta -a 1 e calcule a resposta com resposta_frequencia",
+             excitacao_nome_sinal(excitacao.cfg.sinal), excitacao_nome_estado(excitacao.estado), excitacao.equilibrio,
+             excitacao.amplitude, registro_n_blocos(&registro), registro.perdidos);
+}
 
 /**
- * @brief Cacula a saida do PID e altera a largura do pulso do PWM.
+ * @brief Comandos do console para ver a latencia do laco de controle sem parar o processo
  * 
  * @param pvParameters 
  */
-void control_pwm(void *pvParameters)
+void console_task(void *pvParameters)
 {
     while (1)
     {
-        // espera pelo bit 
-        xEventGroupWaitBits(
-            LD_event_group,         // grupo de eventos a ser esperado
-            CONTROL_BIT,            // bit que está sendo esperado
-            pdTRUE,                 // limpa os bits após a leitura
-            pdFALSE,                // espera por um dos bits
-            portMAX_DELAY           // tempo máximo para esperar os bits
-        );
-
-        //Calcula o erro
-        erro = setpoint - temp;
-        //Calculo do PID
-        PID_P = kp * erro;
-        PID_I = ((ki*T)/2)*(erro + erro_ant) + PID_Output_ant;
-        PID_D = (kd*(2/T))*(erro - erro_ant) - PID_Output_ant;
-        PID_Output = PID_P + PID_I + PID_D ;
-        PID_Output_ant = PID_Output;
-        erro_ant = erro;
-        //Controla o PWM do relé com o valor de saido do PID
-        rele_d_altera(PID_Output);  
+        if(experimento == EXPERIMENTO_TERMINADO){
+            if(tipo_experimento == EXPERIMENTO_AUTOTUNE){
+                conclui_autotune();
+            }
+            else{
+                conclui_excitacao();
+            }
+            // o rele continua desligado; so volta ao PID na proxima partida
+            experimento = EXPERIMENTO_CONCLUIDO;
+        }
+        int c = getchar();
+        if(c == 'l'){
+            latencia_imprime(&latencia);
+        }
+        else if(c == 'z'){
+            latencia_zera(&latencia);
+            printf("Latencia zerada a partir da proxima amostra\n");
+        }
+        else if(c == 'd' &&
+                (experimento == EXPERIMENTO_PARADO ? perfil.terminado : experimento == EXPERIMENTO_CONCLUIDO)){
+            printa_registro();
+        }
+        else if(c == 'a'){
+            arquivo_lista();
+        }
+        else if(c == 't' && experimento == EXPERIMENTO_PARADO){
+            printf("Autotune em %.0f graus: o perfil para e o rele oscila em volta do setpoint\n", AUTOTUNE_SETPOINT);
+            tipo_experimento = EXPERIMENTO_AUTOTUNE;
+            experimento = EXPERIMENTO_PEDIDO;
+        }
+        else if((c == 'e' || c == 'E') && experimento == EXPERIMENTO_PARADO){
+            sinal_excitacao = c == 'e' ? EXCITACAO_PRBS : EXCITACAO_CHIRP;
+            printf("Excitacao %s em %.0f +- %.0f graus: o perfil para e o forno e excitado em malha aberta\n",
+                   excitacao_nome_sinal(sinal_excitacao), EXCITACAO_TEMPERATURA, EXCITACAO_BANDA);
+            tipo_experimento = EXPERIMENTO_EXCITACAO;
+            experimento = EXPERIMENTO_PEDIDO;
+        }
+        else if(c == 'm'){
+            adaptativo.ligado = !adaptativo.ligado;
+            printf("Controle %s; modelo %s: a %.5f b %.3g c %.3f kp %.2f ki %.4f (%u quedas, %u reinicios)\n",
+                   adaptativo.ligado ? "adaptativo" : "PID fixo", adaptativo_nome_estado(adaptativo.estado),
+                   adaptativo.a, adaptativo.b, adaptativo.c, adaptativo.kp, adaptativo.ki, adaptativo.quedas, adaptativo.reinicios);
+        }
+        else if(c == EOF){
+            // o console nao bloqueia a leitura
+            hal.espera_ms(hal.ctx, 100);
+        }
     }
 }
+
 /**
- * @brief Realiza a leitura da temperatura
+ * @brief Fim de cada leitura do MAX6675 (na interrupcao do SPI): entrega a amostra para as tarefas
  *  
- * @param pvParameters 
+ * @param leitura 
+ * @param arg 
  */
-void task_read_temp(void *pvParameters)
+static void IRAM_ATTR leitura_pronta(const max6675_amostra_t *leitura, void *arg)
 {
+    difusao_publica_isr(&difusao, leitura);
+}
 
-    printf("Aquecendo...\n");
-    
-    while (1)
-    {
-      //Realiza a temperatura e armazena em temp  
-      temp = readMax6675(spi);
-      
-      //Permite a ação das tarefas: control_pwm e verifica_tempo
-      xEventGroupSetBits(LD_event_group, CONTROL_BIT);
+#if defined(PID_BENCH) || defined(FILTRO_BENCH)
+static uint32_t ciclos_cpu(void){
+    return cpu_hal_get_cycle_count();
+}
+#endif
+
+#ifdef PID_BENCH
+/**
+ * @brief Mede os ciclos por atualizacao de cada tipo numerico do PID. Os hashes devem ser iguais aos do
+ * bench_pid do host.
+ */
+static void bench_pid(void){
+    pid_bench_resultado_t res[PID_BENCH_N_TIPOS];
+    pid_bench_executa(ciclos_cpu, res);
+
+    printf("PID compilado em %s\n", pid_nome_numerico());
+    for(int i = 0; i < PID_BENCH_N_TIPOS; i++){
+        printf("%-8s %8u ciclos  hash %08x  saturacoes %u\n", res[i].nome, res[i].ciclos, res[i].hash, res[i].saturacoes);
     }
 }
+#endif
+
+#ifdef FILTRO_BENCH
+/**
+ * @brief Mede os ciclos por amostra de cada estagio do filtro e da cadeia escolhida na compilacao
+ */
+static void bench_filtro(void){
+    filtro_bench_resultado_t res[FILTRO_BENCH_N_CASOS];
+    filtro_bench_executa(ciclos_cpu, res);
+
+    for(int i = 0; i < FILTRO_BENCH_N_CASOS; i++){
+        printf("%-8s %8u ciclos  rms %.3f graus\n", res[i].nome, res[i].ciclos, res[i].rms_ruido);
+    }
+}
+#endif
 
 /**
  * @brief Inicializa o sensor MAX6675 e cria as tarefas
@@ -317,28 +603,93 @@ void task_read_temp(void *pvParameters)
  * @return * void 
  */
 void app_main() {
+
+#ifdef PID_BENCH
+  bench_pid();
+#endif
+#ifdef FILTRO_BENCH
+  bench_filtro();
+#endif
   
+  /*Carrega o perfil gravado na NVS (sem perfil gravado usa o da compilacao)*/
+  esp_err_t ret = nvs_flash_init();
+  if(ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND){
+    ESP_ERROR_CHECK(nvs_flash_erase());
+    ret = nvs_flash_init();
+  }
+  ESP_ERROR_CHECK(ret);
+  //ganhos do ultimo autotune
+  pid_ganhos_t ganhos;
+  if(pid_nvs_carrega(&ganhos) == ESP_OK){
+    kp = ganhos.kp;
+    ki = ganhos.ki;
+    kd = ganhos.kd;
+    ESP_LOGI(TAG, "Ganhos da NVS: kp %.3f ki %.4f kd %.2f", kp, ki, kd);
+  }
+  //a tabela da compilacao fica na flash; so a da NVS ocupa RAM
+  perfil_tabela_t *tabela_nvs = malloc(sizeof(*tabela_nvs));
+  if(tabela_nvs && perfil_nvs_carrega(tabela_nvs) == ESP_OK){
+    tabela_perfil = tabela_nvs;
+    ESP_LOGI(TAG, "Perfil da NVS: %d segmentos", tabela_perfil->n);
+  }
+  else{
+    free(tabela_nvs);
+    ESP_LOGI(TAG, "Usando o perfil da compilacao: %d segmentos", tabela_perfil->n);
+  }
+
   /*Inicializa o MAX6675 e o barramento SPI*/
   max6675_set();
 
   /*Configura o pwm*/
   rele_pwm_set();
+
+  /*Liga o controle ao hardware*/
+  hal_esp32_inicia(&hal);
+  pid_inicia(&pid, kp, ki, kd, T);
+  adaptativo_inicia(&adaptativo, kp, ki, kd, T, PID_SAIDA_MAX, CONTROLE_ADAPTATIVO);
+  //ganhos por estagio e faixa de temperatura; fora das faixas, os ganhos acima
+  if(escalonamento_nvs_carrega(&tabela_escalonamento) == ESP_OK){
+    escalonamento_inicia(&escalonamento, &tabela_escalonamento, kp, ki, kd);
+    adaptativo.escalonamento = &escalonamento;
+    ESP_LOGI(TAG, "Escalonamento da NVS: %d faixas", tabela_escalonamento.n);
+  }
+  filtro_inicia(&filtro, T);
+  latencia_inicia(&latencia, tempo_us, T * 1000000);
+  registro_inicia(&registro, T * 1000);
+  perfil_inicia(&perfil, tabela_perfil, &registro);
+
+  /*Abre o ciclo no arquivo da flash (os ciclos interrompidos por um reset sao fechados aqui)*/
+  if(arquivo_inicia(1, &registro, tabela_perfil, T * 1000) != ESP_OK){
+    ESP_LOGW(TAG, "Arquivo dos ciclos desligado");
+  }
+
   /*Duty Cycle = 0*/
-  rele_d_altera(0);
+  hal.altera_duty(hal.ctx, 0);
 
   /*Cria o evento*/
   LD_event_group = xEventGroupCreate();
-  /*Limpo os bits utilizados*/
-  xEventGroupClearBits(LD_event_group, CONTROL_BIT);
-  xEventGroupClearBits(LD_event_group, TEMP_BIT);
+  xEventGroupClearBits(LD_event_group, PRINTAR_BIT);
+
+  /*Cria o canal das amostras e a caixa da saida do PID para o log*/
+  difusao_inicia(&difusao);
+  fila_saida = xQueueCreate(1, sizeof(saida_amostra_t));
 
+  /*Inicia a telemetria na menor prioridade das tarefas; sem a UART o ciclo roda sem telemetria*/
+  if(telemetria_uart_inicia(1, exporta_registro, NULL) != ESP_OK){
+    ESP_LOGW(TAG, "Telemetria desligada");
+  }
 
-  /*Cria tarefa para ler a temperatura*/
-  xTaskCreate(task_read_temp, "read_temp", 2048, NULL, 5, NULL); 
+  /*Cria a tarefa do diario, que formata os prints das tarefas de controle no outro nucleo*/
+  ESP_ERROR_CHECK(diario_inicia(1, formata_diario));
   /*Cria tarefa para controle do pwm*/
-  xTaskCreate(control_pwm, "control_pwm", configMINIMAL_STACK_SIZE * 3, NULL, 2, NULL);
+  xTaskCreatePinnedToCore(control_pwm, "control_pwm", configMINIMAL_STACK_SIZE * 3, NULL, 2, NULL, !DIARIO_NUCLEO);
   /*Cria tarefa que verifica o tempo para controlar o setpoint*/
-  xTaskCreate(verifica_tempo, "verifica_tempo", configMINIMAL_STACK_SIZE * 3, NULL, 1, NULL);
+  xTaskCreatePinnedToCore(verifica_tempo, "verifica_tempo", configMINIMAL_STACK_SIZE * 3, NULL, 1, NULL, !DIARIO_NUCLEO);
+  /*Cria tarefa que atende os comandos do console*/
+  xTaskCreate(console_task, "console_task", configMINIMAL_STACK_SIZE * 3, NULL, 1, NULL);
+  /*Inicia a leitura periodica da temperatura (depois dos consumidores, que se inscrevem ao iniciar)*/
+  printf("Aquecendo...\n");
+  ESP_ERROR_CHECK(max6675_aquisicao_inicia(T * 1000, leitura_pronta, NULL));
   /*Cria a tarefa para printar as temperaturas durante o processo*/
   xTaskCreate(printar_task, "printar_task", configMINIMAL_STACK_SIZE * 3, NULL, 1, NULL);
   
@@ -346,11 +697,7 @@ void app_main() {
   
   /*Evitar watchdog*/
   while(1) {
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    hal.espera_ms(hal.ctx, 1000);
   }           
 
 }
-
-
-
-
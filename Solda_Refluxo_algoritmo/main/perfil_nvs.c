@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include "nvs.h"
+#include "esp_log.h"
+#include "perfil_nvs.h"
+
+static const char *TAG = "PERFIL";
+
+/**
+ * @brief Le a tabela do perfil gravada em texto na NVS (formato de perfil_tabela_le). A NVS deve ter sido
+ * iniciada com nvs_flash_init. Se nao houver tabela ou ela for invalida, a tabela passada nao e alterada.
+ *
+ * @param tabela
+ * @return esp_err_t ESP_ERR_NVS_NOT_FOUND sem tabela gravada, ESP_ERR_INVALID_ARG com o texto invalido
+ */
+esp_err_t perfil_nvs_carrega(perfil_tabela_t *tabela){
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(PERFIL_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if(ret != ESP_OK){
+        return ret;
+    }
+
+    size_t tam = 0;
+    ret = nvs_get_str(nvs, PERFIL_NVS_CHAVE, NULL, &tam);
+    if(ret == ESP_OK && tam > PERFIL_NVS_TAM_MAX){
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    char *texto = NULL;
+    if(ret == ESP_OK){
+        texto = malloc(tam);
+        ret = texto ? nvs_get_str(nvs, PERFIL_NVS_CHAVE, texto, &tam) : ESP_ERR_NO_MEM;
+    }
+    nvs_close(nvs);
+
+    if(ret == ESP_OK){
+        int erro = perfil_tabela_le(tabela, texto);
+        if(erro > 0){
+            ESP_LOGE(TAG, "segmento invalido na linha %d", erro);
+            ret = ESP_ERR_INVALID_ARG;
+        }
+        else if(erro < 0){
+            ESP_LOGE(TAG, "o perfil gravado nao termina");
+            ret = ESP_ERR_INVALID_ARG;
+        }
+    }
+    free(texto);
+    return ret;
+}
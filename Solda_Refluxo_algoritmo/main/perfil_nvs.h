@@ -0,0 +1,13 @@
+#ifndef PERFIL_NVS_H
+#define PERFIL_NVS_H
+
+#include "esp_err.h"
+#include "perfil.h"
+
+#define PERFIL_NVS_NAMESPACE "perfil"
+#define PERFIL_NVS_CHAVE "tabela"
+#define PERFIL_NVS_TAM_MAX 2048                     //Tamanho maximo do texto da tabela
+
+esp_err_t perfil_nvs_carrega(perfil_tabela_t *tabela);
+
+#endif
@@ -0,0 +1,54 @@
+#include <math.h>
+#include "nvs.h"
+#include "pid_nvs.h"
+
+/**
+ * @brief Le os ganhos gravados na NVS. A NVS deve ter sido iniciada com nvs_flash_init. Sem ganhos gravados, ou
+ * com ganhos invalidos, os ganhos passados nao sao alterados.
+ *
+ * @param ganhos
+ * @return esp_err_t ESP_ERR_NVS_NOT_FOUND sem ganhos gravados, ESP_ERR_INVALID_ARG com ganhos invalidos
+ */
+esp_err_t pid_nvs_carrega(pid_ganhos_t *ganhos){
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(PID_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if(ret != ESP_OK){
+        return ret;
+    }
+
+    pid_ganhos_t lidos;
+    size_t tam = sizeof(lidos);
+    ret = nvs_get_blob(nvs, PID_NVS_CHAVE, &lidos, &tam);
+    nvs_close(nvs);
+    if(ret == ESP_OK && tam != sizeof(lidos)){
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    if(ret == ESP_OK && !(isfinite(lidos.kp) && isfinite(lidos.ki) && isfinite(lidos.kd) &&
+                          lidos.kp >= 0 && lidos.ki >= 0 && lidos.kd >= 0)){
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    if(ret == ESP_OK){
+        *ganhos = lidos;
+    }
+    return ret;
+}
+
+/**
+ * @brief Grava os ganhos na NVS, usados a partir da proxima partida
+ *
+ * @param ganhos
+ * @return esp_err_t
+ */
+esp_err_t pid_nvs_grava(const pid_ganhos_t *ganhos){
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(PID_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if(ret != ESP_OK){
+        return ret;
+    }
+    ret = nvs_set_blob(nvs, PID_NVS_CHAVE, ganhos, sizeof(*ganhos));
+    if(ret == ESP_OK){
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
@@ -0,0 +1,19 @@
+#ifndef PID_NVS_H
+#define PID_NVS_H
+
+#include "esp_err.h"
+
+#define PID_NVS_NAMESPACE "pid"
+#define PID_NVS_CHAVE "ganhos"
+
+/**
+ * @brief Ganhos do PID gravados pelo autotune
+ */
+typedef struct {
+    float kp, ki, kd;
+} pid_ganhos_t;
+
+esp_err_t pid_nvs_carrega(pid_ganhos_t *ganhos);
+esp_err_t pid_nvs_grava(const pid_ganhos_t *ganhos);
+
+#endif
@@ -0,0 +1,185 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "telemetria_uart.h"
+
+static const char *TAG = "TELEMETRIA";
+
+static QueueHandle_t fila;
+static uint16_t seq;                                //Proximo numero de sequencia
+static uint32_t perdidas;                           //Mensagens descartadas com a fila cheia
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+static telemetria_fonte_t fonte;
+static void *fonte_arg;
+
+static uint16_t proximo_seq(void)
+{
+    portENTER_CRITICAL(&mux);
+    uint16_t s = seq++;
+    portEXIT_CRITICAL(&mux);
+    return s;
+}
+
+/*Envia um quadro direto, sem a fila (so das tarefas da telemetria)*/
+static void escreve(telemetria_msg_t *msg)
+{
+    uint8_t quadro[TELEMETRIA_MAX_QUADRO];
+    msg->seq = proximo_seq();
+    uart_write_bytes(TELEMETRIA_UART, (const char *)quadro, telemetria_quadro(msg, quadro));
+}
+
+/*Envia o arquivo do deslocamento ate o fim, um pedaco por quadro, e um pedaco vazio no fim. Todos levam a
+ identificacao do ciclo, o CRC do inicio do arquivo*/
+static void exporta(uint8_t arquivo, uint32_t deslocamento)
+{
+    telemetria_msg_t msg = { .tipo = TELEMETRIA_PEDACO };
+    msg.pedaco.arquivo = arquivo;
+    uint32_t total_inicio = 0;
+    uint32_t n_inicio = fonte ? fonte(fonte_arg, arquivo, 0, msg.pedaco.dados, TELEMETRIA_PEDACO_MAX, &total_inicio) : 0;
+    msg.pedaco.ciclo = telemetria_crc16(msg.pedaco.dados, n_inicio);
+    do {
+        uint32_t total = 0;
+        uint32_t n = fonte ? fonte(fonte_arg, arquivo, deslocamento, msg.pedaco.dados, TELEMETRIA_PEDACO_MAX, &total) : 0;
+        msg.pedaco.deslocamento = deslocamento;
+        msg.pedaco.total = total;
+        msg.pedaco.n = n;
+        escreve(&msg);
+        deslocamento += n;
+    } while(msg.pedaco.n);
+}
+
+/*Responde com a velocidade que vai ficar e so entao muda, para a resposta sair na velocidade que o host espera*/
+static void muda_baud(telemetria_comando_t *cmd, uint32_t *baud)
+{
+    if(cmd->valor >= 9600 && cmd->valor <= TELEMETRIA_BAUD_MAX){
+        *baud = cmd->valor;
+    }
+    telemetria_msg_t msg = { .tipo = TELEMETRIA_COMANDO, .comando = *cmd };
+    msg.comando.valor = *baud;
+    escreve(&msg);
+    uart_wait_tx_done(TELEMETRIA_UART, portMAX_DELAY);
+    uart_set_baudrate(TELEMETRIA_UART, *baud);
+}
+
+/**
+ * @brief Recebe os comandos do host pela UART da telemetria. Roda na mesma prioridade da telemetria_task; a
+ * exportacao so espera a serial, nunca as tarefas de controle
+ *
+ * @param pvParameters
+ */
+static void comandos_task(void *pvParameters)
+{
+    uint8_t quadro[TELEMETRIA_MAX_QUADRO];
+    size_t n = 0;
+    uint32_t baud = TELEMETRIA_BAUD;
+    while (1)
+    {
+        //um byte por vez: uart_read_bytes so retorna com todos os bytes pedidos ou no fim da espera
+        uint8_t c;
+        if(uart_read_bytes(TELEMETRIA_UART, &c, 1, pdMS_TO_TICKS(TELEMETRIA_BAUD_VOLTA_MS)) <= 0){
+            //o host sumiu no meio da exportacao: volta para a velocidade em que ele vai procurar
+            if(baud != TELEMETRIA_BAUD){
+                baud = TELEMETRIA_BAUD;
+                uart_set_baudrate(TELEMETRIA_UART, baud);
+            }
+            n = 0;
+            continue;
+        }
+        if(c != 0){
+            //quadro maior que o maximo: os bytes a mais sao ignorados e o CRC descarta o quadro
+            if(n < sizeof(quadro)){
+                quadro[n++] = c;
+            }
+            continue;
+        }
+        telemetria_msg_t msg;
+        if(n && telemetria_le_quadro(quadro, n, &msg) && msg.tipo == TELEMETRIA_COMANDO){
+            if(msg.comando.cmd == TELEMETRIA_CMD_BAUD){
+                muda_baud(&msg.comando, &baud);
+            }
+            else if(msg.comando.cmd == TELEMETRIA_CMD_EXPORTA){
+                exporta(msg.comando.arquivo, msg.comando.valor);
+            }
+        }
+        n = 0;
+    }
+}
+
+static void telemetria_task(void *pvParameters)
+{
+    telemetria_msg_t msg;
+    uint8_t quadro[TELEMETRIA_MAX_QUADRO];
+    while (1)
+    {
+        xQueueReceive(fila, &msg, portMAX_DELAY);
+        size_t n = telemetria_quadro(&msg, quadro);
+        uart_write_bytes(TELEMETRIA_UART, (const char *)quadro, n);
+    }
+}
+
+/**
+ * @brief Configura a UART da telemetria e cria as tarefas que enviam os quadros e atendem os comandos do host
+ *
+ * @param prioridade prioridade das tarefas, abaixo das tarefas de controle
+ * @param fonte arquivos para exportar (pode ser NULL)
+ * @param arg
+ * @return esp_err_t
+ */
+esp_err_t telemetria_uart_inicia(UBaseType_t prioridade, telemetria_fonte_t fonte_exporta, void *arg)
+{
+    fonte = fonte_exporta;
+    fonte_arg = arg;
+
+    uart_config_t config = {
+        .baud_rate = TELEMETRIA_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+    };
+    esp_err_t ret = uart_param_config(TELEMETRIA_UART, &config);
+    if(ret == ESP_OK){
+        ret = uart_set_pin(TELEMETRIA_UART, TELEMETRIA_TX, TELEMETRIA_RX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    if(ret == ESP_OK){
+        //o buffer de transmissao guarda varios quadros para a tarefa nao esperar a cada um
+        ret = uart_driver_install(TELEMETRIA_UART, 256, 2048, 0, NULL, 0);
+    }
+    if(ret != ESP_OK){
+        ESP_LOGE(TAG, "UART %d: %s", TELEMETRIA_UART, esp_err_to_name(ret));
+        return ret;
+    }
+
+    fila = xQueueCreate(TELEMETRIA_FILA, sizeof(telemetria_msg_t));
+    if(!fila || xTaskCreate(telemetria_task, "telemetria_task", configMINIMAL_STACK_SIZE * 3, NULL, prioridade, NULL) != pdPASS ||
+       xTaskCreate(comandos_task, "comandos_task", configMINIMAL_STACK_SIZE * 4, NULL, prioridade, NULL) != pdPASS){
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Numera a mensagem e coloca na fila sem esperar. Com a fila cheia (serial lenta) a mensagem e descartada
+ * e contada, e o salto no seq mostra a perda para quem captura. Pode ser chamada das tarefas de controle.
+ *
+ * @param msg tipo e dados preenchidos; seq e preenchido aqui
+ */
+void telemetria_uart_envia(telemetria_msg_t *msg)
+{
+    if(!fila){
+        return;
+    }
+    msg->seq = proximo_seq();
+    if(xQueueSend(fila, msg, 0) != pdTRUE){
+        portENTER_CRITICAL(&mux);
+        perdidas++;
+        portEXIT_CRITICAL(&mux);
+    }
+}
+
+uint32_t telemetria_uart_perdidas(void)
+{
+    return perdidas;
+}
@@ -0,0 +1,44 @@
+#ifndef TELEMETRIA_UART_H
+#define TELEMETRIA_UART_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "telemetria.h"
+
+/*UART da telemetria, separada do console: idf.py build -DTELEMETRIA_UART=1 -DTELEMETRIA_TX=4 ...*/
+#ifndef TELEMETRIA_UART
+#define TELEMETRIA_UART 2
+#endif
+#ifndef TELEMETRIA_TX
+#define TELEMETRIA_TX 17
+#endif
+#ifndef TELEMETRIA_RX
+#define TELEMETRIA_RX 16                            //Comandos do host (exportacao)
+#endif
+#ifndef TELEMETRIA_BAUD
+#define TELEMETRIA_BAUD 115200
+#endif
+#define TELEMETRIA_BAUD_MAX 2000000
+#define TELEMETRIA_BAUD_VOLTA_MS 5000               //Sem comandos por esse tempo, volta para TELEMETRIA_BAUD
+#define TELEMETRIA_FILA 16                          //Mensagens esperando a serial
+
+/**
+ * @brief Le um pedaco de um arquivo para exportar (TELEMETRIA_CMD_EXPORTA)
+ *
+ * @param arg
+ * @param arquivo numero pedido pelo host
+ * @param deslocamento posicao no arquivo
+ * @param dados onde copiar
+ * @param max tamanho de dados
+ * @param total tamanho do arquivo (0 se nao existe ou nao pode ser exportado agora)
+ * @return bytes copiados (0 no fim)
+ */
+typedef uint32_t (*telemetria_fonte_t)(void *arg, uint8_t arquivo, uint32_t deslocamento, uint8_t *dados, uint32_t max,
+                                       uint32_t *total);
+
+esp_err_t telemetria_uart_inicia(UBaseType_t prioridade, telemetria_fonte_t fonte, void *arg);
+void telemetria_uart_envia(telemetria_msg_t *msg);
+uint32_t telemetria_uart_perdidas(void);
+
+#endif